@@ -69,7 +69,7 @@ layout(std140) uniform ub_world
     SWorldLayer[WORLD_MAX_LAYERS] layers;
 } u_world;
 
-uniform int u_mode;
+const int shaderMode = SHADER_MODE;
 uniform vec4 u_modeControlA;
 uniform vec4 u_modeControlB;
 uniform vec2 u_sizeScreenSpace;
@@ -218,7 +218,7 @@ void main()
     vec2 pov = vec2(u_map.povX, u_map.povY);
 
     vec2 texCoord = f_texCoord;
-    if (u_mode == MAP_MODE_WORLD_LAYER)
+    if (shaderMode == MAP_MODE_WORLD_LAYER)
     {
         // texCoord.y = 1.0f - texCoord.y;
         texCoord.x = 1.0f - texCoord.x;
@@ -233,7 +233,7 @@ void main()
     float tileCellSize = 0.0f;
     float tileEdgeSize = 0.0f;
 
-    if (u_mode == MAP_MODE_WORLD)
+    if (shaderMode == MAP_MODE_WORLD)
     {
         vec2 position = round(u_world.position.xy);
 
@@ -274,7 +274,7 @@ void main()
             }
         }
     }
-    else if (u_mode == MAP_MODE_WORLD_LAYER)
+    else if (shaderMode == MAP_MODE_WORLD_LAYER)
     {
         texCoord = floor(texCoord);
 
@@ -316,7 +316,7 @@ void main()
     vec3 floorColor = vec3(0.0f, 0.0f, 1.0f);
     vec3 tileGridColor = vec3(0.05f, 0.11f, 0.61f);
 
-    if (u_mode == MAP_MODE_WORLD_LAYER)
+    if (shaderMode == MAP_MODE_WORLD_LAYER)
     {
         edgeColor = vec3(1.0f);
         floorColor = edgeColor * 0.2f;
@@ -439,7 +439,7 @@ void main()
     float tileGrid = floorTileMask; // + wallMasks;
     vec3 grid = mix(vec3(0.05, 0.15, 0.6) * gridPulse, tileGridColor, tileGrid);
 
-    if (u_mode != MAP_MODE_WORLD_LAYER && u_mode != MAP_MODE_WORLD)
+    if (shaderMode != MAP_MODE_WORLD_LAYER && shaderMode != MAP_MODE_WORLD)
     {
         finalColor = mix(finalColor, grid, saturate(gridMasks * (1.0 - wallMasks) * (1.0 - doorMasks)));
     }
@@ -453,14 +453,14 @@ void main()
     finalColor = mix(finalColor, holeColor.rgb, tileMasks.valid * tileMasks.explored * holeColor.a * (1.0 - edgeMask));
 
     /* Current POV */
-    if (u_mode == MAP_MODE_NORMAL)
+    if (shaderMode == MAP_MODE_NORMAL)
     {
         vec4 playerIcon = putIcon(texCoord, pov, u_map.povDirection, tileSize, tileEdgeSize, u_common.icons[MAP_ICON_PLAYER]);
         finalColor = overlay(finalColor, playerIcon.rgb, playerIcon.a);
     }
 
     /* Draw editor-specific stuff. */
-    if (u_mode == MAP_MODE_NORMAL && u_editor.enabled)
+    if (shaderMode == MAP_MODE_NORMAL && u_editor.enabled)
     {
         const vec3 selectedTileColor = vec3(0.99f, 0.0396f, 0.261f);
         const vec3 selectedBlockColor = vec3(0.99f, 0.777f, 0.0792f);
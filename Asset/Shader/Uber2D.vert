@@ -1,7 +1,7 @@
 layout(location = 0) in vec2 a_vertexPositionModelSpace;
 layout(location = 1) in vec2 a_texCoord;
 
-uniform int u_mode;
+const int shaderMode = SHADER_MODE;
 uniform vec4 u_modeControlA;
 uniform vec2 u_positionScreenSpace;
 uniform vec2 u_sizeScreenSpace;
@@ -50,7 +50,7 @@ void main()
     vec2 ndcCenter = vec2(ndcOrigin.x + (ndcSize.x / 2.0), ndcOrigin.y + (ndcSize.y / 2.0));
 
     // Back Blur
-    if (u_mode == UBER2D_MODE_BACK_BLUR) {
+    if (shaderMode == UBER2D_MODE_BACK_BLUR) {
         f_modeControlOutA.x = ((u_modeControlA.x - 1) - gl_InstanceID);
         float from = u_modeControlA.z * f_modeControlOutA.x;
         float to = from + u_modeControlA.z;
@@ -1,4 +1,4 @@
-uniform int u_mode;
+const int shaderMode = SHADER_MODE;
 uniform vec4 u_modeControlA;
 uniform sampler2D u_commonAtlas;
 uniform sampler2D u_primaryAtlas;
@@ -13,11 +13,11 @@ out vec4 color;
 
 void main()
 {
-    if (u_mode == UBER3D_MODE_BASIC) {
+    if (shaderMode == UBER3D_MODE_BASIC) {
         color = texture(u_primaryAtlas, f_texCoord);
     }
 
-    if (u_mode == UBER3D_MODE_LEVEL) {
+    if (shaderMode == UBER3D_MODE_LEVEL || shaderMode == UBER3D_MODE_LEVEL_PULLED) {
         color = texture(u_primaryAtlas, f_texCoord);
     }
 
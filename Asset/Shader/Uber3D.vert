@@ -7,9 +7,19 @@ layout(std140) uniform ub_common
     mat4 u_projection;
     mat4 u_view;
 };
-uniform int u_mode;
+const int shaderMode = SHADER_MODE;
 uniform vec4 u_modeControlA;
-uniform mat4 u_model[UBER3D_MODEL_COUNT];
+uniform vec4 u_modeControlB;
+/* Four texels per transform, one per column, see SInstanceBuffer. */
+uniform samplerBuffer u_instances;
+/* One texel per SLevelInstance, read in UBER3D_MODE_LEVEL. */
+uniform isamplerBuffer u_levelInstances;
+uniform int u_instanceOffset;
+/* One texel per STile, row major, read in UBER3D_MODE_LEVEL_PULLED. */
+uniform usamplerBuffer u_levelTiles;
+uniform ivec2 u_levelSize;
+/* LEVEL_PULL_*, what this draw expands the tiles into. */
+uniform int u_levelPullKind;
 
 out vec2 f_texCoord;
 out vec4 f_positionViewSpace;
@@ -17,9 +27,172 @@ out vec3 f_positionWorldSpace;
 out vec4 f_vertexColor;
 out vec3 f_eyeDirectionCameraSpace;
 
+/* Level geometry is only ever translated and rotated around Y. */
+mat4 levelModel(vec3 position, float yaw)
+{
+    float c = cos(yaw);
+    float s = sin(yaw);
+    return mat4(
+        vec4(c, 0.0, -s, 0.0),
+        vec4(0.0, 1.0, 0.0, 0.0),
+        vec4(s, 0.0, c, 0.0),
+        vec4(position, 1.0));
+}
+
+mat4 fetchModel()
+{
+    if (shaderMode == UBER3D_MODE_LEVEL)
+    {
+        /* Translation in fixed point and a rotation around Y in 1/65536 turns. */
+        ivec4 levelInstance = texelFetch(u_levelInstances, u_instanceOffset + gl_InstanceID);
+        vec3 position = vec3(levelInstance.xyz) / float(LEVEL_INSTANCE_POSITION_SCALE);
+        float yaw = float(levelInstance.w) * (2.0 * PI / 65536.0);
+        return levelModel(position, yaw);
+    }
+
+    int instance = (u_instanceOffset + gl_InstanceID) * 4;
+    return mat4(
+            texelFetch(u_instances, instance),
+            texelFetch(u_instances, instance + 1),
+            texelFetch(u_instances, instance + 2),
+            texelFetch(u_instances, instance + 3));
+}
+
+/* Matches SDirection::GetVector(). */
+ivec2 directionVector(int direction)
+{
+    const ivec2 vectors[4] = ivec2[4](ivec2(0, -1), ivec2(1, 0), ivec2(0, 1), ivec2(-1, 0));
+    return vectors[direction & 3];
+}
+
+/* Matches SDirection::YawFromDirection(). */
+float directionYaw(int direction)
+{
+    return float((4 - direction) & 3) * HALF_PI;
+}
+
+/* Flags and edge flags of a tile, zero outside the level. */
+uvec2 fetchTile(ivec2 coords)
+{
+    if (any(lessThan(coords, ivec2(0))) || any(greaterThanEqual(coords, u_levelSize)))
+    {
+        return uvec2(0u);
+    }
+    return texelFetch(u_levelTiles, (coords.y * u_levelSize.x) + coords.x).xz;
+}
+
+bool hasEdge(uvec2 tile, uint northBit, int direction)
+{
+    return (tile.y & (northBit << uint(direction))) != 0u;
+}
+
+bool isWallBasedEdge(uvec2 tile, int direction)
+{
+    return hasEdge(tile, TILE_EDGE_WALL_BIT, direction) || hasEdge(tile, TILE_EDGE_DOOR_BIT, direction);
+}
+
+/* Same rule as STilemap::PostProcess(), from any of the four tiles around the joint. */
+bool isWallJointAt(ivec2 coords)
+{
+    const int north = int(DIRECTION_BIT_NORTH);
+    const int east = int(DIRECTION_BIT_EAST);
+    const int south = int(DIRECTION_BIT_SOUTH);
+    const int west = int(DIRECTION_BIT_WEST);
+
+    uvec2 southEast = fetchTile(coords);
+    uvec2 southWest = fetchTile(coords + ivec2(-1, 0));
+    uvec2 northWest = fetchTile(coords + ivec2(-1, -1));
+    uvec2 northEast = fetchTile(coords + ivec2(0, -1));
+    return (isWallBasedEdge(southEast, north) && isWallBasedEdge(southEast, west)) ||
+        (isWallBasedEdge(southWest, north) && isWallBasedEdge(southWest, east)) ||
+        (isWallBasedEdge(northWest, south) && isWallBasedEdge(northWest, east)) ||
+        (isWallBasedEdge(northEast, south) && isWallBasedEdge(northEast, west));
+}
+
+/* Every instance is one slot of one tile in the window around the POV, u_modeControlA holds the POV coords and
+ * direction and the door offset, u_modeControlB the door being animated, drawn with level instances instead.
+ * Returns false if the slot holds nothing. */
+bool pullLevelModel(out mat4 model)
+{
+    int slotCount = 1;
+    if (u_levelPullKind == LEVEL_PULL_WALL || u_levelPullKind == LEVEL_PULL_DOOR_FRAME)
+    {
+        slotCount = 4;
+    }
+    else if (u_levelPullKind == LEVEL_PULL_DOOR)
+    {
+        slotCount = 8;
+    }
+
+    int windowTile = gl_InstanceID / slotCount;
+    int slot = gl_InstanceID - (windowTile * slotCount);
+    int forwardOffset = (windowTile / LEVEL_WINDOW_WIDTH) - LEVEL_WINDOW_BACK;
+    int sideOffset = (windowTile - ((windowTile / LEVEL_WINDOW_WIDTH) * LEVEL_WINDOW_WIDTH)) - LEVEL_WINDOW_SIDE;
+
+    ivec2 forward = directionVector(int(u_modeControlA.z));
+    ivec2 side = ivec2(-forward.y, forward.x);
+    ivec2 coords = ivec2(u_modeControlA.xy) + (forward * forwardOffset) + (side * sideOffset);
+    vec3 position = vec3(float(coords.x), 0.0, float(coords.y));
+
+    if (u_levelPullKind == LEVEL_PULL_WALL_JOINT)
+    {
+        model = levelModel(position, 0.0);
+        return isWallJointAt(coords);
+    }
+
+    uvec2 tile = fetchTile(coords);
+    if (u_levelPullKind == LEVEL_PULL_FLOOR || u_levelPullKind == LEVEL_PULL_HOLE)
+    {
+        model = levelModel(position, 0.0);
+        return (tile.x & (u_levelPullKind == LEVEL_PULL_FLOOR ? TILE_FLOOR_BIT : TILE_HOLE_BIT)) != 0u;
+    }
+
+    if (u_levelPullKind == LEVEL_PULL_WALL || u_levelPullKind == LEVEL_PULL_DOOR_FRAME)
+    {
+        model = levelModel(position, directionYaw(slot));
+        return hasEdge(tile, u_levelPullKind == LEVEL_PULL_WALL ? TILE_EDGE_WALL_BIT : TILE_EDGE_DOOR_BIT, slot);
+    }
+
+    /* Two doors per doorway, see SRenderer::Draw3DLevelDoor(). */
+    int direction = slot / 2;
+    ivec2 openDoorCoords = ivec2(u_modeControlB.xy);
+    int openDoorDirection = int(u_modeControlB.z);
+    bool bOpenDoor = (coords == openDoorCoords && direction == openDoorDirection) ||
+        (coords == openDoorCoords + directionVector(openDoorDirection) && direction == ((openDoorDirection + 2) & 3));
+    if (!hasEdge(tile, TILE_EDGE_DOOR_BIT, direction) || bOpenDoor)
+    {
+        model = mat4(1.0);
+        return false;
+    }
+
+    int doorDirection = (slot & 1) == 0 ? (direction + 2) & 3 : direction;
+    vec2 doorwayCenter = vec2(coords) + (vec2(directionVector(direction)) * 0.5);
+    vec2 doorPosition = doorwayCenter + (vec2(directionVector(doorDirection + 1)) * u_modeControlA.w);
+    model = levelModel(vec3(doorPosition.x, 0.0, doorPosition.y), directionYaw(doorDirection));
+    return true;
+}
+
 void main()
 {
-    mat4 model = u_model[gl_InstanceID];
+    mat4 model;
+    if (shaderMode == UBER3D_MODE_LEVEL_PULLED)
+    {
+        if (!pullLevelModel(model))
+        {
+            /* Every vertex of the instance lands on the same point outside the clip volume. */
+            gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+            f_texCoord = vec2(0.0);
+            f_positionViewSpace = vec4(0.0);
+            f_positionWorldSpace = vec3(0.0);
+            f_vertexColor = vec4(0.0);
+            f_eyeDirectionCameraSpace = vec3(0.0);
+            return;
+        }
+    }
+    else
+    {
+        model = fetchModel();
+    }
 
     gl_Position = u_projection * u_view * model * vec4(a_vertexPositionModelSpace, 1.0);
 
@@ -40,4 +213,3 @@ void main()
     // f_texCoord.x = 1.0 - f_texCoord.x;
     f_texCoord.y = 1.0 - f_texCoord.y;
 }
-
@@ -1,4 +1,5 @@
 #include "AssetTools.hxx"
+#include "AssetPack.hxx"
 
 #define STR2(x) #x
 #define STR(x) STR2(x)
@@ -54,7 +55,13 @@
     #define EXTERN_OR_INLINE inline
 #endif
 
-#ifdef EQUINOX_REACH_DEVELOPMENT
+#if defined(EQUINOX_REACH_ASSET_PACK)
+    /* Assets live in the asset pack mounted by main(), see AssetPack.hxx. */
+    #define DEFINE_ASSET(NAME, PATH)                      \
+        AssetPack::SPackedAsset NAME##Packed(PATH, PATH); \
+        EXTERN_ASSET(NAME)                                \
+        const SAsset& NAME = NAME##Packed.Asset;
+#elif defined(EQUINOX_REACH_DEVELOPMENT)
     #define DEFINE_ASSET(NAME, PATH)                \
         INCBIN(NAME, EQUINOX_REACH_ASSET_PATH PATH) \
         EXTERN_OR_INLINE const SAsset NAME(&(incbin_##NAME##_start[0]), incbin_##NAME##_length, PATH);
@@ -64,27 +71,43 @@
         EXTERN_OR_INLINE const SAsset NAME(&(incbin_##NAME##_start[0]), incbin_##NAME##_length);
 #endif
 
+/* Cooked assets are built from a source asset by a host tool (see CMakeLists.txt) and embedded from the build directory.
+ * Development builds keep the source asset path. */
+#if defined(EQUINOX_REACH_ASSET_PACK)
+    #define DEFINE_COOKED_ASSET(NAME, STEM, SOURCE_EXTENSION, COOKED_EXTENSION)                 \
+        AssetPack::SPackedAsset NAME##Packed(STEM COOKED_EXTENSION, STEM SOURCE_EXTENSION); \
+        EXTERN_ASSET(NAME)                                                                  \
+        const SAsset& NAME = NAME##Packed.Asset;
+#elif defined(EQUINOX_REACH_DEVELOPMENT)
+    #define DEFINE_COOKED_ASSET(NAME, STEM, SOURCE_EXTENSION, COOKED_EXTENSION) \
+        INCBIN(NAME, EQUINOX_REACH_COOKED_ASSET_PATH STEM COOKED_EXTENSION)      \
+        EXTERN_OR_INLINE const SAsset NAME(&(incbin_##NAME##_start[0]), incbin_##NAME##_length, STEM SOURCE_EXTENSION);
+#else
+    #define DEFINE_COOKED_ASSET(NAME, STEM, SOURCE_EXTENSION, COOKED_EXTENSION) \
+        INCBIN(NAME, EQUINOX_REACH_COOKED_ASSET_PATH STEM COOKED_EXTENSION)      \
+        EXTERN_OR_INLINE const SAsset NAME(&(incbin_##NAME##_start[0]), incbin_##NAME##_length);
+#endif
+
+#define DEFINE_COOKED_MESH(NAME, STEM) DEFINE_COOKED_ASSET(NAME, STEM, ".obj", ".erms")
+/* Atlases are packed from several PNG files, there's no single source asset. */
+#define DEFINE_COOKED_ATLAS(NAME, STEM) DEFINE_COOKED_ASSET(NAME, STEM, ".erat", ".erat")
+
 namespace Asset::Common
 {
-    DEFINE_ASSET(FramePNG, "Texture/Frame.png")
-    DEFINE_ASSET(RefPNG, "Texture/Ref.png")
-    DEFINE_ASSET(AngelPNG, "Texture/Angel.png")
-    DEFINE_ASSET(NoisePNG, "Texture/Noise.png")
-    DEFINE_ASSET(QuadOBJ, "Mesh/Quad.obj")
-    DEFINE_ASSET(PillarOBJ, "Mesh/Pillar.obj")
+    DEFINE_COOKED_MESH(QuadMesh, "Mesh/Quad")
+    DEFINE_COOKED_MESH(PillarMesh, "Mesh/Pillar")
     DEFINE_ASSET(MartianMono, "Font/MartianMono.ttf")
     DEFINE_ASSET(DoorCreekWAV, "Sound/DoorCreek.wav")
     DEFINE_ASSET(Tile_01WAV, "Sound/Step/Tile_01.wav")
     DEFINE_ASSET(TestMusicWAV, "Music/TestMusic.wav")
 }
 
-namespace Asset::HUD
+/* Sprite lists are in CMakeLists.txt (COOKED_ATLAS_<Name>). */
+namespace Asset::Atlas
 {
-    /* Map Icons */
-    DEFINE_ASSET(MapIconPlayer, "HUD/Player.png")
-    DEFINE_ASSET(MapIconA, "HUD/IconA.png")
-    DEFINE_ASSET(MapIconB, "HUD/IconB.png")
-    DEFINE_ASSET(MapIconHole, "HUD/Hole.png")
+    DEFINE_COOKED_ATLAS(Common, "Atlas/Common")
+    DEFINE_COOKED_ATLAS(Primary2D, "Atlas/Primary2D")
+    DEFINE_COOKED_ATLAS(Primary3D, "Atlas/Primary3D")
 }
 
 namespace Asset::Shader
@@ -113,11 +136,10 @@ namespace Asset::Map
 
 namespace Asset::Tileset::Hotel
 {
-    DEFINE_ASSET(FloorOBJ, "Tileset/Hotel/Floor.obj")
-    DEFINE_ASSET(HoleOBJ, "Tileset/Hotel/Hole.obj")
-    DEFINE_ASSET(WallOBJ, "Tileset/Hotel/Wall.obj")
-    DEFINE_ASSET(WallJointOBJ, "Tileset/Hotel/WallJoint.obj")
-    DEFINE_ASSET(DoorFrameOBJ, "Tileset/Hotel/DoorFrame.obj")
-    DEFINE_ASSET(DoorOBJ, "Tileset/Hotel/Door.obj")
-    DEFINE_ASSET(AtlasPNG, "Tileset/Hotel/Atlas.png")
+    DEFINE_COOKED_MESH(FloorMesh, "Tileset/Hotel/Floor")
+    DEFINE_COOKED_MESH(HoleMesh, "Tileset/Hotel/Hole")
+    DEFINE_COOKED_MESH(WallMesh, "Tileset/Hotel/Wall")
+    DEFINE_COOKED_MESH(WallJointMesh, "Tileset/Hotel/WallJoint")
+    DEFINE_COOKED_MESH(DoorFrameMesh, "Tileset/Hotel/DoorFrame")
+    DEFINE_COOKED_MESH(DoorMesh, "Tileset/Hotel/Door")
 }
@@ -0,0 +1,258 @@
+#include "AssetPack.hxx"
+
+#include <array>
+#include <cstring>
+#include "Compression.hxx"
+#include "Log.hxx"
+#include "Memory.hxx"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace AssetPack
+{
+    struct SPackedAssets
+    {
+        std::array<SPackedAsset*, MaxAssetCount> Assets{};
+        int Count{};
+    };
+
+    struct SMapping
+    {
+        const uint8_t* Data{};
+        std::size_t Length{};
+#ifdef _WIN32
+        HANDLE File = INVALID_HANDLE_VALUE;
+        HANDLE FileMapping{};
+#endif
+    };
+
+    /* Packed assets register themselves during static initialization, hence the function local static. */
+    static SPackedAssets& GetPackedAssets()
+    {
+        static SPackedAssets PackedAssets;
+        return PackedAssets;
+    }
+
+    static SMapping Mapping;
+    /* Heap copies of compressed entries, indexed like SPackedAssets::Assets. */
+    static std::array<void*, MaxAssetCount> Inflated{};
+
+    SPackedAsset::SPackedAsset(const char* InPackPath, const char* RelativeAssetPath)
+#ifdef EQUINOX_REACH_DEVELOPMENT
+        : Asset(nullptr, 0, RelativeAssetPath), PackPath(InPackPath)
+#else
+        : Asset(nullptr, 0), PackPath(InPackPath)
+#endif
+    {
+        (void)RelativeAssetPath;
+
+        auto& PackedAssets = GetPackedAssets();
+        if (PackedAssets.Count == MaxAssetCount)
+        {
+            Log::AssetPack<ELogLevel::Critical>("Too many packed assets, raise AssetPack::MaxAssetCount");
+            return;
+        }
+        PackedAssets.Assets[PackedAssets.Count++] = this;
+    }
+
+    static bool MapFile(const char* Path)
+    {
+#ifdef _WIN32
+        Mapping.File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (Mapping.File == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER Size;
+        if (!GetFileSizeEx(Mapping.File, &Size) || Size.QuadPart == 0)
+        {
+            return false;
+        }
+        Mapping.Length = static_cast<std::size_t>(Size.QuadPart);
+
+        Mapping.FileMapping = CreateFileMappingA(Mapping.File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (Mapping.FileMapping == nullptr)
+        {
+            return false;
+        }
+        Mapping.Data = static_cast<const uint8_t*>(MapViewOfFile(Mapping.FileMapping, FILE_MAP_READ, 0, 0, 0));
+        return Mapping.Data != nullptr;
+#else
+        int File = open(Path, O_RDONLY);
+        if (File < 0)
+        {
+            return false;
+        }
+
+        struct stat Stat{};
+        if (fstat(File, &Stat) != 0 || Stat.st_size == 0)
+        {
+            close(File);
+            return false;
+        }
+        Mapping.Length = static_cast<std::size_t>(Stat.st_size);
+
+        void* Data = mmap(nullptr, Mapping.Length, PROT_READ, MAP_PRIVATE, File, 0);
+        close(File);
+        if (Data == MAP_FAILED)
+        {
+            return false;
+        }
+        Mapping.Data = static_cast<const uint8_t*>(Data);
+        return true;
+#endif
+    }
+
+    static void UnmapFile()
+    {
+#ifdef _WIN32
+        if (Mapping.Data != nullptr)
+        {
+            UnmapViewOfFile(Mapping.Data);
+        }
+        if (Mapping.FileMapping != nullptr)
+        {
+            CloseHandle(Mapping.FileMapping);
+        }
+        if (Mapping.File != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(Mapping.File);
+        }
+#else
+        if (Mapping.Data != nullptr)
+        {
+            munmap(const_cast<uint8_t*>(Mapping.Data), Mapping.Length);
+        }
+#endif
+        Mapping = {};
+    }
+
+    static const SAssetPackEntry* FindEntry(const SAssetPackHeader& Header, const char* Path)
+    {
+        auto* Table = reinterpret_cast<const SAssetPackEntry*>(Mapping.Data + sizeof(SAssetPackHeader));
+        auto Hash = HashAssetPath(Path);
+        auto Mask = Header.TableSize - 1;
+        for (uint32_t Probe = 0; Probe < Header.TableSize; ++Probe)
+        {
+            const auto& Entry = Table[(Hash + Probe) & Mask];
+            if (Entry.Hash == 0)
+            {
+                return nullptr;
+            }
+            if (Entry.Hash == Hash && Entry.NameOffset < Mapping.Length &&
+                std::strncmp(reinterpret_cast<const char*>(Mapping.Data + Entry.NameOffset), Path, Mapping.Length - Entry.NameOffset) == 0)
+            {
+                return &Entry;
+            }
+        }
+        return nullptr;
+    }
+
+    static bool ResolveAsset(const SAssetPackHeader& Header, int Index)
+    {
+        auto& Packed = *GetPackedAssets().Assets[Index];
+        const auto* Entry = FindEntry(Header, Packed.PackPath);
+        if (Entry == nullptr)
+        {
+            Log::AssetPack<ELogLevel::Critical>("%s is missing from the asset pack", Packed.PackPath);
+            return false;
+        }
+        if (Entry->Offset > Mapping.Length || Entry->StoredLength > Mapping.Length - Entry->Offset)
+        {
+            Log::AssetPack<ELogLevel::Critical>("%s is out of the asset pack bounds", Packed.PackPath);
+            return false;
+        }
+
+        const uint8_t* Stored = Mapping.Data + Entry->Offset;
+        if ((Entry->Flags & ASSET_PACK_ENTRY_COMPRESSED) == 0)
+        {
+            /* Used in place, so the zero byte after the entry has to be in the mapping too. */
+            if (Entry->Length != Entry->StoredLength || Entry->Length >= Mapping.Length - Entry->Offset || Stored[Entry->Length] != 0)
+            {
+                Log::AssetPack<ELogLevel::Critical>("%s is corrupted in the asset pack", Packed.PackPath);
+                return false;
+            }
+            Packed.Asset.Data = Stored;
+            Packed.Asset.Length = Entry->Length;
+            return true;
+        }
+
+        /* Keep the zero byte that follows every entry. */
+        auto* Data = static_cast<uint8_t*>(Memory::Malloc(std::size_t(Entry->Length) + 1, EMemoryCategory::Asset));
+        if (!Compression::Decompress(Stored, Entry->StoredLength, Data, Entry->Length))
+        {
+            Log::AssetPack<ELogLevel::Critical>("%s is corrupted in the asset pack", Packed.PackPath);
+            Memory::Free(Data);
+            return false;
+        }
+        Data[Entry->Length] = 0;
+
+        Inflated[Index] = Data;
+        Packed.Asset.Data = Data;
+        Packed.Asset.Length = Entry->Length;
+        return true;
+    }
+
+    bool Mount(const char* Path)
+    {
+        if (!MapFile(Path))
+        {
+            Log::AssetPack<ELogLevel::Critical>("Failed to map %s", Path);
+            UnmapFile();
+            return false;
+        }
+
+        SAssetPackHeader Header{};
+        bool bValid = Mapping.Length >= sizeof(Header);
+        if (bValid)
+        {
+            std::memcpy(&Header, Mapping.Data, sizeof(Header));
+            bValid = Header.Magic == SAssetPackHeader::CurrentMagic && Header.Version == SAssetPackHeader::CurrentVersion &&
+                Header.TableSize != 0 && (Header.TableSize & (Header.TableSize - 1)) == 0 &&
+                Header.TableSize <= (Mapping.Length - sizeof(Header)) / sizeof(SAssetPackEntry);
+        }
+        if (!bValid)
+        {
+            Log::AssetPack<ELogLevel::Critical>("%s is not a valid asset pack, rebuild it", Path);
+            UnmapFile();
+            return false;
+        }
+
+        bool bResolved = true;
+        auto& PackedAssets = GetPackedAssets();
+        for (int Index = 0; Index < PackedAssets.Count; ++Index)
+        {
+            bResolved = ResolveAsset(Header, Index) && bResolved;
+        }
+
+        Log::AssetPack<ELogLevel::Info>("Mounted %s: %zu bytes, %d assets", Path, Mapping.Length, PackedAssets.Count);
+        if (!bResolved)
+        {
+            Unmount();
+        }
+        return bResolved;
+    }
+
+    void Unmount()
+    {
+        auto& PackedAssets = GetPackedAssets();
+        for (int Index = 0; Index < PackedAssets.Count; ++Index)
+        {
+            Memory::Free(Inflated[Index]);
+            Inflated[Index] = nullptr;
+            PackedAssets.Assets[Index]->Asset.Data = nullptr;
+            PackedAssets.Assets[Index]->Asset.Length = 0;
+        }
+        UnmapFile();
+    }
+}
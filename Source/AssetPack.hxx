@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "AssetTools.hxx"
+
+/* Asset packs are built by the asset packer tool (see CMakeLists.txt):
+ * SAssetPackHeader, then TableSize SAssetPackEntry slots, then the null terminated entry names, then the entry data.
+ * The table is open addressed on HashAssetPath of the relative asset path with linear probing, empty slots have
+ * Hash == 0. Entry data starts on AssetPackAlignment and is followed by at least one zero byte. */
+static constexpr std::size_t AssetPackAlignment = 64;
+
+struct SAssetPackHeader
+{
+    static constexpr uint32_t CurrentMagic = 0x4B505245; /* "ERPK" */
+    static constexpr uint32_t CurrentVersion = 1;
+
+    uint32_t Magic = CurrentMagic;
+    uint32_t Version = CurrentVersion;
+    uint32_t EntryCount{};
+    /* Power of two. */
+    uint32_t TableSize{};
+};
+
+enum EAssetPackEntryFlags : uint32_t
+{
+    ASSET_PACK_ENTRY_COMPRESSED = 1 << 0,
+};
+
+struct SAssetPackEntry
+{
+    uint64_t Hash{};
+    uint64_t Offset{};
+    uint32_t StoredLength{};
+    uint32_t Length{};
+    uint32_t NameOffset{};
+    uint32_t Flags{};
+};
+
+static_assert(sizeof(SAssetPackHeader) == 16, "Asset pack header is read straight from the mapping");
+static_assert(sizeof(SAssetPackEntry) == 32, "Asset pack entries are read straight from the mapping");
+
+/* FNV-1a, never 0 so that 0 can mark empty slots. */
+[[nodiscard]] constexpr uint64_t HashAssetPath(const char* Path)
+{
+    uint64_t Hash = 14695981039346656037ull;
+    for (; *Path != '\0'; ++Path)
+    {
+        Hash = (Hash ^ static_cast<unsigned char>(*Path)) * 1099511628211ull;
+    }
+    return Hash != 0 ? Hash : 1;
+}
+
+namespace AssetPack
+{
+    static constexpr int MaxAssetCount = 256;
+
+    /* Asset defined by DEFINE_ASSET in pack builds, it points into the pack once mounted. */
+    struct SPackedAsset
+    {
+        SAsset Asset;
+        const char* PackPath{};
+
+        explicit SPackedAsset(const char* InPackPath, const char* RelativeAssetPath);
+    };
+
+    /* Maps the pack and points every packed asset into it. Uncompressed entries are used in place, so their pages
+     * are only read once something touches them, compressed entries are inflated into the heap. The packer only
+     * compresses small entries, see AssetPacker.cxx. */
+    bool Mount(const char* Path);
+    void Unmount();
+}
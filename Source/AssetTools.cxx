@@ -3,8 +3,10 @@
 #include <algorithm>
 #include <string>
 #include <array>
+#include <utility>
 #include "Utility.hxx"
 #include "Memory.hxx"
+#include "Log.hxx"
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_NO_JPEG
@@ -16,9 +18,9 @@
 #define STBI_NO_HDR
 #define STBI_NO_TGA
 #define STBI_NO_FAILURE_STRINGS
-#define STBI_MALLOC Memory::Malloc
-#define STBI_REALLOC Memory::Realloc
-#define STBI_FREE Memory::Free
+#define STBI_MALLOC(Size) Memory::Malloc(Size, EMemoryCategory::Stb)
+#define STBI_REALLOC(Ptr, Size) Memory::Realloc(Ptr, Size, EMemoryCategory::Stb)
+#define STBI_FREE(Ptr) Memory::Free(Ptr)
 
 #include <stb/stb_image.h>
 
@@ -41,6 +43,62 @@ SAsset::SAsset(const char* InData, size_t InLength)
     : Data(reinterpret_cast<const unsigned char*>(InData)), Length(InLength){};
 #endif
 
+/* Open addressing (linear probing) map from OBJ position/uv/normal index triples to deduplicated vertices.
+ * Slots store the vertex index + 1, zero marks an empty slot; the triples themselves live in Keys. */
+struct SVertexIndexMap
+{
+    std::pmr::vector<uint32_t> Slots = Memory::GetVector<uint32_t>();
+    std::size_t Count{};
+
+    [[nodiscard]] static std::size_t Hash(const SVec3Size& Key)
+    {
+        uint64_t Value = Key.X * 0x9E3779B97F4A7C15ull;
+        Value ^= Key.Y * 0xC2B2AE3D27D4EB4Full + (Value >> 29);
+        Value ^= Key.Z * 0x165667B19E3779F9ull + (Value >> 32);
+        return static_cast<std::size_t>(Value ^ (Value >> 31));
+    }
+
+    void Rehash(std::size_t Capacity, const std::pmr::vector<SVec3Size>& Keys)
+    {
+        Slots.assign(Capacity, 0);
+        for (std::size_t Index = 0; Index < Count; ++Index)
+        {
+            auto Slot = Hash(Keys[Index]) & (Capacity - 1);
+            while (Slots[Slot] != 0)
+            {
+                Slot = (Slot + 1) & (Capacity - 1);
+            }
+            Slots[Slot] = static_cast<uint32_t>(Index + 1);
+        }
+    }
+
+    /* Returns the index of an existing vertex, or appends Key to Keys and returns its new index. */
+    std::size_t FindOrAdd(const SVec3Size& Key, std::pmr::vector<SVec3Size>& Keys)
+    {
+        /* Keep the load factor at or below one half. */
+        if ((Count + 1) * 2 > Slots.size())
+        {
+            Rehash(std::max<std::size_t>(Slots.size() * 2, 64), Keys);
+        }
+
+        auto Mask = Slots.size() - 1;
+        auto Slot = Hash(Key) & Mask;
+        while (Slots[Slot] != 0)
+        {
+            auto Existing = Slots[Slot] - 1;
+            if (Keys[Existing] == Key)
+            {
+                return Existing;
+            }
+            Slot = (Slot + 1) & Mask;
+        }
+
+        Keys.emplace_back(Key);
+        Slots[Slot] = static_cast<uint32_t>(++Count);
+        return Count - 1;
+    }
+};
+
 CRawMesh::CRawMesh(const SAsset& Resource)
     : Positions(Memory::GetVector<SVec3>()), TexCoords(Memory::GetVector<SVec2>()), Normals(Memory::GetVector<SVec3>()), Indices(Memory::GetVector<unsigned short>())
 {
@@ -48,85 +106,110 @@ CRawMesh::CRawMesh(const SAsset& Resource)
     auto ScratchTexCoords = Memory::GetVector<SVec2>();
     auto ScratchNormals = Memory::GetVector<SVec3>();
     auto ScratchOBJIndices = Memory::GetVector<SVec3Size>();
+    SVertexIndexMap VertexIndexMap{};
 
     Positions.clear();
     Normals.clear();
     TexCoords.clear();
 
-    auto OBJLength = (size_t)Resource.Length;
-    std::string_view OBJContents{ reinterpret_cast<const char*>(Resource.Data), OBJLength };
-
-    size_t CurrentIndex{};
-    while (CurrentIndex < OBJLength)
+    const char* Cursor = Resource.SignedCharPtr();
+    const char* const End = Cursor + Resource.Length;
+    while (Cursor < End)
     {
         /** Each line is "$token $data" e. g. "v 1.0 1.0 1.0" */
-        auto TokenEndIndex = OBJContents.find(' ', CurrentIndex);
-        auto Token = std::string_view{ &OBJContents[CurrentIndex], TokenEndIndex - CurrentIndex };
-        CurrentIndex = TokenEndIndex;
-        auto DataEndIndex = OBJContents.find('\n', CurrentIndex);
-        std::string_view Data{ &OBJContents[CurrentIndex + 1], DataEndIndex - CurrentIndex };
-        CurrentIndex = DataEndIndex;
+        auto LineEnd = Utility::FindLineEnd(Cursor, End);
+        auto TokenEnd = std::find(Cursor, LineEnd, ' ');
+        auto Token = std::string_view{ Cursor, static_cast<std::size_t>(TokenEnd - Cursor) };
+        const char* Data = TokenEnd == LineEnd ? LineEnd : TokenEnd + 1;
         if (Token == "v")
         {
             SVec3 Position{};
-            Utility::ParseFloats(Data.data(), Data.data() + Data.size(), &Position.X, 3);
+            Utility::ParseFloatLine(Data, LineEnd, &Position.X, 3, End);
             ScratchPositions.emplace_back(Position);
         }
         else if (Token == "vn")
         {
             SVec3 Normal{};
-            Utility::ParseFloats(Data.data(), Data.data() + Data.size(), &Normal.X, 3);
+            Utility::ParseFloatLine(Data, LineEnd, &Normal.X, 3, End);
             ScratchNormals.emplace_back(Normal);
         }
         else if (Token == "vt")
         {
             SVec2 TexCoord{};
-            Utility::ParseFloats(Data.data(), Data.data() + Data.size(), &TexCoord.X, 2);
+            Utility::ParseFloatLine(Data, LineEnd, &TexCoord.X, 2, End);
             ScratchTexCoords.emplace_back(TexCoord);
         }
         else if (Token == "f")
         {
             std::array<int, 9> OBJIndices{};
-            Utility::ParseInts(Data.data(), Data.data() + Data.size(), &OBJIndices[0], OBJIndices.size());
+            Utility::ParseIntLine(Data, LineEnd, OBJIndices.data(), (int)OBJIndices.size(), End);
             for (size_t Index = 0; Index < OBJIndices.size(); Index += 3)
             {
                 SVec3Size OBJIndex{};
                 OBJIndex.X = OBJIndices[Index] - 1;
                 OBJIndex.Y = OBJIndices[Index + 1] - 1;
                 OBJIndex.Z = OBJIndices[Index + 2] - 1;
-                auto ExistingOBJIndex = std::find(ScratchOBJIndices.begin(), ScratchOBJIndices.end(), OBJIndex);
-                if (ExistingOBJIndex == ScratchOBJIndices.end())
+                auto VertexIndex = VertexIndexMap.FindOrAdd(OBJIndex, ScratchOBJIndices);
+                if (VertexIndex == Positions.size())
                 {
+                    /** Freshly added vertex */
                     Positions.emplace_back(ScratchPositions[OBJIndex.X]);
                     TexCoords.emplace_back(ScratchTexCoords[OBJIndex.Y]);
                     Normals.emplace_back(ScratchNormals[OBJIndex.Z]);
-
-                    ScratchOBJIndices.emplace_back(OBJIndex);
-
-                    /** Add freshly added vertex index */
-                    Indices.emplace_back(Positions.size() - 1);
                 }
-                else
-                {
-                    std::size_t ExistingIndex = std::distance(std::begin(ScratchOBJIndices), ExistingOBJIndex);
-                    Indices.emplace_back(ExistingIndex);
-                }
-            }
-        }
-        else
-        {
-            /** Unused; Skip to next line */
-            CurrentIndex = OBJContents.find('\n', CurrentIndex);
-            if (CurrentIndex == std::string::npos)
-            {
-                break;
+                Indices.emplace_back(VertexIndex);
             }
         }
+        /** Anything else is unused */
 
-        CurrentIndex++;
+        Cursor = LineEnd + 1;
     }
 }
 
+SCookedMesh::SCookedMesh(const SAsset& Resource)
+{
+    auto Header = reinterpret_cast<const SCookedMeshHeader*>(Resource.Data);
+    if (Resource.Length < sizeof(SCookedMeshHeader) || Header->Magic != SCookedMeshHeader::CurrentMagic || Header->Version != SCookedMeshHeader::CurrentVersion)
+    {
+        Log::Draw<ELogLevel::Critical>("Cooked mesh has an invalid header, rerun the mesh cooker");
+        return;
+    }
+
+    auto Expected = sizeof(SCookedMeshHeader) + (Header->VertexCount * sizeof(SCookedVertex)) + (Header->IndexCount * sizeof(uint16_t));
+    if (Resource.Length < Expected)
+    {
+        Log::Draw<ELogLevel::Critical>("Cooked mesh is truncated: %zu bytes, expected %zu", Resource.Length, Expected);
+        return;
+    }
+
+    Vertices = reinterpret_cast<const SCookedVertex*>(Resource.Data + sizeof(SCookedMeshHeader));
+    Indices = reinterpret_cast<const uint16_t*>(Vertices + Header->VertexCount);
+    VertexCount = (int)Header->VertexCount;
+    IndexCount = (int)Header->IndexCount;
+}
+
+SCookedAtlas::SCookedAtlas(const SAsset& Resource)
+{
+    auto Header = reinterpret_cast<const SCookedAtlasHeader*>(Resource.Data);
+    if (Resource.Length < sizeof(SCookedAtlasHeader) || Header->Magic != SCookedAtlasHeader::CurrentMagic || Header->Version != SCookedAtlasHeader::CurrentVersion)
+    {
+        Log::Draw<ELogLevel::Critical>("Cooked atlas has an invalid header, rerun the atlas cooker");
+        return;
+    }
+
+    auto Expected = sizeof(SCookedAtlasHeader) + (std::size_t(Header->Width) * Header->Height * 4);
+    if (Resource.Length < Expected)
+    {
+        Log::Draw<ELogLevel::Critical>("Cooked atlas is truncated: %zu bytes, expected %zu", Resource.Length, Expected);
+        return;
+    }
+
+    Pixels = Resource.Data + sizeof(SCookedAtlasHeader);
+    Width = (int)Header->Width;
+    Height = (int)Header->Height;
+    SpriteCount = (int)Header->SpriteCount;
+}
+
 CRawImage::CRawImage(const SAsset& Resource)
 {
     Data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(Resource.Data), (int)Resource.Length,
@@ -135,6 +218,24 @@ CRawImage::CRawImage(const SAsset& Resource)
         4);
 }
 
+CRawImage::CRawImage(CRawImage&& Other) noexcept
+    : Width(Other.Width), Height(Other.Height), Channels(Other.Channels), Data(std::exchange(Other.Data, nullptr))
+{
+}
+
+CRawImage& CRawImage::operator=(CRawImage&& Other) noexcept
+{
+    if (this != &Other)
+    {
+        stbi_image_free(Data);
+        Width = Other.Width;
+        Height = Other.Height;
+        Channels = Other.Channels;
+        Data = std::exchange(Other.Data, nullptr);
+    }
+    return *this;
+}
+
 CRawImage::~CRawImage()
 {
     stbi_image_free(Data);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory_resource>
@@ -9,7 +10,12 @@
     #include <filesystem>
 #endif
 
-#define EXTERN_ASSET(NAME) extern const SAsset NAME;
+/* Pack builds resolve assets at runtime, they're references to the asset storage in AssetDef.cxx. */
+#ifdef EQUINOX_REACH_ASSET_PACK
+    #define EXTERN_ASSET(NAME) extern const SAsset& NAME;
+#else
+    #define EXTERN_ASSET(NAME) extern const SAsset NAME;
+#endif
 
 struct SAsset
 {
@@ -53,6 +59,73 @@ public:
     CRawMesh(const SAsset& Resource);
 };
 
+/* Cooked meshes are produced at build time by the mesh cooker tool from OBJ files:
+ * SCookedMeshHeader, then VertexCount interleaved SCookedVertex, then IndexCount 16-bit indices. */
+struct SCookedMeshHeader
+{
+    static constexpr uint32_t CurrentMagic = 0x534D5245; /* "ERMS" */
+    static constexpr uint32_t CurrentVersion = 1;
+
+    uint32_t Magic = CurrentMagic;
+    uint32_t Version = CurrentVersion;
+    uint32_t VertexCount{};
+    uint32_t IndexCount{};
+};
+
+struct SCookedVertex
+{
+    SVec3 Position{};
+    SVec2 TexCoord{};
+    SVec3 Normal{};
+};
+
+static_assert(sizeof(SCookedMeshHeader) == 16, "Cooked mesh header is read straight from the asset");
+static_assert(sizeof(SCookedVertex) == 32, "Cooked vertices are uploaded straight from the asset");
+
+/* View into a cooked mesh asset, nothing is copied. */
+struct SCookedMesh
+{
+    const SCookedVertex* Vertices{};
+    const uint16_t* Indices{};
+    int VertexCount{};
+    int IndexCount{};
+
+    explicit SCookedMesh(const SAsset& Resource);
+
+    [[nodiscard]] bool IsValid() const { return Vertices != nullptr; }
+};
+
+/* Cooked atlases are packed at build time by the atlas cooker tool from a list of PNG files:
+ * SCookedAtlasHeader, then Width * Height RGBA pixels. Rows below the packed sprites are cropped,
+ * the sprite UV table is generated as a header next to the atlas. */
+struct SCookedAtlasHeader
+{
+    static constexpr uint32_t CurrentMagic = 0x54415245; /* "ERAT" */
+    static constexpr uint32_t CurrentVersion = 1;
+
+    uint32_t Magic = CurrentMagic;
+    uint32_t Version = CurrentVersion;
+    uint32_t Width{};
+    uint32_t Height{};
+    uint32_t SpriteCount{};
+    uint32_t Padding{};
+};
+
+static_assert(sizeof(SCookedAtlasHeader) == 24, "Cooked atlas header is read straight from the asset");
+
+/* View into a cooked atlas asset, nothing is copied. */
+struct SCookedAtlas
+{
+    const unsigned char* Pixels{};
+    int Width{};
+    int Height{};
+    int SpriteCount{};
+
+    explicit SCookedAtlas(const SAsset& Resource);
+
+    [[nodiscard]] bool IsValid() const { return Pixels != nullptr; }
+};
+
 class CRawImage
 {
 public:
@@ -61,7 +134,12 @@ public:
     int Channels{};
     void* Data{};
 
+    CRawImage() = default;
     explicit CRawImage(const SAsset& Resource);
+    CRawImage(const CRawImage&) = delete;
+    CRawImage(CRawImage&& Other) noexcept;
+    CRawImage& operator=(const CRawImage&) = delete;
+    CRawImage& operator=(CRawImage&& Other) noexcept;
     ~CRawImage();
 };
 
@@ -8,6 +8,7 @@
 #include <cstring>
 #include "AssetTools.hxx"
 #include "Log.hxx"
+#include "Memory.hxx"
 
 namespace Asset::Common
 {
@@ -17,6 +18,8 @@ namespace Asset::Common
 
 void SDLCALL SAudio::Callback(void* Userdata, struct SDL_AudioStream* Stream, int AdditionalAmount, [[maybe_unused]] int TotalAmount)
 {
+    Memory::SAllocationGuard AllocationGuard{ "SAudio::Callback" };
+
     auto Audio = static_cast<SAudio*>(Userdata);
     if (AdditionalAmount > 0)
     {
@@ -55,7 +58,7 @@ void SAudio::Clear() const
     SDL_ClearAudioStream(Stream);
 }
 
-void SAudio::Init()
+void SAudio::Init(Jobs::SCounter& LoadCounter)
 {
     AudioSpec = { SDL_AUDIO_S16, 2, 44100 };
     if (SDL_InitSubSystem(SDL_INIT_AUDIO) != true)
@@ -78,8 +81,13 @@ void SAudio::Init()
 
     SDL_ResumeAudioDevice(SDL_GetAudioStreamDevice(Stream));
 
-    LoadSoundClip(Asset::Common::Tile_01WAV, TestSoundClip);
-    LoadSoundClip(Asset::Common::TestMusicWAV, TestMusic);
+    QueueLoadSoundClip(Asset::Common::Tile_01WAV, TestSoundClip, LoadCounter);
+    QueueLoadSoundClip(Asset::Common::TestMusicWAV, TestMusic, LoadCounter);
+}
+
+void SAudio::FinishLoading()
+{
+    PendingLoadCount = 0;
 
     Queue[1].SoundClip = &TestMusic;
     Queue[1].bLoop = true;
@@ -118,6 +126,25 @@ void SAudio::LoadSoundClip(const SAsset& Asset, SSoundClip& SoundClip) const
     SDL_free(TempPtr);
 }
 
+void SAudio::LoadSoundClipJob(void* Data)
+{
+    auto& Load = *static_cast<SSoundClipLoad*>(Data);
+    Load.Audio->LoadSoundClip(*Load.Asset, *Load.SoundClip);
+}
+
+void SAudio::QueueLoadSoundClip(const SAsset& Asset, SSoundClip& SoundClip, Jobs::SCounter& Counter)
+{
+    if (PendingLoadCount == static_cast<int>(PendingLoads.size()))
+    {
+        LoadSoundClip(Asset, SoundClip);
+        return;
+    }
+
+    auto& Load = PendingLoads[PendingLoadCount++];
+    Load = { this, &Asset, &SoundClip };
+    Jobs::Run(Counter, &LoadSoundClipJob, &Load);
+}
+
 void SAudio::TestAudio()
 {
     Play(TestSoundClip);
@@ -2,6 +2,7 @@
 
 #include <array>
 #include "AssetTools.hxx"
+#include "Jobs.hxx"
 #include "SDL3/SDL_audio.h"
 
 struct SAudioSpec
@@ -56,6 +57,13 @@ struct SAudioEntry
     }
 };
 
+struct SSoundClipLoad
+{
+    const struct SAudio* Audio{};
+    const SAsset* Asset{};
+    SSoundClip* SoundClip{};
+};
+
 struct SAudio
 {
 protected:
@@ -65,17 +73,25 @@ protected:
     struct SDL_AudioStream* Stream{};
     SSoundClip TestSoundClip{};
     SSoundClip TestMusic{};
+    std::array<SSoundClipLoad, 8> PendingLoads{};
+    int PendingLoadCount{};
 
     void Clear() const;
 
+    static void LoadSoundClipJob(void* Data);
+
 public:
     float Volume = 0.30f;
 
-    void Init();
+    /* Queues conversion of the built-in clips, FinishLoading() once LoadCounter is done. */
+    void Init(Jobs::SCounter& LoadCounter);
+    void FinishLoading();
     void Cleanup();
 
     static void Callback(void* Userdata, struct SDL_AudioStream* Stream, int AdditionalAmount, int TotalAmount);
     void LoadSoundClip(const SAsset& Asset, SSoundClip& SoundClip) const;
+    /* SoundClip is filled on a worker thread, it is valid after FinishLoading(). */
+    void QueueLoadSoundClip(const SAsset& Asset, SSoundClip& SoundClip, Jobs::SCounter& Counter);
     void TestAudio();
     void Play(const SSoundClip& SoundClip);
 };
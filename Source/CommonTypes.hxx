@@ -139,6 +139,13 @@ struct SDirection
         }
     }
 
+    /* RotationFromDirection() in 1/65536 turns. */
+    [[nodiscard]] constexpr uint16_t YawFromDirection() const
+    {
+        constexpr uint16_t Yaws[Count] = { 0x0000, 0xC000, 0x8000, 0x4000 };
+        return Yaws[Index & 0x3];
+    }
+
     bool operator==(const SDirection& Other) const
     {
         return Index == Other.Index;
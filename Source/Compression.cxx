@@ -0,0 +1,181 @@
+#include "Compression.hxx"
+
+#include <algorithm>
+#include <cstring>
+#include "Memory.hxx"
+
+namespace Compression
+{
+    static constexpr int HashBits = 16;
+    static constexpr uint32_t EmptySlot = UINT32_MAX;
+    static constexpr std::size_t ExtendedLength = 15;
+
+    static uint32_t Read32(const uint8_t* Source)
+    {
+        uint32_t Value;
+        std::memcpy(&Value, Source, sizeof(Value));
+        return Value;
+    }
+
+    static uint32_t Hash(uint32_t Value)
+    {
+        return (Value * 2654435761u) >> (32 - HashBits);
+    }
+
+    static uint8_t* WriteExtendedLength(uint8_t* Destination, std::size_t Length)
+    {
+        for (; Length >= 255; Length -= 255)
+        {
+            *Destination++ = 255;
+        }
+        *Destination++ = static_cast<uint8_t>(Length);
+        return Destination;
+    }
+
+    static bool ReadExtendedLength(const uint8_t*& Source, const uint8_t* End, std::size_t& Length)
+    {
+        uint8_t Byte;
+        do
+        {
+            if (Source == End)
+            {
+                return false;
+            }
+            Byte = *Source++;
+            Length += Byte;
+        } while (Byte == 255);
+        return true;
+    }
+
+    /* MatchLength is 0 for the last sequence, which only carries literals. */
+    static uint8_t* WriteSequence(uint8_t* Destination, const uint8_t* Literals, std::size_t LiteralCount, std::size_t Offset, std::size_t MatchLength)
+    {
+        std::size_t MatchCode = MatchLength > 0 ? MatchLength - MinMatchLength : 0;
+        *Destination++ = static_cast<uint8_t>((std::min(LiteralCount, ExtendedLength) << 4) | std::min(MatchCode, ExtendedLength));
+        if (LiteralCount >= ExtendedLength)
+        {
+            Destination = WriteExtendedLength(Destination, LiteralCount - ExtendedLength);
+        }
+
+        std::memcpy(Destination, Literals, LiteralCount);
+        Destination += LiteralCount;
+        if (MatchLength == 0)
+        {
+            return Destination;
+        }
+
+        *Destination++ = static_cast<uint8_t>(Offset & 0xFF);
+        *Destination++ = static_cast<uint8_t>(Offset >> 8);
+        if (MatchCode >= ExtendedLength)
+        {
+            Destination = WriteExtendedLength(Destination, MatchCode - ExtendedLength);
+        }
+        return Destination;
+    }
+
+    std::size_t Compress(const uint8_t* Source, std::size_t Length, uint8_t* Destination)
+    {
+        /* Last position seen for each hash of 4 bytes, greedy parsing takes the first match found. */
+        auto Table = Memory::GetVector<uint32_t>();
+        Table.resize(std::size_t(1) << HashBits, EmptySlot);
+
+        const uint8_t* End = Source + Length;
+        const uint8_t* Anchor = Source;
+        const uint8_t* Cursor = Source;
+        uint8_t* Output = Destination;
+
+        while (Cursor + MinMatchLength <= End)
+        {
+            auto Value = Read32(Cursor);
+            auto& Slot = Table[Hash(Value)];
+            auto Candidate = Slot;
+            auto Position = static_cast<uint32_t>(Cursor - Source);
+            Slot = Position;
+
+            if (Candidate == EmptySlot || Position - Candidate > MaxOffset || Read32(Source + Candidate) != Value)
+            {
+                ++Cursor;
+                continue;
+            }
+
+            const uint8_t* Match = Source + Candidate;
+            std::size_t MatchLength = MinMatchLength;
+            while (Cursor + MatchLength < End && Match[MatchLength] == Cursor[MatchLength])
+            {
+                ++MatchLength;
+            }
+
+            Output = WriteSequence(Output, Anchor, std::size_t(Cursor - Anchor), std::size_t(Cursor - Match), MatchLength);
+            Cursor += MatchLength;
+            Anchor = Cursor;
+        }
+
+        Output = WriteSequence(Output, Anchor, std::size_t(End - Anchor), 0, 0);
+        return std::size_t(Output - Destination);
+    }
+
+    bool Decompress(const uint8_t* Source, std::size_t Length, uint8_t* Destination, std::size_t DestinationLength)
+    {
+        const uint8_t* End = Source + Length;
+        uint8_t* Output = Destination;
+        uint8_t* OutputEnd = Destination + DestinationLength;
+
+        while (Source < End)
+        {
+            uint8_t Token = *Source++;
+
+            std::size_t LiteralCount = Token >> 4;
+            if (LiteralCount == ExtendedLength && !ReadExtendedLength(Source, End, LiteralCount))
+            {
+                return false;
+            }
+            if (LiteralCount > std::size_t(End - Source) || LiteralCount > std::size_t(OutputEnd - Output))
+            {
+                return false;
+            }
+            std::memcpy(Output, Source, LiteralCount);
+            Source += LiteralCount;
+            Output += LiteralCount;
+
+            if (Source == End)
+            {
+                break;
+            }
+
+            if (End - Source < 2)
+            {
+                return false;
+            }
+            std::size_t Offset = Source[0] | (Source[1] << 8);
+            Source += 2;
+
+            std::size_t MatchLength = (Token & 15);
+            if (MatchLength == ExtendedLength && !ReadExtendedLength(Source, End, MatchLength))
+            {
+                return false;
+            }
+            MatchLength += MinMatchLength;
+            if (Offset == 0 || Offset > std::size_t(Output - Destination) || MatchLength > std::size_t(OutputEnd - Output))
+            {
+                return false;
+            }
+
+            /* Matches may overlap the bytes they produce, e.g. runs with an offset of 1. */
+            const uint8_t* Match = Output - Offset;
+            if (Offset >= MatchLength)
+            {
+                std::memcpy(Output, Match, MatchLength);
+            }
+            else
+            {
+                for (std::size_t Index = 0; Index < MatchLength; ++Index)
+                {
+                    Output[Index] = Match[Index];
+                }
+            }
+            Output += MatchLength;
+        }
+
+        return Output == OutputEnd;
+    }
+}
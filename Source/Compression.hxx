@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* Byte-oriented LZ77 in the spirit of LZ4, used for asset pack entries.
+ * A block is a list of sequences: a token (literal count in the high nibble, match length - MinMatchLength in the
+ * low nibble, 15 means more length bytes follow), the literals, then a 16-bit little endian offset and the extra
+ * match length bytes. The last sequence has literals only. */
+namespace Compression
+{
+    static constexpr std::size_t MinMatchLength = 4;
+    static constexpr std::size_t MaxOffset = 65535;
+
+    /* Worst case size of a compressed block. */
+    [[nodiscard]] constexpr std::size_t CompressBound(std::size_t Length)
+    {
+        return Length + (Length / 255) + 16;
+    }
+
+    /* Returns the compressed size, Destination must hold CompressBound(Length) bytes. */
+    std::size_t Compress(const uint8_t* Source, std::size_t Length, uint8_t* Destination);
+
+    /* Returns false if the block is malformed or doesn't decompress to exactly DestinationLength bytes. */
+    [[nodiscard]] bool Decompress(const uint8_t* Source, std::size_t Length, uint8_t* Destination, std::size_t DestinationLength);
+}
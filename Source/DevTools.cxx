@@ -1,5 +1,6 @@
 #include "DevTools.hxx"
 
+#include <bitset>
 #include <fstream>
 #include <glad/gl.h>
 #include <SDL3/SDL.h>
@@ -22,6 +23,24 @@
 
 #define PARTY_SLOT_COLOR (ImGui::GetColorU32(IM_COL32(100, 75, 230, 200)))
 #define HPBAR_COLOR (ImGui::GetColorU32(IM_COL32(255, 19, 25, 255)))
+#define HEAP_FREE_COLOR (ImGui::GetColorU32(IM_COL32(40, 40, 40, 255)))
+#define HEAP_WARNING_COLOR (ImVec4(1.0f, 0.3f, 0.3f, 1.0f))
+#define VISIBLE_CELL_COLOR (ImGui::GetColorU32(IM_COL32(60, 170, 70, 255)))
+#define CULLED_CELL_COLOR (ImGui::GetColorU32(IM_COL32(170, 50, 50, 255)))
+#define POV_CELL_COLOR (ImGui::GetColorU32(IM_COL32(240, 240, 120, 255)))
+#define CELL_WALL_COLOR (ImGui::GetColorU32(IM_COL32(220, 220, 220, 255)))
+
+/* Block map colors, indexed by EMemoryCategory. */
+static constexpr ImU32 HeapCategoryColors[] = {
+    IM_COL32(80, 160, 255, 255),
+    IM_COL32(255, 190, 60, 255),
+    IM_COL32(120, 220, 100, 255),
+    IM_COL32(220, 90, 220, 255),
+    IM_COL32(240, 240, 120, 255),
+};
+
+static constexpr std::size_t HeapMapColumns = 128;
+static constexpr std::size_t HeapMapRows = 64;
 
 namespace Asset::Common
 {
@@ -173,7 +192,7 @@ void SWorldEditor::EditorDraw(const SVec2& ScaledSize)
 {
     auto& Renderer = Game->Renderer;
     Renderer.GlobalsUniformBlock.SetVector2(offsetof(SShaderGlobals, ScreenSize), ScaledSize);
-    Renderer.ProgramMap.SetCursor(CursorPosition.XY());
+    Renderer.MapUniformBlocks.SetCursor(CursorPosition.XY());
     Renderer.DrawWorldMapImmediate({ 0.0f, 0.0f }, ScaledSize);
 }
 
@@ -460,7 +479,7 @@ void SLevelEditor::EditorDraw(const SVec2& ScaledSize)
 {
     auto& Renderer = Game->Renderer;
     Renderer.GlobalsUniformBlock.SetVector2(offsetof(SShaderGlobals, ScreenSize), ScaledSize);
-    Renderer.ProgramMap.SetCursor(CursorPosition.XY());
+    Renderer.MapUniformBlocks.SetCursor(CursorPosition.XY());
     if (bLevelChanged)
     {
         Renderer.UploadMapData(&Level, Game->Blob.UnreliableCoordsAndDirection());
@@ -468,7 +487,7 @@ void SLevelEditor::EditorDraw(const SVec2& ScaledSize)
     }
     if (bEditorStateChanged)
     {
-        Renderer.ProgramMap.SetEditorData(
+        Renderer.MapUniformBlocks.SetEditorData(
             SVec2(SelectedTileCoords),
             SVec4(BlockModeTileCoords, SelectedTileCoords),
             true,
@@ -986,7 +1005,7 @@ void SDevTools::DrawParty(SParty& Party, float Scale, [[maybe_unused]] bool bRev
 
         if (Slot.IsRealChar())
         {
-            auto Char = Slot.GetRealChar();
+            auto Char = *Party.GetChar(Slot);
 
             auto SlotPosMin = ImVec2((float)CurrentCol * SlotWidth,
                 (float)CurrentRow * SlotHeight);
@@ -1079,6 +1098,9 @@ void SDevTools::Init(SGame* InGame)
     Game = InGame;
 
     IMGUI_CHECKVERSION();
+    ImGui::SetAllocatorFunctions(
+        []([[maybe_unused]] size_t Bytes, [[maybe_unused]] void* UserData) { return Memory::Malloc(Bytes, EMemoryCategory::ImGui); },
+        []([[maybe_unused]] void* Ptr, [[maybe_unused]] void* UserData) { Memory::Free(Ptr); });
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
     io.IniFilename = nullptr;
@@ -1155,13 +1177,13 @@ void SDevTools::Update()
 
     if (bEditorOpened)
     {
-        Game->Renderer.ProgramMap.SetEditorData(SVec2(), SVec4(), true, false, false);
+        Game->Renderer.MapUniformBlocks.SetEditorData(SVec2(), SVec4(), true, false, false);
     }
 
     if (bReturnedToGame)
     {
         /* @TODO: Revert cursor changes? */
-        Game->Renderer.ProgramMap.SetEditorData(SVec2(), SVec4(), false, false, false);
+        Game->Renderer.MapUniformBlocks.SetEditorData(SVec2(), SVec4(), false, false, false);
         Game->Renderer.UploadMapData(Game->World.GetLevel(), Game->Blob.UnreliableCoordsAndDirection());
     }
 
@@ -1181,6 +1203,187 @@ void SDevTools::Update()
     }
 }
 
+void SDevTools::ShowHeapInfo() const
+{
+    auto Stats = Memory::GetStats();
+
+    ImGui::Text("Heap: %zu / %zu bytes (peak %zu)", Stats.BytesInUse, Stats.HeapSize, Stats.PeakBytesInUse);
+    ImGui::Text("Heap Growths: %zu", Stats.HeapGrowthCount);
+    ImGui::Text("Allocations / Frees Last Frame: %zu / %zu", Stats.FrameAllocations, Stats.FrameFrees);
+    ImGui::Text("Thread Cached Blocks: %zu", Stats.CachedBlocks);
+    ImGui::Text("Free: %zu bytes, Largest Gap: %zu bytes, Fragmentation: %.2f", Stats.FreeBytes, Stats.LargestFreeBlock, Stats.Fragmentation);
+
+    /* Anything that doesn't fit into the reserved range goes through ::operator new. */
+    if (Stats.UpstreamBytesInUse > 0)
+    {
+        ImGui::TextColored(HEAP_WARNING_COLOR, "Upstream Fallbacks: %zu (%zu bytes in use)", Stats.UpstreamFallbacks, Stats.UpstreamBytesInUse);
+    }
+    else
+    {
+        ImGui::Text("Upstream Fallbacks: %zu (%zu bytes in use)", Stats.UpstreamFallbacks, Stats.UpstreamBytesInUse);
+    }
+
+    for (std::size_t Category = 0; Category < Stats.CategoryBytes.size(); ++Category)
+    {
+        ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(HeapCategoryColors[Category]), "%s: %zu bytes", MemoryCategoryNames[Category], Stats.CategoryBytes[Category]);
+    }
+
+    if (ImGui::TreeNode("Allocation Guards"))
+    {
+        bool bTrap = Memory::IsAllocationGuardTrapEnabled();
+        if (ImGui::Checkbox("Trap On Violation", &bTrap))
+        {
+            Memory::SetAllocationGuardTrap(bTrap);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Reset"))
+        {
+            Memory::ResetAllocationGuardViolations();
+        }
+
+        bool bAnyViolation = false;
+        for (const auto& Violation : Memory::GetAllocationGuardViolations())
+        {
+            if (Violation.Tag != nullptr)
+            {
+                ImGui::TextColored(HEAP_WARNING_COLOR, "%s: %zu allocations (last %zu bytes)", Violation.Tag, Violation.Count, Violation.LastBytes);
+                bAnyViolation = true;
+            }
+        }
+        if (!bAnyViolation)
+        {
+            ImGui::Text("No allocations inside guarded scopes");
+        }
+        ImGui::TreePop();
+    }
+
+    if (Memory::IsTracing())
+    {
+        if (ImGui::Button("Stop Allocation Trace"))
+        {
+            Memory::StopTrace();
+        }
+    }
+    else if (ImGui::Button("Start Allocation Trace"))
+    {
+        Memory::StartTrace("AllocationTrace.ermt");
+    }
+
+    if (ImGui::TreeNode("Block Map"))
+    {
+        std::array<uint8_t, HeapMapColumns * HeapMapRows> Cells{};
+        Memory::GetBlockMap(Cells.data(), Cells.size());
+
+        float CellSize = ImGui::GetFontSize() * 0.25f;
+        auto* DrawList = ImGui::GetWindowDrawList();
+        ImVec2 Origin = ImGui::GetCursorScreenPos();
+
+        /* Runs of equally colored cells are drawn as a single rectangle. */
+        for (std::size_t Row = 0; Row < HeapMapRows; ++Row)
+        {
+            std::size_t RunStart = 0;
+            for (std::size_t Column = 1; Column <= HeapMapColumns; ++Column)
+            {
+                uint8_t RunValue = Cells[Row * HeapMapColumns + RunStart];
+                if (Column < HeapMapColumns && Cells[Row * HeapMapColumns + Column] == RunValue)
+                {
+                    continue;
+                }
+
+                ImVec2 Min = { Origin.x + float(RunStart) * CellSize, Origin.y + float(Row) * CellSize };
+                ImVec2 Max = { Origin.x + float(Column) * CellSize, Min.y + CellSize };
+                DrawList->AddRectFilled(Min, Max, RunValue == 0 ? HEAP_FREE_COLOR : HeapCategoryColors[RunValue - 1]);
+                RunStart = Column;
+            }
+        }
+
+        ImGui::Dummy({ float(HeapMapColumns) * CellSize, float(HeapMapRows) * CellSize });
+        ImGui::Text("One cell: %zu bytes", (Stats.HeapSize + Cells.size() - 1) / Cells.size());
+        ImGui::TreePop();
+    }
+}
+
+void SDevTools::ShowCulledCells() const
+{
+    const SWorldLevel* Level = Game->World.GetLevel();
+    const auto& Renderer = Game->Renderer;
+    auto const POVCoords = Game->Blob.Coords;
+    auto const POVDirection = Game->Blob.Direction;
+
+    /* Same choice as SRenderer::Draw3DLevel(), pulled levels have no draw set. */
+    if (Renderer.bPullLevels && Renderer.LevelTiles.Level == Level && Renderer.LevelDrawSet.DrawData.TileSet != nullptr)
+    {
+        ImGui::Text("Level geometry is pulled, nothing is culled");
+        return;
+    }
+
+    /* Same choice as SRenderer::BuildLevelDrawSet(). */
+    bool const bPortalCulling = Renderer.bPortalCulling || Level->DoorInfo.Timeline.IsPlaying();
+
+    std::bitset<MAX_LEVEL_TILE_COUNT> Visible{};
+    for (int Index = 0; Index < Renderer.LevelDrawSet.VisibleTileCount; ++Index)
+    {
+        Visible.set(Renderer.LevelDrawSet.VisibleTiles[Index]);
+    }
+
+    float CellSize = ImGui::GetFontSize() * 0.5f;
+    auto* DrawList = ImGui::GetWindowDrawList();
+    ImVec2 Origin = ImGui::GetCursorScreenPos();
+
+    for (int Y = 0; Y < Level->Height; ++Y)
+    {
+        for (int X = 0; X < Level->Width; ++X)
+        {
+            SVec2Int const Coords{ X, Y };
+            auto const bInRange = bPortalCulling ? STilemap::IsInPortalView(POVCoords, POVDirection, PortalCullingHalfFieldOfView, Coords)
+                                                 : STilemap::IsInVisibleSetView(POVCoords, POVDirection, Coords);
+
+            ImU32 Color = HEAP_FREE_COLOR;
+            if (Coords == POVCoords)
+            {
+                Color = POV_CELL_COLOR;
+            }
+            else if (Visible.test(Level->CoordsToIndex(Coords)))
+            {
+                Color = VISIBLE_CELL_COLOR;
+            }
+            else if (bInRange)
+            {
+                Color = CULLED_CELL_COLOR;
+            }
+
+            ImVec2 Min = { Origin.x + float(X) * CellSize, Origin.y + float(Y) * CellSize };
+            ImVec2 Max = { Min.x + CellSize, Min.y + CellSize };
+            DrawList->AddRectFilled(Min, Max, Color);
+
+            auto* Tile = Level->GetTileAt(Coords);
+            if (Tile == nullptr)
+            {
+                continue;
+            }
+            if (!Tile->IsEdgeEmpty(SDirection::North()))
+            {
+                DrawList->AddLine(Min, { Max.x, Min.y }, CELL_WALL_COLOR);
+            }
+            if (!Tile->IsEdgeEmpty(SDirection::East()))
+            {
+                DrawList->AddLine({ Max.x, Min.y }, Max, CELL_WALL_COLOR);
+            }
+            if (!Tile->IsEdgeEmpty(SDirection::South()))
+            {
+                DrawList->AddLine({ Min.x, Max.y }, Max, CELL_WALL_COLOR);
+            }
+            if (!Tile->IsEdgeEmpty(SDirection::West()))
+            {
+                DrawList->AddLine(Min, { Min.x, Max.y }, CELL_WALL_COLOR);
+            }
+        }
+    }
+
+    ImGui::Dummy({ float(Level->Width) * CellSize, float(Level->Height) * CellSize });
+    ImGui::Text("Visible Tiles: %d (%s)", Renderer.LevelDrawSet.VisibleTileCount, bPortalCulling ? "portal culling" : "visible sets");
+}
+
 void SDevTools::ShowDebugTools() const
 {
     if (ImGui::Begin("Debug Tools", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
@@ -1190,6 +1393,7 @@ void SDevTools::ShowDebugTools() const
             ImGui::Text("Frames Per Second: %.f", 1000.0f / Game->Platform.DeltaTime / 1000.0f);
             ImGui::Text("Number Of Blocks: %zu", Memory::NumberOfBlocks());
             ImGui::Text("Display Scale: %d", Game->Renderer.MainFramebuffer.Scale);
+            ShowHeapInfo();
             ImGui::TreePop();
         }
         if (ImGui::TreeNode("Player Info"))
@@ -1205,6 +1409,36 @@ void SDevTools::ShowDebugTools() const
         if (ImGui::TreeNode("Level Tools"))
         {
             SWorldLevel* Level = Game->World.GetLevel();
+            if (ImGui::Checkbox("Bake Level Mesh", &Game->Renderer.bBakeLevels))
+            {
+                Game->Renderer.BakeLevel(Level);
+                Level->DirtyFlags |= ELevelDirtyFlags::DrawSet;
+            }
+            if (ImGui::Checkbox("Portal Culling", &Game->Renderer.bPortalCulling))
+            {
+                Game->Renderer.LevelDrawSetCache.Invalidate();
+                Level->DirtyFlags |= ELevelDirtyFlags::DrawSet;
+            }
+            if (ImGui::Checkbox("Depth Order Levels", &Game->Renderer.bDepthOrderLevels))
+            {
+                Game->Renderer.LevelDrawSetCache.Invalidate();
+                Level->DirtyFlags |= ELevelDirtyFlags::DrawSet;
+            }
+            if (ImGui::Checkbox("Pull Level Geometry", &Game->Renderer.bPullLevels))
+            {
+                Game->Renderer.LevelTiles.Upload(Level);
+                Level->DirtyFlags |= ELevelDirtyFlags::DrawSet;
+            }
+            if (ImGui::Checkbox("Cache Draw Sets", &Game->Renderer.bCacheDrawSets))
+            {
+                Game->Renderer.LevelDrawSetCache.Invalidate();
+                Level->DirtyFlags |= ELevelDirtyFlags::DrawSet;
+            }
+            if (ImGui::TreeNode("Culled Cells"))
+            {
+                ShowCulledCells();
+                ImGui::TreePop();
+            }
             if (ImGui::Button("Explore Level"))
             {
                 for (auto X = 0; X < Level->Width; X++)
@@ -115,6 +115,8 @@ struct SDevTools
 
     void Update();
 
+    void ShowHeapInfo() const;
+    void ShowCulledCells() const;
     void ShowDebugTools() const;
 
     static void DrawParty(struct SParty& Party, float Scale, bool bReversed);
@@ -1,7 +1,9 @@
 #include "Draw.hxx"
 
 #include <algorithm>
-#include <numeric>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
 #include "CommonTypes.hxx"
 #include "Log.hxx"
 #include "Tile.hxx"
@@ -11,8 +13,6 @@
 #include "Math.hxx"
 #include "Memory.hxx"
 
-#define SIZE_OF_VECTOR_ELEMENT(Vector) ((GLsizeiptr)sizeof(decltype(Vector)::value_type))
-
 static std::string const SharedConstants{
 #define SHARED_CONSTANTS_LITERAL
 #include "SharedConstants.hxx"
@@ -48,6 +48,199 @@ namespace Asset::Shader
     EXTERN_ASSET(PostProcessFRAG)
 }
 
+/* Linked programs are cached on disk with glGetProgramBinary, keyed by the shader sources and the driver.
+ * EQUINOX_REACH_PROGRAM_CACHE overrides the cache directory, an empty value disables the cache. */
+namespace ProgramCache
+{
+    struct SHeader
+    {
+        static constexpr uint32_t CurrentMagic = 0x42505245; /* "ERPB" */
+        static constexpr uint32_t CurrentVersion = 1;
+
+        uint32_t Magic = CurrentMagic;
+        uint32_t Version = CurrentVersion;
+        uint32_t BinaryFormat{};
+        uint32_t Length{};
+        uint64_t Key{};
+    };
+
+    static std::filesystem::path FindDirectory()
+    {
+        namespace fs = std::filesystem;
+
+        if (const char* Override = std::getenv("EQUINOX_REACH_PROGRAM_CACHE"))
+        {
+            return Override;
+        }
+
+#if defined(_WIN32)
+        const char* Base = std::getenv("LOCALAPPDATA");
+        fs::path Root = Base != nullptr ? fs::path(Base) : fs::path();
+#elif defined(__APPLE__)
+        const char* Home = std::getenv("HOME");
+        fs::path Root = Home != nullptr ? fs::path(Home) / "Library" / "Caches" : fs::path();
+#else
+        const char* XDGCache = std::getenv("XDG_CACHE_HOME");
+        const char* Home = std::getenv("HOME");
+        fs::path Root = XDGCache != nullptr && XDGCache[0] != '\0' ? fs::path(XDGCache) : Home != nullptr ? fs::path(Home) / ".cache" : fs::path();
+#endif
+        if (Root.empty())
+        {
+            std::error_code Error;
+            Root = fs::temp_directory_path(Error);
+        }
+        return Root.empty() ? Root : Root / "EquinoxReach" / "Programs";
+    }
+
+    /* Empty when the cache is disabled or the driver has no binary formats. */
+    static const std::filesystem::path& GetDirectory()
+    {
+        static const std::filesystem::path Directory = [] {
+            GLint FormatCount{};
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &FormatCount);
+            if (FormatCount == 0)
+            {
+                Log::Draw<ELogLevel::Info>("Driver has no program binary formats, program cache disabled");
+                return std::filesystem::path();
+            }
+
+            auto Path = FindDirectory();
+            std::error_code Error;
+            if (!Path.empty() && !std::filesystem::create_directories(Path, Error) && Error)
+            {
+                Log::Draw<ELogLevel::Info>("Can't create program cache %s, program cache disabled", Path.string().c_str());
+                return std::filesystem::path();
+            }
+            return Path;
+        }();
+        return Directory;
+    }
+
+    static uint64_t MakeKey(const char* VertexShader, int VertexShaderLength, const char* FragmentShader, int FragmentShaderLength, int Permutation)
+    {
+        auto HashString = [](const char* String, std::size_t Length, uint64_t Hash) {
+            /* Lengths keep "ab" + "c" apart from "a" + "bc". */
+            Hash = Utility::HashBytes(&Length, sizeof(Length), Hash);
+            return Utility::HashBytes(String, Length, Hash);
+        };
+        auto HashGLString = [&](GLenum Name, uint64_t Hash) {
+            auto* String = reinterpret_cast<const char*>(glGetString(Name));
+            return HashString(String != nullptr ? String : "", String != nullptr ? strlen(String) : 0, Hash);
+        };
+
+        uint64_t Key = HashString(Constants::GLSLVersion, strlen(Constants::GLSLVersion), Utility::HashSeed);
+        Key = HashString(SharedConstants.data(), SharedConstants.length(), Key);
+        Key = HashString(Asset::Shader::SharedGLSL.SignedCharPtr(), Asset::Shader::SharedGLSL.Length, Key);
+        Key = HashString(VertexShader, std::size_t(VertexShaderLength), Key);
+        Key = HashString(FragmentShader, std::size_t(FragmentShaderLength), Key);
+        Key = Utility::HashBytes(&Permutation, sizeof(Permutation), Key);
+        Key = HashGLString(GL_VENDOR, Key);
+        Key = HashGLString(GL_RENDERER, Key);
+        Key = HashGLString(GL_VERSION, Key);
+        return Key;
+    }
+
+    static std::filesystem::path GetPath(uint64_t Key)
+    {
+        char FileName[32];
+        std::snprintf(FileName, sizeof(FileName), "%016llx.bin", static_cast<unsigned long long>(Key));
+        return GetDirectory() / FileName;
+    }
+
+    /* Returns false if there's no usable binary, ProgramID is then still fine for a regular link. */
+    static bool Load(unsigned ProgramID, uint64_t Key)
+    {
+        if (GetDirectory().empty())
+        {
+            return false;
+        }
+
+        auto Path = GetPath(Key);
+        std::FILE* File = std::fopen(Path.string().c_str(), "rb");
+        if (File == nullptr)
+        {
+            return false;
+        }
+
+        SHeader Header{};
+        auto Binary = Memory::GetVector<char>();
+        bool bRead = std::fread(&Header, sizeof(Header), 1, File) == 1 && Header.Magic == SHeader::CurrentMagic &&
+            Header.Version == SHeader::CurrentVersion && Header.Key == Key && Header.Length > 0;
+        if (bRead)
+        {
+            Binary.resize(Header.Length);
+            bRead = std::fread(Binary.data(), Binary.size(), 1, File) == 1;
+        }
+        std::fclose(File);
+
+        GLint Success{};
+        if (bRead)
+        {
+            glProgramBinary(ProgramID, Header.BinaryFormat, Binary.data(), GLsizei(Binary.size()));
+            glGetProgramiv(ProgramID, GL_LINK_STATUS, &Success);
+        }
+        if (!Success)
+        {
+            Log::Draw<ELogLevel::Info>("Discarding stale program binary %s", Path.string().c_str());
+            std::error_code Error;
+            std::filesystem::remove(Path, Error);
+            return false;
+        }
+        return true;
+    }
+
+    static void Store(unsigned ProgramID, uint64_t Key)
+    {
+        if (GetDirectory().empty())
+        {
+            return;
+        }
+
+        GLint Length{};
+        glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &Length);
+        if (Length <= 0)
+        {
+            return;
+        }
+
+        SHeader Header{};
+        Header.Key = Key;
+        auto Binary = Memory::GetVector<char>();
+        Binary.resize(std::size_t(Length));
+        GLsizei Written{};
+        GLenum Format{};
+        glGetProgramBinary(ProgramID, Length, &Written, &Format, Binary.data());
+        if (Written <= 0)
+        {
+            return;
+        }
+        Header.BinaryFormat = Format;
+        Header.Length = uint32_t(Written);
+
+        /* Write next to the final file and rename, so other instances never read a partial binary. */
+        auto Path = GetPath(Key);
+        auto TempPath = Path;
+        TempPath += ".tmp";
+        std::FILE* File = std::fopen(TempPath.string().c_str(), "wb");
+        if (File == nullptr)
+        {
+            return;
+        }
+        bool bWritten = std::fwrite(&Header, sizeof(Header), 1, File) == 1 && std::fwrite(Binary.data(), Header.Length, 1, File) == 1;
+        bWritten = std::fclose(File) == 0 && bWritten;
+
+        std::error_code Error;
+        if (bWritten)
+        {
+            std::filesystem::rename(TempPath, Path, Error);
+        }
+        if (!bWritten || Error)
+        {
+            std::filesystem::remove(TempPath, Error);
+        }
+    }
+}
+
 void SProgram::CheckShader(unsigned int ShaderID)
 {
     int Success;
@@ -81,55 +274,59 @@ void SProgram::CheckProgram(unsigned int ProgramID)
     }
 }
 
-unsigned int SProgram::CreateVertexShader(const char* Data, int Length)
+unsigned int SProgram::CreateShader(unsigned int Type, const char* Data, int Length, int Permutation)
 {
-    unsigned VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-    char const* Blocks[4] = {
+    /* Goes right after #version, before anything that could test SHADER_MODE. */
+    char Defines[32]{};
+    if (Permutation >= 0)
+    {
+        std::snprintf(Defines, sizeof(Defines), "#define SHADER_MODE %d\n", Permutation);
+    }
+
+    unsigned ShaderID = glCreateShader(Type);
+    char const* Blocks[5] = {
         &Constants::GLSLVersion[0],
+        &Defines[0],
         &SharedConstants[0],
         Asset::Shader::SharedGLSL.SignedCharPtr(),
         Data
     };
-    int const Lengths[4] = {
+    int const Lengths[5] = {
         (int)strlen(Constants::GLSLVersion),
+        (int)strlen(Defines),
         (int)SharedConstants.length(),
         (int)Asset::Shader::SharedGLSL.Length,
         Length
     };
-    glShaderSource(VertexShaderID, 4, Blocks, &Lengths[0]);
-    glCompileShader(VertexShaderID);
-    CheckShader(VertexShaderID);
-    return VertexShaderID;
+    glShaderSource(ShaderID, 5, Blocks, &Lengths[0]);
+    glCompileShader(ShaderID);
+    CheckShader(ShaderID);
+    return ShaderID;
 }
 
-unsigned int SProgram::CreateFragmentShader(const char* Data, int Length)
+unsigned int SProgram::CreateVertexShader(const char* Data, int Length, int Permutation)
 {
-    unsigned FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-    char const* Blocks[4] = {
-        &Constants::GLSLVersion[0],
-        &SharedConstants[0],
-        Asset::Shader::SharedGLSL.SignedCharPtr(),
-        Data
-    };
-    int const Lengths[4] = {
-        (int)strlen(Constants::GLSLVersion),
-        (int)SharedConstants.length(),
-        (int)Asset::Shader::SharedGLSL.Length,
-        Length
-    };
-    glShaderSource(FragmentShaderID, 4, Blocks, &Lengths[0]);
-    glCompileShader(FragmentShaderID);
-    CheckShader(FragmentShaderID);
-    return FragmentShaderID;
+    return CreateShader(GL_VERTEX_SHADER, Data, Length, Permutation);
+}
+
+unsigned int SProgram::CreateFragmentShader(const char* Data, int Length, int Permutation)
+{
+    return CreateShader(GL_FRAGMENT_SHADER, Data, Length, Permutation);
 }
 
 unsigned int SProgram::CreateProgram(unsigned int VertexShader, unsigned int FragmentShader)
 {
     unsigned ProgramID = glCreateProgram();
+    LinkProgram(ProgramID, VertexShader, FragmentShader);
+    return ProgramID;
+}
+
+void SProgram::LinkProgram(unsigned int ProgramID, unsigned int VertexShader, unsigned int FragmentShader)
+{
+    glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glAttachShader(ProgramID, VertexShader);
     glAttachShader(ProgramID, FragmentShader);
     glLinkProgram(ProgramID);
-    return ProgramID;
 }
 
 void SProgram::InitUniforms()
@@ -142,26 +339,32 @@ void SProgram::InitUniforms()
     glUniformBlockBinding(ID, UniformGlobals, 0);
 }
 
-void SProgram::Init(const SAsset& InVertexShaderAsset, const SAsset& InFragmentShaderAsset)
+void SProgram::Init(const SAsset& InVertexShaderAsset, const SAsset& InFragmentShaderAsset, int InPermutation)
 {
 #ifdef EQUINOX_REACH_DEVELOPMENT
     VertexShaderAsset = &InVertexShaderAsset;
     FragmentShaderAsset = &InFragmentShaderAsset;
 #endif
-    unsigned VertexShader = CreateVertexShader(InVertexShaderAsset.SignedCharPtr(), (int)InVertexShaderAsset.Length);
-    unsigned FragmentShader = CreateFragmentShader(InFragmentShaderAsset.SignedCharPtr(), (int)InFragmentShaderAsset.Length);
-    ID = CreateProgram(VertexShader, FragmentShader);
-    glDeleteShader(VertexShader);
-    glDeleteShader(FragmentShader);
+    Permutation = InPermutation;
+    auto CacheKey = ProgramCache::MakeKey(InVertexShaderAsset.SignedCharPtr(), (int)InVertexShaderAsset.Length,
+        InFragmentShaderAsset.SignedCharPtr(), (int)InFragmentShaderAsset.Length, Permutation);
+    ID = glCreateProgram();
+    if (!ProgramCache::Load(ID, CacheKey))
+    {
+        unsigned VertexShader = CreateVertexShader(InVertexShaderAsset.SignedCharPtr(), (int)InVertexShaderAsset.Length, Permutation);
+        unsigned FragmentShader = CreateFragmentShader(InFragmentShaderAsset.SignedCharPtr(), (int)InFragmentShaderAsset.Length, Permutation);
+        LinkProgram(ID, VertexShader, FragmentShader);
+        glDeleteShader(VertexShader);
+        glDeleteShader(FragmentShader);
+        ProgramCache::Store(ID, CacheKey);
+    }
     SProgram::InitUniforms();
     InitUniforms();
-    InitUniformBlocks();
     CheckProgram(ID);
 }
 
 void SProgram::Cleanup() const
 {
-    CleanupUniformBlocks();
     glDeleteProgram(ID);
 
     Log::Draw<ELogLevel::Debug>("Deleting SProgram");
@@ -186,7 +389,7 @@ void SProgram::Reload()
     std::stringstream VertexShaderStringBuffer;
     VertexShaderStringBuffer << ShaderFile.rdbuf();
     auto VertexShaderString = VertexShaderStringBuffer.str();
-    VertexShader = CreateVertexShader(VertexShaderString.data(), (int)VertexShaderString.length());
+    VertexShader = CreateVertexShader(VertexShaderString.data(), (int)VertexShaderString.length(), Permutation);
 
     ShaderFile.close();
 
@@ -194,7 +397,7 @@ void SProgram::Reload()
     std::stringstream FragmentShaderStringBuffer;
     FragmentShaderStringBuffer << ShaderFile.rdbuf();
     auto FragmentShaderString = FragmentShaderStringBuffer.str();
-    FragmentShader = CreateFragmentShader(FragmentShaderString.data(), (int)FragmentShaderString.length());
+    FragmentShader = CreateFragmentShader(FragmentShaderString.data(), (int)FragmentShaderString.length(), Permutation);
 
     ShaderFile.close();
 
@@ -221,12 +424,22 @@ void SProgramPostProcess::InitUniforms()
 
 void SProgram3D::InitUniforms()
 {
-    UniformModelID = glGetUniformLocation(ID, "u_model");
+    UniformInstancesID = glGetUniformLocation(ID, "u_instances");
+    UniformLevelInstancesID = glGetUniformLocation(ID, "u_levelInstances");
+    UniformInstanceOffsetID = glGetUniformLocation(ID, "u_instanceOffset");
+    UniformLevelTilesID = glGetUniformLocation(ID, "u_levelTiles");
+    UniformLevelSizeID = glGetUniformLocation(ID, "u_levelSize");
+    UniformLevelPullKindID = glGetUniformLocation(ID, "u_levelPullKind");
+    UniformModeControlAID = glGetUniformLocation(ID, "u_modeControlA");
+    UniformModeControlBID = glGetUniformLocation(ID, "u_modeControlB");
     UniformCommonAtlasID = glGetUniformLocation(ID, "u_commonAtlas");
     UniformPrimaryAtlasID = glGetUniformLocation(ID, "u_primaryAtlas");
 
     glProgramUniform1i(ID, UniformCommonAtlasID, ETextureUnits::AtlasCommon);
     glProgramUniform1i(ID, UniformPrimaryAtlasID, ETextureUnits::AtlasPrimary3D);
+    glProgramUniform1i(ID, UniformInstancesID, ETextureUnits::Instances);
+    glProgramUniform1i(ID, UniformLevelInstancesID, ETextureUnits::LevelInstances);
+    glProgramUniform1i(ID, UniformLevelTilesID, ETextureUnits::LevelTiles);
 
     glUniformBlockBinding(ID, glGetUniformBlockIndex(ID, "ub_common"), EUniformBlockBinding::Uber3DCommon);
 }
@@ -268,30 +481,30 @@ void SProgramMap::InitUniforms()
     glUniformBlockBinding(ID, glGetUniformBlockIndex(ID, "ub_world"), EUniformBlockBinding::MapWorld);
 }
 
-void SProgramMap::InitUniformBlocks()
+void SMapUniformBlocks::Init()
 {
-    UniformBlockCommon.Init(sizeof(SShaderMapCommon));
-    UniformBlockCommon.Bind(EUniformBlockBinding::MapCommon);
+    Common.Init(sizeof(SShaderMapCommon));
+    Common.Bind(EUniformBlockBinding::MapCommon);
 
-    UniformBlockEditor.Init(sizeof(SShaderMapEditor));
-    UniformBlockEditor.Bind(EUniformBlockBinding::MapEditor);
+    Editor.Init(sizeof(SShaderMapEditor));
+    Editor.Bind(EUniformBlockBinding::MapEditor);
 
-    UniformBlockMap.Init(sizeof(SShaderMapData));
-    UniformBlockMap.Bind(EUniformBlockBinding::Map);
+    Map.Init(sizeof(SShaderMapData));
+    Map.Bind(EUniformBlockBinding::Map);
 
-    UniformBlockWorld.Init(sizeof(SShaderWorld));
-    UniformBlockWorld.Bind(EUniformBlockBinding::MapWorld);
+    World.Init(sizeof(SShaderWorld));
+    World.Bind(EUniformBlockBinding::MapWorld);
 }
 
-void SProgramMap::CleanupUniformBlocks() const
+void SMapUniformBlocks::Cleanup() const
 {
-    UniformBlockCommon.Cleanup();
-    UniformBlockEditor.Cleanup();
-    UniformBlockMap.Cleanup();
-    UniformBlockWorld.Cleanup();
+    Common.Cleanup();
+    Editor.Cleanup();
+    Map.Cleanup();
+    World.Cleanup();
 }
 
-void SProgramMap::SetEditorData(const SVec2& SelectedTile, const SVec4& SelectedBlock, uint32_t bEnabled, uint32_t bToggleMode, uint32_t bBlockMode) const
+void SMapUniformBlocks::SetEditorData(const SVec2& SelectedTile, const SVec4& SelectedBlock, uint32_t bEnabled, uint32_t bToggleMode, uint32_t bBlockMode) const
 {
     SShaderMapEditor ShaderMapEditor;
     ShaderMapEditor.bBlockMode = bBlockMode;
@@ -300,50 +513,116 @@ void SProgramMap::SetEditorData(const SVec2& SelectedTile, const SVec4& Selected
     ShaderMapEditor.SelectedBlock = SelectedBlock;
     ShaderMapEditor.bEnabled = bEnabled;
 
-    glBindBuffer(GL_UNIFORM_BUFFER, UniformBlockEditor.UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, Editor.UBO);
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SShaderMapEditor), &ShaderMapEditor);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-void SProgramMap::SetCursor(const SVec2& Cursor) const
+void SMapUniformBlocks::SetCursor(const SVec2& Cursor) const
+{
+    Common.SetVector2(offsetof(SShaderMapCommon, Cursor), Cursor);
+}
+
+static GLsizeiptr GetVertexSize(EVertexLayout VertexLayout)
+{
+    return VertexLayout == EVertexLayout::Packed ? (GLsizeiptr)sizeof(SPackedVertex) : (GLsizeiptr)sizeof(SCookedVertex);
+}
+
+/* Expects the VBO to be bound. */
+static void SetupVertexAttributes(EVertexLayout VertexLayout)
+{
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    if (VertexLayout == EVertexLayout::Packed)
+    {
+        auto constexpr Stride = (GLsizei)sizeof(SPackedVertex);
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, Stride, reinterpret_cast<void*>(offsetof(SPackedVertex, Position)));
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, Stride, reinterpret_cast<void*>(offsetof(SPackedVertex, TexCoord)));
+        glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, Stride, reinterpret_cast<void*>(offsetof(SPackedVertex, Normal)));
+        return;
+    }
+
+    auto constexpr Stride = (GLsizei)sizeof(SCookedVertex);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, reinterpret_cast<void*>(offsetof(SCookedVertex, Position)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Stride, reinterpret_cast<void*>(offsetof(SCookedVertex, TexCoord)));
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Stride, reinterpret_cast<void*>(offsetof(SCookedVertex, Normal)));
+}
+
+/* Normalized texture coordinates can't go outside [0, 1], half float positions are only good up to a few units. */
+static bool CanPackVertices(const SCookedMesh& Mesh)
 {
-    UniformBlockCommon.SetVector2(offsetof(SShaderMapCommon, Cursor), Cursor);
+    for (int Index = 0; Index < Mesh.VertexCount; ++Index)
+    {
+        const auto& Vertex = Mesh.Vertices[Index];
+        if (Vertex.TexCoord.X < 0.0f || Vertex.TexCoord.X > 1.0f || Vertex.TexCoord.Y < 0.0f || Vertex.TexCoord.Y > 1.0f)
+        {
+            return false;
+        }
+        if (std::abs(Vertex.Position.X) > 64.0f || std::abs(Vertex.Position.Y) > 64.0f || std::abs(Vertex.Position.Z) > 64.0f)
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
-void SGeometry::InitFromRawMesh(const CRawMesh& RawMesh)
+static uint32_t PackNormalComponent(float Value)
 {
+    return static_cast<uint32_t>(static_cast<int32_t>(std::round(std::clamp(Value, -1.0f, 1.0f) * 511.0f))) & 0x3FF;
+}
+
+/* Uploads Mesh at BaseVertex into the bound VBO. */
+static void UploadVertices(EVertexLayout VertexLayout, int BaseVertex, const SCookedMesh& Mesh)
+{
+    auto VertexSize = GetVertexSize(VertexLayout);
+    if (VertexLayout == EVertexLayout::Float)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, BaseVertex * VertexSize, Mesh.VertexCount * VertexSize, Mesh.Vertices);
+        return;
+    }
+
+    auto Vertices = Memory::GetVector<SPackedVertex>();
+    Vertices.resize(Mesh.VertexCount);
+    for (int Index = 0; Index < Mesh.VertexCount; ++Index)
+    {
+        const auto& Source = Mesh.Vertices[Index];
+        auto& Vertex = Vertices[Index];
+        Vertex.Position[0] = Math::FloatToHalf(Source.Position.X);
+        Vertex.Position[1] = Math::FloatToHalf(Source.Position.Y);
+        Vertex.Position[2] = Math::FloatToHalf(Source.Position.Z);
+        Vertex.TexCoord[0] = static_cast<uint16_t>(std::round(Source.TexCoord.X * 65535.0f));
+        Vertex.TexCoord[1] = static_cast<uint16_t>(std::round(Source.TexCoord.Y * 65535.0f));
+        Vertex.Normal = PackNormalComponent(Source.Normal.X) | (PackNormalComponent(Source.Normal.Y) << 10) |
+            (PackNormalComponent(Source.Normal.Z) << 20);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, BaseVertex * VertexSize, Mesh.VertexCount * VertexSize, Vertices.data());
+}
+
+void SGeometry::InitFromCookedMesh(const SAsset& Resource, EVertexLayout InVertexLayout)
+{
+    SCookedMesh Mesh{ Resource };
+    if (!Mesh.IsValid())
+    {
+        return;
+    }
+
+    VertexLayout = InVertexLayout == EVertexLayout::Packed && CanPackVertices(Mesh) ? EVertexLayout::Packed : EVertexLayout::Float;
+
     glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
 
-    glEnableVertexAttribArray(0);
     glGenBuffers(1, &VBO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER,
-        (GLsizeiptr)RawMesh.Positions.size() * SIZE_OF_VECTOR_ELEMENT(RawMesh.Positions),
-        &RawMesh.Positions[0],
-        GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glEnableVertexAttribArray(1);
-    glGenBuffers(1, &CBO);
-    glBindBuffer(GL_ARRAY_BUFFER, CBO);
-    glBufferData(GL_ARRAY_BUFFER,
-        (GLsizeiptr)RawMesh.TexCoords.size() * SIZE_OF_VECTOR_ELEMENT(RawMesh.TexCoords),
-        &RawMesh.TexCoords[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(
-        1,
-        2,
-        GL_FLOAT,
-        GL_FALSE,
-        0,
-        nullptr);
+    glBufferData(GL_ARRAY_BUFFER, Mesh.VertexCount * GetVertexSize(VertexLayout), nullptr, GL_STATIC_DRAW);
+    UploadVertices(VertexLayout, 0, Mesh);
+    SetupVertexAttributes(VertexLayout);
 
-    ElementCount = (int)RawMesh.Indices.size();
+    ElementCount = Mesh.IndexCount;
     glGenBuffers(1, &EBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-        ElementCount * SIZE_OF_VECTOR_ELEMENT(RawMesh.Indices), &RawMesh.Indices[0],
-        GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, ElementCount * (GLsizeiptr)sizeof(uint16_t), Mesh.Indices, GL_STATIC_DRAW);
 
     glBindVertexArray(0);
 }
@@ -421,75 +700,312 @@ void STileset::InitBasic(
     const SAsset& Wall,
     const SAsset& WallJoint,
     const SAsset& DoorFrame,
-    const SAsset& Door)
-{
-    auto Positions = Memory::GetVector<SVec3>();
-    auto TexCoords = Memory::GetVector<SVec2>();
-    auto Indices = Memory::GetVector<unsigned short>();
+    const SAsset& Door,
+    EVertexLayout InVertexLayout)
+{
+    std::array<std::pair<SCookedMesh, int>, 6> Meshes{ {
+        { SCookedMesh{ Floor }, ETileGeometryType::Floor },
+        { SCookedMesh{ Hole }, ETileGeometryType::Hole },
+        { SCookedMesh{ Wall }, ETileGeometryType::Wall },
+        { SCookedMesh{ WallJoint }, ETileGeometryType::WallJoint },
+        { SCookedMesh{ DoorFrame }, ETileGeometryType::DoorFrame },
+        { SCookedMesh{ Door }, ETileGeometryType::Door },
+    } };
+
+    MeshAssets[ETileGeometryType::Floor] = &Floor;
+    MeshAssets[ETileGeometryType::Hole] = &Hole;
+    MeshAssets[ETileGeometryType::Wall] = &Wall;
+    MeshAssets[ETileGeometryType::WallJoint] = &WallJoint;
+    MeshAssets[ETileGeometryType::DoorFrame] = &DoorFrame;
+    MeshAssets[ETileGeometryType::Door] = &Door;
+
+    /* All tiles share one vertex and one index buffer, cooked indices are kept as is and offset with BaseVertex. */
+    int VertexCount = 0;
+    ElementCount = 0;
+    VertexLayout = InVertexLayout;
+    for (auto& [Mesh, Type] : Meshes)
+    {
+        if (VertexLayout == EVertexLayout::Packed && Mesh.IsValid() && !CanPackVertices(Mesh))
+        {
+            Log::Draw<ELogLevel::Info>("Tileset mesh %d can't be packed, using float vertices", Type);
+            VertexLayout = EVertexLayout::Float;
+        }
+
+        auto& Geometry = TileGeometry[Type];
+        Geometry.ElementOffset = ElementCount * (int)sizeof(uint16_t);
+        Geometry.ElementCount = Mesh.IndexCount;
+        Geometry.BaseVertex = VertexCount;
 
-    int LastElementOffset = 0;
-    int LastVertexOffset = 0;
+        VertexCount += Mesh.VertexCount;
+        ElementCount += Mesh.IndexCount;
+    }
 
-    auto InitGeometry = [&](const SAsset& Resource, int Type) {
-        auto Mesh = CRawMesh(Resource);
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
 
-        auto& Geometry = TileGeometry[Type];
-        Geometry.ElementOffset = LastElementOffset;
-        Geometry.ElementCount = Mesh.GetElementCount();
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, VertexCount * GetVertexSize(VertexLayout), nullptr, GL_STATIC_DRAW);
+    SetupVertexAttributes(VertexLayout);
+
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, ElementCount * (GLsizeiptr)sizeof(uint16_t), nullptr, GL_STATIC_DRAW);
 
-        for (int Index = 0; Index < Geometry.ElementCount; ++Index)
+    for (auto& [Mesh, Type] : Meshes)
+    {
+        if (!Mesh.IsValid())
         {
-            Indices.push_back(Mesh.Indices[Index] + LastVertexOffset);
+            continue;
         }
+        auto& Geometry = TileGeometry[Type];
+        UploadVertices(VertexLayout, Geometry.BaseVertex, Mesh);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, Geometry.ElementOffset,
+            Mesh.IndexCount * (GLsizeiptr)sizeof(uint16_t), Mesh.Indices);
+    }
+
+    glBindVertexArray(0);
+}
+
+static bool IsSameVertex(const SCookedVertex& A, const SCookedVertex& B)
+{
+    return A.Position.X == B.Position.X && A.Position.Y == B.Position.Y && A.Position.Z == B.Position.Z &&
+        A.TexCoord.X == B.TexCoord.X && A.TexCoord.Y == B.TexCoord.Y &&
+        A.Normal.X == B.Normal.X && A.Normal.Y == B.Normal.Y && A.Normal.Z == B.Normal.Z;
+}
+
+/* Appends Mesh turned to face Direction and moved onto TileCoords, like the level instances Draw3DLevel makes.
+ * New vertices equal to one already appended from WeldFrom on are reused instead. */
+static void AppendLevelMesh(std::pmr::vector<SCookedVertex>& Vertices, std::pmr::vector<uint32_t>& Indices,
+    const SCookedMesh& Mesh, const SVec2Int& TileCoords, SDirection Direction, std::size_t WeldFrom)
+{
+    /* Quarter turns around Y, same as SMat4x4::Rotate() with RotationFromDirection(). */
+    auto Forward = Direction.GetVector<float>();
+    auto Cos = -Forward.Y;
+    auto Sin = -Forward.X;
 
-        for (int Index = 0; Index < Mesh.GetVertexCount(); ++Index)
+    auto Remap = Memory::GetVector<uint32_t>();
+    Remap.resize(Mesh.VertexCount);
+    for (int Index = 0; Index < Mesh.VertexCount; ++Index)
+    {
+        auto Vertex = Mesh.Vertices[Index];
+        auto Position = Vertex.Position;
+        auto Normal = Vertex.Normal;
+        Vertex.Position = { (Cos * Position.X) + (Sin * Position.Z) + (float)TileCoords.X, Position.Y,
+            (Cos * Position.Z) - (Sin * Position.X) + (float)TileCoords.Y };
+        Vertex.Normal = { (Cos * Normal.X) + (Sin * Normal.Z), Normal.Y, (Cos * Normal.Z) - (Sin * Normal.X) };
+
+        auto Weld = std::find_if(Vertices.begin() + (std::ptrdiff_t)WeldFrom, Vertices.end(),
+            [&](const SCookedVertex& Other) { return IsSameVertex(Vertex, Other); });
+        Remap[Index] = (uint32_t)(Weld - Vertices.begin());
+        if (Weld == Vertices.end())
         {
-            Positions.push_back(Mesh.Positions[Index]);
-            TexCoords.push_back(Mesh.TexCoords[Index]);
+            Vertices.push_back(Vertex);
         }
+    }
 
-        LastVertexOffset += Mesh.GetVertexCount();
-        LastElementOffset += (int)((Geometry.ElementCount) * sizeof(unsigned short));
-    };
+    for (int Index = 0; Index < Mesh.IndexCount; ++Index)
+    {
+        Indices.push_back(Remap[Mesh.Indices[Index]]);
+    }
+}
 
-    InitGeometry(Floor, ETileGeometryType::Floor);
-    InitGeometry(Hole, ETileGeometryType::Hole);
-    InitGeometry(Wall, ETileGeometryType::Wall);
-    InitGeometry(WallJoint, ETileGeometryType::WallJoint);
-    InitGeometry(DoorFrame, ETileGeometryType::DoorFrame);
-    InitGeometry(Door, ETileGeometryType::Door);
+void SLevelMesh::Bake(const SWorldLevel& InLevel, const STileset& Tileset)
+{
+    auto GetMesh = [&](int Type) { return SCookedMesh{ *Tileset.MeshAssets[Type] }; };
+    auto const FloorMesh = GetMesh(ETileGeometryType::Floor);
+    auto const HoleMesh = GetMesh(ETileGeometryType::Hole);
+    auto const WallMesh = GetMesh(ETileGeometryType::Wall);
+    auto const WallJointMesh = GetMesh(ETileGeometryType::WallJoint);
+    auto const DoorFrameMesh = GetMesh(ETileGeometryType::DoorFrame);
 
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    auto Vertices = Memory::GetVector<SCookedVertex>();
+    auto Indices = Memory::GetVector<uint32_t>();
+    std::array<int, LEVEL_MAX_CHUNK_COUNT> ChunkStarts{};
 
-    glEnableVertexAttribArray(0);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)Positions.size() * (GLsizeiptr)sizeof(SVec3), &Positions[0],
-        GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    Level = &InLevel;
+    ChunkCountX = (InLevel.Width + LEVEL_CHUNK_SIZE - 1) / LEVEL_CHUNK_SIZE;
+    ChunkCountY = (InLevel.Height + LEVEL_CHUNK_SIZE - 1) / LEVEL_CHUNK_SIZE;
+    VisibleRangeCount = 0;
 
-    glEnableVertexAttribArray(1);
-    glGenBuffers(1, &CBO);
-    glBindBuffer(GL_ARRAY_BUFFER, CBO);
-    glBufferData(GL_ARRAY_BUFFER,
-        static_cast<GLsizeiptr>(TexCoords.size() * SIZE_OF_VECTOR_ELEMENT(TexCoords)),
-        &TexCoords[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(
-        1,
-        2,
-        GL_FLOAT,
-        GL_FALSE,
-        0,
-        nullptr);
+    for (int ChunkY = 0; ChunkY < ChunkCountY; ++ChunkY)
+    {
+        for (int ChunkX = 0; ChunkX < ChunkCountX; ++ChunkX)
+        {
+            ChunkStarts[(ChunkY * ChunkCountX) + ChunkX] = (int)Indices.size();
+
+            auto MinCoords = SVec2Int{ ChunkX * LEVEL_CHUNK_SIZE, ChunkY * LEVEL_CHUNK_SIZE };
+            auto MaxCoords = SVec2Int{ std::min(MinCoords.X + LEVEL_CHUNK_SIZE, (int)InLevel.Width),
+                std::min(MinCoords.Y + LEVEL_CHUNK_SIZE, (int)InLevel.Height) };
+
+            for (int Y = MinCoords.Y; Y < MaxCoords.Y; ++Y)
+            {
+                for (int X = MinCoords.X; X < MaxCoords.X; ++X)
+                {
+                    auto Tile = InLevel.GetTileAt({ X, Y });
+                    if (Tile->CheckFlag(TILE_FLOOR_BIT) && FloorMesh.IsValid())
+                    {
+                        AppendLevelMesh(Vertices, Indices, FloorMesh, { X, Y }, SDirection::North(), Vertices.size());
+                    }
+                    else if (Tile->CheckFlag(TILE_HOLE_BIT) && HoleMesh.IsValid())
+                    {
+                        AppendLevelMesh(Vertices, Indices, HoleMesh, { X, Y }, SDirection::North(), Vertices.size());
+                    }
+                }
+            }
+
+            /* Joints sit on tile corners, the last chunk of a row or column also takes the ones on the far edge. */
+            if (InLevel.bUseWallJoints && WallJointMesh.IsValid())
+            {
+                auto JointMaxX = ChunkX == ChunkCountX - 1 ? MaxCoords.X + 1 : MaxCoords.X;
+                auto JointMaxY = ChunkY == ChunkCountY - 1 ? MaxCoords.Y + 1 : MaxCoords.Y;
+                for (int Y = MinCoords.Y; Y < JointMaxY; ++Y)
+                {
+                    for (int X = MinCoords.X; X < JointMaxX; ++X)
+                    {
+                        if (InLevel.IsValidWallJoint({ X, Y }) && InLevel.IsWallJointAt({ X, Y }))
+                        {
+                            AppendLevelMesh(Vertices, Indices, WallJointMesh, { X, Y }, SDirection::North(), Vertices.size());
+                        }
+                    }
+                }
+            }
+
+            /* Walls go run by run: same direction, same line of tiles, one after another. Coplanar neighbours share
+             * their index range and weld the vertices they have in common along the seam. */
+            for (auto& Direction : SDirection::All())
+            {
+                bool bAlongX = Direction.GetVector<int>().X == 0;
+                auto LineMin = bAlongX ? MinCoords.Y : MinCoords.X;
+                auto LineMax = bAlongX ? MaxCoords.Y : MaxCoords.X;
+                auto RunMin = bAlongX ? MinCoords.X : MinCoords.Y;
+                auto RunMax = bAlongX ? MaxCoords.X : MaxCoords.Y;
+                for (int Line = LineMin; Line < LineMax && WallMesh.IsValid(); ++Line)
+                {
+                    auto PreviousWallStart = Vertices.size();
+                    for (int Run = RunMin; Run < RunMax; ++Run)
+                    {
+                        auto TileCoords = bAlongX ? SVec2Int{ Run, Line } : SVec2Int{ Line, Run };
+                        if (!InLevel.GetTileAt(TileCoords)->CheckEdgeFlag(TILE_EDGE_WALL_BIT, Direction))
+                        {
+                            PreviousWallStart = Vertices.size();
+                            continue;
+                        }
+                        auto WallStart = Vertices.size();
+                        AppendLevelMesh(Vertices, Indices, WallMesh, TileCoords, Direction, PreviousWallStart);
+                        PreviousWallStart = WallStart;
+                    }
+                }
+            }
+
+            for (int Y = MinCoords.Y; Y < MaxCoords.Y && DoorFrameMesh.IsValid(); ++Y)
+            {
+                for (int X = MinCoords.X; X < MaxCoords.X; ++X)
+                {
+                    auto Tile = InLevel.GetTileAt({ X, Y });
+                    for (auto& Direction : SDirection::All())
+                    {
+                        if (Tile->CheckEdgeFlag(TILE_EDGE_DOOR_BIT, Direction))
+                        {
+                            AppendLevelMesh(Vertices, Indices, DoorFrameMesh, { X, Y }, Direction, Vertices.size());
+                        }
+                    }
+                }
+            }
+        }
+    }
 
     ElementCount = (int)Indices.size();
-    glGenBuffers(1, &EBO);
+    IndexSize = Vertices.size() > UINT16_MAX ? (int)sizeof(uint32_t) : (int)sizeof(uint16_t);
+    for (int ChunkIndex = 0; ChunkIndex < ChunkCountX * ChunkCountY; ++ChunkIndex)
+    {
+        auto ChunkEnd = ChunkIndex + 1 < ChunkCountX * ChunkCountY ? ChunkStarts[ChunkIndex + 1] : ElementCount;
+        Chunks[ChunkIndex].ElementOffset = ChunkStarts[ChunkIndex] * IndexSize;
+        Chunks[ChunkIndex].ElementCount = ChunkEnd - ChunkStarts[ChunkIndex];
+    }
+
+    /* World space positions go well past what half floats can hold. */
+    VertexLayout = EVertexLayout::Float;
+    if (VAO == 0)
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+    }
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(Vertices.size() * sizeof(SCookedVertex)), Vertices.data(), GL_STATIC_DRAW);
+    SetupVertexAttributes(VertexLayout);
+
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, ElementCount * (GLsizeiptr)sizeof(unsigned short), &Indices[0],
-        GL_STATIC_DRAW);
+    if (IndexSize == (int)sizeof(uint32_t))
+    {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(Indices.size() * sizeof(uint32_t)), Indices.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        auto ShortIndices = Memory::GetVector<uint16_t>();
+        ShortIndices.assign(Indices.begin(), Indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(ShortIndices.size() * sizeof(uint16_t)), ShortIndices.data(), GL_STATIC_DRAW);
+    }
 
     glBindVertexArray(0);
+
+    Log::Draw<ELogLevel::Info>("Baked level mesh: %zu vertices, %d indices, %d chunks",
+        Vertices.size(), ElementCount, ChunkCountX * ChunkCountY);
+}
+
+void SLevelMesh::SelectVisibleChunks(const SVec2Int& MinCoords, const SVec2Int& MaxCoords, const SVec2Int* SortOrigin)
+{
+    VisibleRangeCount = 0;
+
+    std::array<int, LEVEL_MAX_CHUNK_COUNT> ChunkIndices;
+    int ChunkIndexCount = 0;
+
+    auto MinChunkX = std::max(MinCoords.X / LEVEL_CHUNK_SIZE, 0);
+    auto MinChunkY = std::max(MinCoords.Y / LEVEL_CHUNK_SIZE, 0);
+    auto MaxChunkX = std::min(MaxCoords.X / LEVEL_CHUNK_SIZE, ChunkCountX - 1);
+    auto MaxChunkY = std::min(MaxCoords.Y / LEVEL_CHUNK_SIZE, ChunkCountY - 1);
+    for (int ChunkY = MinChunkY; ChunkY <= MaxChunkY; ++ChunkY)
+    {
+        for (int ChunkX = MinChunkX; ChunkX <= MaxChunkX; ++ChunkX)
+        {
+            auto ChunkIndex = (ChunkY * ChunkCountX) + ChunkX;
+            if (Chunks[ChunkIndex].ElementCount > 0)
+            {
+                ChunkIndices[ChunkIndexCount++] = ChunkIndex;
+            }
+        }
+    }
+
+    if (SortOrigin != nullptr)
+    {
+        /* By the distance to the chunk center, in half tiles so it stays integer. */
+        auto DistanceSquared = [&](int ChunkIndex) {
+            auto const X = (((ChunkIndex % ChunkCountX) * LEVEL_CHUNK_SIZE * 2) + LEVEL_CHUNK_SIZE - 1) - (SortOrigin->X * 2);
+            auto const Y = (((ChunkIndex / ChunkCountX) * LEVEL_CHUNK_SIZE * 2) + LEVEL_CHUNK_SIZE - 1) - (SortOrigin->Y * 2);
+            return (X * X) + (Y * Y);
+        };
+        std::sort(ChunkIndices.begin(), ChunkIndices.begin() + ChunkIndexCount, [&](int A, int B) {
+            return DistanceSquared(A) < DistanceSquared(B);
+        });
+    }
+
+    for (int Index = 0; Index < ChunkIndexCount; ++Index)
+    {
+        const auto& Chunk = Chunks[ChunkIndices[Index]];
+        if (VisibleRangeCount > 0)
+        {
+            auto& Previous = VisibleRanges[VisibleRangeCount - 1];
+            if (Previous.ElementOffset + (Previous.ElementCount * IndexSize) == Chunk.ElementOffset)
+            {
+                Previous.ElementCount += Chunk.ElementCount;
+                continue;
+            }
+        }
+        VisibleRanges[VisibleRangeCount++] = Chunk;
+    }
 }
 
 void SCamera::RegenerateProjection()
@@ -670,6 +1186,140 @@ void SUniformBlock::SetFloat(int Position, const float Value) const
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
+void SInstanceBuffer::Init(int InTextureUnitID, unsigned TextureFormat, int InElementSize, int ElementTexels, int InCapacity)
+{
+    TextureUnitID = InTextureUnitID;
+    ElementSize = InElementSize;
+
+    GLint MaxTexels{};
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &MaxTexels);
+    MaxCapacity = MaxTexels / ElementTexels / FrameCount;
+
+    glGenBuffers(1, &BO);
+    Resize(InCapacity);
+
+    glActiveTexture(GL_TEXTURE0 + TextureUnitID);
+    glGenTextures(1, &TextureID);
+    glBindTexture(GL_TEXTURE_BUFFER, TextureID);
+    glTexBuffer(GL_TEXTURE_BUFFER, TextureFormat, BO);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void SInstanceBuffer::Cleanup()
+{
+    DeleteFences();
+    glDeleteTextures(1, &TextureID);
+    glDeleteBuffers(1, &BO);
+}
+
+void SLevelTileBuffer::Init(int TextureUnitID)
+{
+    glGenBuffers(1, &BO);
+    glBindBuffer(GL_TEXTURE_BUFFER, BO);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(STile) * MAX_LEVEL_TILE_COUNT, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0 + TextureUnitID);
+    glGenTextures(1, &TextureID);
+    glBindTexture(GL_TEXTURE_BUFFER, TextureID);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, BO);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void SLevelTileBuffer::Cleanup()
+{
+    glDeleteTextures(1, &TextureID);
+    glDeleteBuffers(1, &BO);
+}
+
+void SLevelTileBuffer::Upload(const SWorldLevel* InLevel)
+{
+    Level = InLevel;
+    Size = { (int)Level->Width, (int)Level->Height };
+
+    glBindBuffer(GL_TEXTURE_BUFFER, BO);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, (GLsizeiptr)sizeof(STile) * Level->TileCount(), Level->Tiles.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void SInstanceBuffer::DeleteFences()
+{
+    for (auto& Fence : Fences)
+    {
+        if (Fence != nullptr)
+        {
+            glDeleteSync(static_cast<GLsync>(Fence));
+            Fence = nullptr;
+        }
+    }
+}
+
+void SInstanceBuffer::Resize(int InCapacity)
+{
+    if (InCapacity > MaxCapacity)
+    {
+        Log::Draw<ELogLevel::Critical>("%d instances don't fit into a texture buffer, drawing %d", InCapacity, MaxCapacity);
+        InCapacity = MaxCapacity;
+    }
+    Capacity = InCapacity;
+
+    /* Respecifying the storage orphans the old one, so pending draws don't need to be waited for. */
+    DeleteFences();
+    glBindBuffer(GL_TEXTURE_BUFFER, BO);
+    glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)Capacity * FrameCount * ElementSize, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void* SInstanceBuffer::Map(int Count)
+{
+    if (Count > Capacity && Capacity < MaxCapacity)
+    {
+        Resize((int)Utility::NextPowerOfTwo((unsigned)Count));
+    }
+
+    Frame = (Frame + 1) % FrameCount;
+    if (Fences[Frame] != nullptr)
+    {
+        auto Fence = static_cast<GLsync>(Fences[Frame]);
+        if (glClientWaitSync(Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+        {
+            Log::Draw<ELogLevel::Critical>("Timed out waiting for instance buffer region %d", Frame);
+        }
+        glDeleteSync(Fence);
+        Fences[Frame] = nullptr;
+    }
+
+    /* The fence already guarantees the GPU is done with this region. */
+    glBindBuffer(GL_TEXTURE_BUFFER, BO);
+    return glMapBufferRange(GL_TEXTURE_BUFFER,
+        (GLintptr)GetRegionOffset() * ElementSize,
+        (GLsizeiptr)std::min(Count, Capacity) * ElementSize,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+bool SInstanceBuffer::Unmap() const
+{
+    /* Other buffers may have been mapped on the same target since Map(). */
+    glBindBuffer(GL_TEXTURE_BUFFER, BO);
+    bool bUnmapped = glUnmapBuffer(GL_TEXTURE_BUFFER) == GL_TRUE;
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    if (!bUnmapped)
+    {
+        Log::Draw<ELogLevel::Critical>("Instance buffer region %d was lost while mapped", Frame);
+    }
+    return bUnmapped;
+}
+
+void SInstanceBuffer::Fence()
+{
+    if (Fences[Frame] != nullptr)
+    {
+        glDeleteSync(static_cast<GLsync>(Fences[Frame]));
+    }
+    Fences[Frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
 void SRenderer::Init(int Width, int Height)
 {
     /* Common OpenGL settings. */
@@ -738,6 +1388,13 @@ void SRenderer::Init(int Width, int Height)
     Queue3D.CommonUniformBlock.Init(sizeof(SMat4x4) * 2);
     Queue3D.CommonUniformBlock.Bind(EUniformBlockBinding::Uber3DCommon);
 
+    MapUniformBlocks.Init();
+
+    /* Transforms are four RGBA32F columns. */
+    InstanceBuffer.Init(ETextureUnits::Instances, GL_RGBA32F, sizeof(SMat4x4), 4, 64);
+    LevelInstanceBuffer.Init(ETextureUnits::LevelInstances, GL_RGBA16I, sizeof(SLevelInstance), 1, 256);
+    LevelTiles.Init(ETextureUnits::LevelTiles);
+
     /* Initialize framebuffers. */
     WorldLayersFramebuffer.Init(ETextureUnits::WorldTextures,
         int(MapWorldLayerTextureSize.X),
@@ -760,6 +1417,7 @@ void SRenderer::Init(int Width, int Height)
 
 void SRenderer::Cleanup()
 {
+    LevelDrawSetCache.WaitForPrefetch();
     MainFramebuffer.Cleanup();
     WorldLayersFramebuffer.Cleanup();
     for (auto& Atlas : Atlases)
@@ -770,6 +1428,11 @@ void SRenderer::Cleanup()
     GlobalsUniformBlock.Cleanup();
     Queue2D.CommonUniformBlock.Cleanup();
     Queue3D.CommonUniformBlock.Cleanup();
+    MapUniformBlocks.Cleanup();
+    InstanceBuffer.Cleanup();
+    LevelInstanceBuffer.Cleanup();
+    LevelTiles.Cleanup();
+    LevelMesh.Cleanup();
     ProgramHUD.Cleanup();
     ProgramMap.Cleanup();
     ProgramUber2D.Cleanup();
@@ -788,19 +1451,98 @@ void SRenderer::SetMapIcons(const std::array<SSpriteHandle, MAP_ICON_COUNT>& Spr
         Sprites[Index].SizeY = SpriteHandles[Index].Sprite->SizePixels.Y;
     }
 
-    glBindBuffer(GL_UNIFORM_BUFFER, ProgramMap.UniformBlockCommon.UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, MapUniformBlocks.Common.UBO);
     glBufferSubData(GL_UNIFORM_BUFFER, offsetof(SShaderMapCommon, Icons), sizeof(SShaderSprite) * MAP_ICON_COUNT, Sprites.data());
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
+void SLevelDrawSet::CopyFrom(const SLevelDrawSet& Other)
+{
+    for (int TileTypeIndex = 0; TileTypeIndex < ETileGeometryType::Count; TileTypeIndex++)
+    {
+        auto& DrawCall = DrawData.DrawCalls[TileTypeIndex];
+        const auto& OtherDrawCall = Other.DrawData.DrawCalls[TileTypeIndex];
+        DrawCall.Instances.assign(OtherDrawCall.Instances.begin(), OtherDrawCall.Instances.begin() + OtherDrawCall.Count);
+        DrawCall.Count = OtherDrawCall.Count;
+        DrawCall.DynamicCount = 0;
+    }
+    std::copy(Other.VisibleTiles.begin(), Other.VisibleTiles.begin() + Other.VisibleTileCount, VisibleTiles.begin());
+    VisibleTileCount = Other.VisibleTileCount;
+    MinCoords = Other.MinCoords;
+    MaxCoords = Other.MaxCoords;
+}
+
+SLevelDrawSetCache::SSlot* SLevelDrawSetCache::Find(const SWorldLevel* Level, const SVec2Int& Coords, SDirection Direction)
+{
+    for (auto& Slot : Slots)
+    {
+        if (Slot.Level == Level && Slot.Coords == Coords && Slot.Direction == Direction)
+        {
+            return &Slot;
+        }
+    }
+    return nullptr;
+}
+
+SLevelDrawSetCache::SSlot& SLevelDrawSetCache::Claim(const SWorldLevel* Level, const SVec2Int& Coords, SDirection Direction)
+{
+    auto* Oldest = &Slots[0];
+    for (auto& Slot : Slots)
+    {
+        if (Slot.LastUsed < Oldest->LastUsed)
+        {
+            Oldest = &Slot;
+        }
+    }
+
+    Oldest->Level = Level;
+    Oldest->Coords = Coords;
+    Oldest->Direction = Direction;
+    Touch(*Oldest);
+    return *Oldest;
+}
+
+void SLevelDrawSetCache::Invalidate()
+{
+    WaitForPrefetch();
+    for (auto& Slot : Slots)
+    {
+        Slot.Level = nullptr;
+        Slot.LastUsed = 0;
+    }
+}
+
 void SRenderer::SetupTileset(const STileset* Tileset)
 {
-    LevelDrawData.TileSet = Tileset;
+    LevelDrawSetCache.Invalidate();
+
+    LevelDrawSet.DrawData.TileSet = Tileset;
     for (int TileTypeIndex = 0; TileTypeIndex < ETileGeometryType::Count; TileTypeIndex++)
     {
-        auto& DrawCall = LevelDrawData.DrawCalls[TileTypeIndex];
+        auto& DrawCall = LevelDrawSet.DrawData.DrawCalls[TileTypeIndex];
         DrawCall.SubGeometry = &Tileset->TileGeometry[TileTypeIndex];
+        /* Enough for a whole draw set, so Draw3DLevel doesn't allocate. Visible sets reach up to VisibilityDistance
+         * tiles ahead, with up to four walls each. */
+        DrawCall.Instances.reserve(512);
+
+        for (auto& Slot : LevelDrawSetCache.Slots)
+        {
+            Slot.DrawSet.DrawData.DrawCalls[TileTypeIndex].Instances.reserve(512);
+        }
+    }
+}
+
+void SRenderer::BakeLevel(const SWorldLevel* Level)
+{
+    /* Cached draw sets may be from the previous level or bake. */
+    LevelDrawSetCache.Invalidate();
+
+    /* The placeholder tileset has no cooked meshes. */
+    if (!bBakeLevels || LevelDrawSet.DrawData.TileSet == nullptr || LevelDrawSet.DrawData.TileSet->MeshAssets[ETileGeometryType::Floor] == nullptr)
+    {
+        return;
     }
+    LevelMesh.Bake(*Level, *LevelDrawSet.DrawData.TileSet);
 }
 
 void SRenderer::UploadMapData(const SWorldLevel* Level, const SCoordsAndDirection& POV) const
@@ -812,7 +1554,7 @@ void SRenderer::UploadMapData(const SWorldLevel* Level, const SCoordsAndDirectio
     ShaderMapData.POV = POV;
     ShaderMapData.Tiles = Level->Tiles;
 
-    glBindBuffer(GL_UNIFORM_BUFFER, ProgramMap.UniformBlockMap.UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, MapUniformBlocks.Map.UBO);
     /* Upload only relevant tiles within (width * height) range. */
     glBufferSubData(GL_UNIFORM_BUFFER, 0, offsetof(SShaderMapData, Tiles) + sizeof(STile) * (Level->Width * Level->Height), &ShaderMapData);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
@@ -823,8 +1565,27 @@ void SRenderer::SetTime(float Time) const
     GlobalsUniformBlock.SetFloat(offsetof(SShaderGlobals, Time), Time);
 }
 
+/* LEVEL_PULL_* each tile geometry type is expanded with in UBER3D_MODE_LEVEL_PULLED, -1 for those that aren't. */
+static constexpr std::array<int, ETileGeometryType::Count> LevelPullKinds = {
+    LEVEL_PULL_FLOOR,
+    LEVEL_PULL_HOLE,
+    LEVEL_PULL_WALL,
+    LEVEL_PULL_WALL_JOINT,
+    -1,
+    LEVEL_PULL_DOOR,
+    LEVEL_PULL_DOOR_FRAME,
+    -1,
+    -1,
+    -1,
+};
+
+/* Instances per window tile, indexed by LEVEL_PULL_*: one per edge for walls and door frames, two doors per edge. */
+static constexpr int LevelPullSlotCounts[] = { 1, 1, 4, 1, 4, 8 };
+
 void SRenderer::Flush(const SPlatformState& WindowData)
 {
+    Memory::SAllocationGuard AllocationGuard{ "SRenderer::Flush" };
+
     GlobalsUniformBlock.SetVector2(offsetof(SShaderGlobals, ScreenSize), { (float)MainFramebuffer.Width, (float)MainFramebuffer.Height });
 
     /* Begin Draw */
@@ -839,7 +1600,9 @@ void SRenderer::Flush(const SPlatformState& WindowData)
     SVec2Int SceneOffset = (SVec2Int(MainFramebuffer.Width, MainFramebuffer.Height) - Constants::SceneSize) / 2;
     glViewport(SceneOffset.X, SceneOffset.Y, Constants::SceneSize.X, Constants::SceneSize.Y);
 
-    ProgramUber3D.Use();
+    UploadInstances();
+
+    const SProgram3D* ProgramUber3DMode = nullptr;
 
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     for (int Index = 0; Index < Queue3D.CurrentIndex; ++Index)
@@ -849,32 +1612,73 @@ void SRenderer::Flush(const SPlatformState& WindowData)
         {
             continue;
         }
-        glUniform1i(ProgramUber3D.UniformModeID, Entry.Mode.ID);
+        if (ProgramUber3DMode != &ProgramUber3D[Entry.Mode.ID])
+        {
+            ProgramUber3DMode = &ProgramUber3D[Entry.Mode.ID];
+            ProgramUber3DMode->Use();
+        }
         glBindVertexArray(Entry.Geometry->VAO);
-        if (Entry.InstancedDrawCall != nullptr)
+        if (Entry.PulledGeometryTypes != 0)
+        {
+            const auto* Tileset = static_cast<const STileset*>(Entry.Geometry);
+            glUniform4fv(ProgramUber3DMode->UniformModeControlAID, 1, &Entry.Mode.ControlA.X);
+            glUniform4fv(ProgramUber3DMode->UniformModeControlBID, 1, &Entry.Mode.ControlB.X);
+            glUniform2i(ProgramUber3DMode->UniformLevelSizeID, LevelTiles.Size.X, LevelTiles.Size.Y);
+            for (int TileTypeIndex = 0; TileTypeIndex < ETileGeometryType::Count; ++TileTypeIndex)
+            {
+                const auto& SubGeometry = Tileset->TileGeometry[TileTypeIndex];
+                if ((Entry.PulledGeometryTypes & (1u << TileTypeIndex)) == 0 || SubGeometry.ElementCount == 0)
+                {
+                    continue;
+                }
+                auto PullKind = LevelPullKinds[TileTypeIndex];
+                glUniform1i(ProgramUber3DMode->UniformLevelPullKindID, PullKind);
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
+                    SubGeometry.ElementCount,
+                    GL_UNSIGNED_SHORT,
+                    reinterpret_cast<void*>(SubGeometry.ElementOffset),
+                    LEVEL_WINDOW_TILE_COUNT * LevelPullSlotCounts[PullKind],
+                    SubGeometry.BaseVertex);
+            }
+        }
+        else if (Entry.InstancedDrawCall != nullptr)
         {
             for (int DrawCallIndex = 0; DrawCallIndex < Entry.InstancedDrawCallCount; ++DrawCallIndex)
             {
-                auto& DrawCall = *(Entry.InstancedDrawCall + DrawCallIndex);
-                auto TotalCount = DrawCall.Count + DrawCall.DynamicCount;
-                if (TotalCount > 0)
+                auto OrderedIndex = Entry.InstancedDrawCallOrder != nullptr ? Entry.InstancedDrawCallOrder[DrawCallIndex] : DrawCallIndex;
+                auto& DrawCall = *(Entry.InstancedDrawCall + OrderedIndex);
+                if (DrawCall.InstanceCount > 0)
                 {
-                    glUniformMatrix4fv(ProgramUber3D.UniformModelID, TotalCount, GL_FALSE,
-                        &DrawCall.Transform[0].X.X);
-                    glDrawElementsInstanced(GL_TRIANGLES,
+                    glUniform1i(ProgramUber3DMode->UniformInstanceOffsetID, DrawCall.InstanceOffset);
+                    glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
                         DrawCall.SubGeometry->ElementCount,
                         GL_UNSIGNED_SHORT,
                         reinterpret_cast<void*>(DrawCall.SubGeometry->ElementOffset),
-                        TotalCount);
+                        DrawCall.InstanceCount,
+                        DrawCall.SubGeometry->BaseVertex);
                 }
             }
         }
-        else
+        else if (Entry.InstanceOffset >= 0)
         {
-            glUniformMatrix4fv(ProgramUber3D.UniformModelID, 1, GL_FALSE, &Entry.Model.X.X);
-            glDrawElements(GL_TRIANGLES, Entry.Geometry->ElementCount, GL_UNSIGNED_SHORT, nullptr);
+            glUniform1i(ProgramUber3DMode->UniformInstanceOffsetID, Entry.InstanceOffset);
+            auto IndexType = Entry.Geometry->IndexSize == (int)sizeof(uint32_t) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+            if (Entry.DrawRanges != nullptr)
+            {
+                for (int RangeIndex = 0; RangeIndex < Entry.DrawRangeCount; ++RangeIndex)
+                {
+                    const auto& Range = Entry.DrawRanges[RangeIndex];
+                    glDrawElements(GL_TRIANGLES, Range.ElementCount, IndexType, reinterpret_cast<void*>(Range.ElementOffset));
+                }
+            }
+            else
+            {
+                glDrawElements(GL_TRIANGLES, Entry.Geometry->ElementCount, IndexType, nullptr);
+            }
         }
     }
+    InstanceBuffer.Fence();
+    LevelInstanceBuffer.Fence();
     // glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
     /* Draw 2D */
@@ -888,6 +1692,7 @@ void SRenderer::Flush(const SPlatformState& WindowData)
     for (int Index = 0; Index < Queue2D.CurrentIndex; ++Index)
     {
         auto const& Entry = Queue2D.Entries[Index];
+        const SEntryMode& Mode = Entry.Mode;
 
         SProgram2D const* Program;
         switch (Entry.Program2DType)
@@ -896,10 +1701,10 @@ void SRenderer::Flush(const SPlatformState& WindowData)
                 Program = &ProgramHUD;
                 break;
             case EProgram2DType::Map:
-                Program = &ProgramMap;
+                Program = &ProgramMap[Mode.ID];
                 break;
             case EProgram2DType::Uber2D:
-                Program = &ProgramUber2D;
+                Program = &ProgramUber2D[Mode.ID];
                 break;
             default:
                 continue;
@@ -909,27 +1714,32 @@ void SRenderer::Flush(const SPlatformState& WindowData)
         glUniform2f(Program->UniformPositionScreenSpaceID, Entry.Position.X, Entry.Position.Y);
         glUniform2f(Program->UniformSizeScreenSpaceID, (float)Entry.SizePixels.X, (float)Entry.SizePixels.Y);
 
-        const SEntryMode& Mode = Entry.Mode;
-        glUniform1i(Program->UniformModeID, Mode.ID);
-
         if (Entry.Program2DType == EProgram2DType::Uber2D)
         {
-            glUniform4fv(ProgramUber2D.UniformUVRectID, 1, &Entry.UVRect.X);
+            const auto& ProgramUber2DMode = ProgramUber2D[Mode.ID];
+            glUniform4fv(ProgramUber2DMode.UniformUVRectID, 1, &Entry.UVRect.X);
 
             if (Mode.ID > UBER2D_MODE_TEXTURE)
             {
-                glUniform4fv(ProgramUber2D.UniformModeControlAID, 1, &Mode.ControlA.X);
-                glUniform4fv(ProgramUber2D.UniformModeControlBID, 1, &Mode.ControlB.X);
+                glUniform4fv(ProgramUber2DMode.UniformModeControlAID, 1, &Mode.ControlA.X);
+                glUniform4fv(ProgramUber2DMode.UniformModeControlBID, 1, &Mode.ControlB.X);
             }
             if (Mode.ID == UBER2D_MODE_BACK_BLUR)
             {
                 glDrawElementsInstanced(GL_TRIANGLES, Quad2D.ElementCount, GL_UNSIGNED_SHORT, nullptr,
                     (int)Mode.ControlA.X);
-                glUniform1i(Program->UniformModeID, 0);
+
+                /* The sprite itself goes on top of its blurred copies. */
+                const auto& ProgramTexture = ProgramUber2D[UBER2D_MODE_TEXTURE];
+                ProgramTexture.Use();
+                glUniform2f(ProgramTexture.UniformPositionScreenSpaceID, Entry.Position.X, Entry.Position.Y);
+                glUniform2f(ProgramTexture.UniformSizeScreenSpaceID, (float)Entry.SizePixels.X, (float)Entry.SizePixels.Y);
+                glUniform4fv(ProgramTexture.UniformUVRectID, 1, &Entry.UVRect.X);
             }
         }
         else if (Entry.Program2DType == EProgram2DType::HUD)
         {
+            glUniform1i(Program->UniformModeID, Mode.ID);
         }
 
         glDrawElements(GL_TRIANGLES, Quad2D.ElementCount, GL_UNSIGNED_SHORT, nullptr);
@@ -953,6 +1763,105 @@ void SRenderer::Flush(const SPlatformState& WindowData)
     Queue3D.Reset();
 }
 
+/* Copies up to Count elements into the mapped Region, returns how many fit. */
+template <typename T>
+static int WriteInstances(T* Region, int Capacity, int& Written, const T* Instances, int Count)
+{
+    Count = std::max(std::min(Count, Capacity - Written), 0);
+    if (Count > 0)
+    {
+        std::memcpy(Region + Written, Instances, Count * sizeof(T));
+        Written += Count;
+    }
+    return Count;
+}
+
+void SRenderer::UploadInstances()
+{
+    int TransformCount = 0;
+    int LevelInstanceCount = 0;
+    for (int Index = 0; Index < Queue3D.CurrentIndex; ++Index)
+    {
+        const auto& Entry = Queue3D.Entries[Index];
+        if (Entry.PulledGeometryTypes != 0)
+        {
+            continue;
+        }
+        if (Entry.InstancedDrawCall == nullptr)
+        {
+            TransformCount++;
+            continue;
+        }
+        for (int DrawCallIndex = 0; DrawCallIndex < Entry.InstancedDrawCallCount; ++DrawCallIndex)
+        {
+            const auto& DrawCall = *(Entry.InstancedDrawCall + DrawCallIndex);
+            LevelInstanceCount += DrawCall.Count + DrawCall.DynamicCount;
+        }
+    }
+
+    auto* Transforms = TransformCount > 0 ? static_cast<SMat4x4*>(InstanceBuffer.Map(TransformCount)) : nullptr;
+    int TransformCapacity = Transforms != nullptr ? std::min(TransformCount, InstanceBuffer.Capacity) : 0;
+    int TransformsWritten = 0;
+
+    auto* LevelInstances = LevelInstanceCount > 0 ? static_cast<SLevelInstance*>(LevelInstanceBuffer.Map(LevelInstanceCount)) : nullptr;
+    int LevelInstanceCapacity = LevelInstances != nullptr ? std::min(LevelInstanceCount, LevelInstanceBuffer.Capacity) : 0;
+    int LevelInstancesWritten = 0;
+
+    for (int Index = 0; Index < Queue3D.CurrentIndex; ++Index)
+    {
+        auto& Entry = Queue3D.Entries[Index];
+        if (Entry.PulledGeometryTypes != 0)
+        {
+            continue;
+        }
+        if (Entry.InstancedDrawCall == nullptr)
+        {
+            Entry.InstanceOffset = InstanceBuffer.GetRegionOffset() + TransformsWritten;
+            if (WriteInstances(Transforms, TransformCapacity, TransformsWritten, &Entry.Model, 1) == 0)
+            {
+                Entry.InstanceOffset = -1;
+            }
+            continue;
+        }
+        for (int DrawCallIndex = 0; DrawCallIndex < Entry.InstancedDrawCallCount; ++DrawCallIndex)
+        {
+            auto& DrawCall = *(Entry.InstancedDrawCall + DrawCallIndex);
+            DrawCall.InstanceOffset = LevelInstanceBuffer.GetRegionOffset() + LevelInstancesWritten;
+            DrawCall.InstanceCount = WriteInstances(LevelInstances, LevelInstanceCapacity, LevelInstancesWritten,
+                DrawCall.Instances.data(), DrawCall.Count + DrawCall.DynamicCount);
+        }
+    }
+
+    bool bTransformsLost = Transforms != nullptr && !InstanceBuffer.Unmap();
+    bool bLevelInstancesLost = LevelInstances != nullptr && !LevelInstanceBuffer.Unmap();
+    if (!bTransformsLost && !bLevelInstancesLost)
+    {
+        return;
+    }
+
+    /* Nothing is drawn from a lost region this frame. */
+    for (int Index = 0; Index < Queue3D.CurrentIndex; ++Index)
+    {
+        auto& Entry = Queue3D.Entries[Index];
+        if (Entry.PulledGeometryTypes != 0)
+        {
+            continue;
+        }
+        if (Entry.InstancedDrawCall == nullptr)
+        {
+            if (bTransformsLost)
+            {
+                Entry.InstanceOffset = -1;
+            }
+            continue;
+        }
+        for (int DrawCallIndex = 0; DrawCallIndex < Entry.InstancedDrawCallCount && bLevelInstancesLost; ++DrawCallIndex)
+        {
+            (Entry.InstancedDrawCall + DrawCallIndex)->InstanceCount = 0;
+        }
+    }
+}
+
 void SRenderer::UploadProjectionAndViewFromCamera(const SCamera& Camera) const
 {
     Queue3D.CommonUniformBlock.SetMatrix(0, Camera.Projection);
@@ -979,7 +1888,7 @@ void SRenderer::DrawMap(SWorldLevel* Level, SVec3 Position, SVec2Int Size, const
 
     if (bPOVChanged || bDirtyRange)
     {
-        glBindBuffer(GL_UNIFORM_BUFFER, ProgramMap.UniformBlockMap.UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, MapUniformBlocks.Map.UBO);
         if (bPOVChanged)
         {
             glBufferSubData(GL_UNIFORM_BUFFER, offsetof(SShaderMapData, POV), sizeof(SCoordsAndDirection), &POV);
@@ -1014,11 +1923,11 @@ void SRenderer::DrawMap(SWorldLevel* Level, SVec3 Position, SVec2Int Size, const
 
 void SRenderer::DrawMapImmediate(const SVec2& Position, const SVec2& Size)
 {
-    ProgramMap.Use();
+    const auto& Program = ProgramMap[MAP_MODE_NORMAL];
+    Program.Use();
 
-    glUniform1i(ProgramMap.UniformModeID, MAP_MODE_NORMAL);
-    glUniform2f(ProgramMap.UniformPositionScreenSpaceID, Position.X, Position.Y);
-    glUniform2f(ProgramMap.UniformSizeScreenSpaceID, Size.X, Size.Y);
+    glUniform2f(Program.UniformPositionScreenSpaceID, Position.X, Position.Y);
+    glUniform2f(Program.UniformSizeScreenSpaceID, Size.X, Size.Y);
 
     glBindVertexArray(Quad2D.VAO);
 
@@ -1041,11 +1950,11 @@ void SRenderer::DrawWorldMap(const SVec2& Position, const SVec2& Size)
 
 void SRenderer::DrawWorldMapImmediate(const SVec2& Position, const SVec2& Size)
 {
-    ProgramMap.Use();
+    const auto& Program = ProgramMap[MAP_MODE_WORLD];
+    Program.Use();
 
-    glUniform1i(ProgramMap.UniformModeID, MAP_MODE_WORLD);
-    glUniform2f(ProgramMap.UniformPositionScreenSpaceID, Position.X, Position.Y);
-    glUniform2f(ProgramMap.UniformSizeScreenSpaceID, Size.X, Size.Y);
+    glUniform2f(Program.UniformPositionScreenSpaceID, Position.X, Position.Y);
+    glUniform2f(Program.UniformSizeScreenSpaceID, Size.X, Size.Y);
 
     glBindVertexArray(Quad2D.VAO);
 
@@ -1062,10 +1971,10 @@ void SRenderer::DrawWorldLayers(const SWorld* World, SVec2Int Range)
 
     glBindVertexArray(Quad2D.VAO);
 
-    ProgramMap.SetEditorData(SVec2(), SVec4(), true, false, false);
-    ProgramMap.Use();
-    glUniform1i(ProgramMap.UniformModeID, MAP_MODE_WORLD_LAYER);
-    glUniform2f(ProgramMap.UniformPositionScreenSpaceID, 0.0f, 0.0f);
+    MapUniformBlocks.SetEditorData(SVec2(), SVec4(), true, false, false);
+    const auto& Program = ProgramMap[MAP_MODE_WORLD_LAYER];
+    Program.Use();
+    glUniform2f(Program.UniformPositionScreenSpaceID, 0.0f, 0.0f);
 
     int LayerIndex{};
     for (auto LevelIndex = Range.X; LevelIndex < Range.Y; LevelIndex++)
@@ -1088,7 +1997,7 @@ void SRenderer::DrawWorldLayers(const SWorld* World, SVec2Int Range)
 
         UploadMapData(Level, {});
 
-        glUniform2f(ProgramMap.UniformSizeScreenSpaceID, (float)Size.X, (float)Size.Y);
+        glUniform2f(Program.UniformSizeScreenSpaceID, (float)Size.X, (float)Size.Y);
 
         glDrawElements(GL_TRIANGLES, Quad2D.ElementCount, GL_UNSIGNED_SHORT, nullptr);
 
@@ -1099,11 +2008,11 @@ void SRenderer::DrawWorldLayers(const SWorld* World, SVec2Int Range)
         LayerIndex++;
     }
 
-    ProgramMap.SetEditorData(SVec2(), SVec4(), false, false, false);
+    MapUniformBlocks.SetEditorData(SVec2(), SVec4(), false, false, false);
 
     glBindVertexArray(0);
 
-    glBindBuffer(GL_UNIFORM_BUFFER, ProgramMap.UniformBlockWorld.UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, MapUniformBlocks.World.UBO);
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SShaderWorld), &ShaderWorld);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
@@ -1222,68 +2131,162 @@ void SRenderer::Draw3D(SVec3 Position, SGeometry* Geometry)
     Queue3D.Enqueue(Entry);
 }
 
-void SRenderer::Draw3DLevel(SWorldLevel* Level, const SVec2Int& POVOrigin, const SDirection& POVDirection)
+void SRenderer::BuildLevelDrawSet(const SWorldLevel* Level, const STileset& Tileset, const SVec2Int& POVOrigin, SDirection POVDirection,
+    const SDrawDoorInfo* OpenDoor, const SLevelDrawSetOptions& Options, SLevelDrawSet& DrawSet) const
 {
     auto constexpr DrawDistanceForward = 4;
     auto constexpr DrawDistanceSide = 2;
 
-    auto& DoorDrawCall = LevelDrawData.DrawCalls[ETileGeometryType::Door];
+    DrawSet.DrawData.Clear();
+    DrawSet.VisibleTileCount = 0;
 
-    /* @TODO: Generic CleanDynamic method? */
-    DoorDrawCall.DynamicCount = 0;
+    auto& FloorDrawCall = DrawSet.DrawData.DrawCalls[ETileGeometryType::Floor];
 
-    if (Level->DirtyFlags & ELevelDirtyFlags::DrawSet)
-    {
-        LevelDrawData.Clear();
+    auto& HoleDrawCall = DrawSet.DrawData.DrawCalls[ETileGeometryType::Hole];
 
-        auto& FloorDrawCall = LevelDrawData.DrawCalls[ETileGeometryType::Floor];
+    auto& WallDrawCall = DrawSet.DrawData.DrawCalls[ETileGeometryType::Wall];
 
-        auto& HoleDrawCall = LevelDrawData.DrawCalls[ETileGeometryType::Hole];
+    auto& WallJointDrawCall = DrawSet.DrawData.DrawCalls[ETileGeometryType::WallJoint];
+
+    auto& DoorFrameDrawCall = DrawSet.DrawData.DrawCalls[ETileGeometryType::DoorFrame];
+
+    auto& DoorDrawCall = DrawSet.DrawData.DrawCalls[ETileGeometryType::Door];
+
+    if (!Level->IsValidTile(POVOrigin))
+    {
+        return;
+    }
 
-        auto& WallDrawCall = LevelDrawData.DrawCalls[ETileGeometryType::Wall];
+    auto POVDirectionInverted = POVDirection.Inverted();
+    auto POVDirectionVectorForward = POVDirection.GetVector<int>();
+    auto POVDirectionVectorSide = SVec2Int{ POVDirectionVectorForward.Y, -POVDirectionVectorForward.X };
 
-        auto& WallJointDrawCall = LevelDrawData.DrawCalls[ETileGeometryType::WallJoint];
+    DrawSet.MinCoords = POVOrigin;
+    DrawSet.MaxCoords = POVOrigin;
 
-        auto& DoorFrameDrawCall = LevelDrawData.DrawCalls[ETileGeometryType::DoorFrame];
+    /* Walls are seen from inside their tile. The eye may be up to a tile away from POVOrigin while the blob moves,
+     * so only walls whose plane is behind that are left out. */
+    auto IsWallFacingAway = [&](const SVec2Int& TileCoords, SDirection Direction) {
+        auto const Relative = TileCoords - POVOrigin;
+        auto const Normal = Direction.GetVector<int>();
+        return Options.bDepthOrdered && (Relative.X * Normal.X) + (Relative.Y * Normal.Y) <= -2;
+    };
 
-        if (!Level->IsValidTile(POVOrigin))
+    auto PushWallJoint = [&](const SVec2Int& JointCoords) {
+        if (!Options.bBaked && Level->bUseWallJoints && Level->IsValidWallJoint(JointCoords) && Level->IsWallJointAt(JointCoords))
         {
-            return;
+            WallJointDrawCall.Push(SLevelInstance::Make({ (float)JointCoords.X, 0.0f, (float)JointCoords.Y }, 0));
         }
+    };
 
-        auto POVDirectionInverted = POVDirection.Inverted();
-        auto POVDirectionVectorForward = POVDirection.GetVector<int>();
-        auto POVDirectionVectorSide = SVec2Int{ POVDirectionVectorForward.Y, -POVDirectionVectorForward.X };
+    auto PushTile = [&](const SVec2Int& TileCoords, const STile* Tile) {
+        DrawSet.MinCoords = { std::min(DrawSet.MinCoords.X, TileCoords.X), std::min(DrawSet.MinCoords.Y, TileCoords.Y) };
+        DrawSet.MaxCoords = { std::max(DrawSet.MaxCoords.X, TileCoords.X), std::max(DrawSet.MaxCoords.Y, TileCoords.Y) };
 
-        for (int SideCounter = -DrawDistanceSide; SideCounter <= DrawDistanceSide; ++SideCounter)
+        auto TileInstance = SLevelInstance::Make({ (float)TileCoords.X, 0.0f, (float)TileCoords.Y }, 0);
+
+        if (!Options.bBaked)
         {
-            for (int ForwardCounter = -1; ForwardCounter < DrawDistanceForward; ++ForwardCounter)
+            if (Tile->CheckFlag(TILE_FLOOR_BIT))
             {
-                auto RelativeX = (POVDirectionVectorForward.X * ForwardCounter) + (POVDirectionVectorSide.X * SideCounter);
-                auto RelativeY = (POVDirectionVectorForward.Y * ForwardCounter) + (POVDirectionVectorSide.Y * SideCounter);
+                FloorDrawCall.Push(TileInstance);
+            }
+            else if (Tile->CheckFlag(TILE_HOLE_BIT))
+            {
+                HoleDrawCall.Push(TileInstance);
+            }
+        }
 
-                auto X = POVOrigin.X + RelativeX;
-                auto Y = POVOrigin.Y + RelativeY;
+        for (auto& Direction : SDirection::All())
+        {
+            if (Tile->IsEdgeEmpty(Direction))
+            {
+                continue;
+            }
 
-                auto XOffset = (float)X;
-                auto YOffset = (float)Y;
+            auto EdgeInstance = TileInstance;
+            EdgeInstance.Yaw = Direction.YawFromDirection();
 
-                auto TileCoords = SVec2Int{ X, Y };
+            if (!Options.bBaked && Tile->CheckEdgeFlag(TILE_EDGE_WALL_BIT, Direction) && !IsWallFacingAway(TileCoords, Direction))
+            {
+                WallDrawCall.Push(EdgeInstance);
+            }
 
-                auto TileTransform = SMat4x4::Identity();
-                TileTransform.Translate(SVec3{ XOffset, 0.0f, YOffset });
+            if (Tile->CheckEdgeFlag(TILE_EDGE_DOOR_BIT, Direction))
+            {
+                if (!Options.bBaked)
+                {
+                    DoorFrameDrawCall.Push(EdgeInstance);
+                }
 
-                /* @TODO: Draw joints in separate loop. */
-                /* @TODO: Maybe don't store them at all? */
-                if (Level->bUseWallJoints && Level->IsValidWallJoint({ X, Y }))
+                /* Check two adjacent tiles for ongoing door animation.
+                 * Prevents static doors from being drawn if the animation is playing. */
+                if (OpenDoor != nullptr)
                 {
-                    auto bWallJoint = Level->IsWallJointAt({ X, Y });
-                    if (bWallJoint)
+                    if (TileCoords == OpenDoor->TileCoords && Direction == OpenDoor->Direction)
+                    {
+                        continue;
+                    }
+                    if (TileCoords == POVOrigin && Direction == POVDirectionInverted)
                     {
-                        WallJointDrawCall.Push(TileTransform);
+                        continue;
                     }
                 }
 
+                Draw3DLevelDoor(Tileset, DoorDrawCall, TileCoords, Direction, -1.0f);
+            }
+        }
+    };
+
+    int VisibleSetCount = 0;
+    const uint16_t* VisibleSet = nullptr;
+    /* The visible sets see every door as closed, the one being opened has to be walked through. */
+    if (Options.bPortalCulling || OpenDoor != nullptr)
+    {
+        VisibleSetCount = Level->FindVisibleTiles(POVOrigin, POVDirection, PortalCullingHalfFieldOfView, OpenDoor, DrawSet.VisibleTiles);
+        VisibleSet = DrawSet.VisibleTiles.data();
+    }
+    else
+    {
+        VisibleSet = Level->GetVisibleSet(POVOrigin, POVDirection, VisibleSetCount);
+        std::copy(VisibleSet, VisibleSet + VisibleSetCount, DrawSet.VisibleTiles.begin());
+    }
+    DrawSet.VisibleTileCount = VisibleSetCount;
+
+    if (VisibleSet != nullptr)
+    {
+        /* Joints are on tile corners, neighbouring tiles share them. */
+        std::bitset<(MAX_LEVEL_WIDTH + 1) * (MAX_LEVEL_HEIGHT + 1)> PushedWallJoints{};
+        for (int Index = 0; Index < VisibleSetCount; ++Index)
+        {
+            auto TileCoords = Level->IndexToCoords(VisibleSet[Index]);
+            for (auto& JointCoords : { TileCoords, TileCoords + SVec2Int{ 1, 0 }, TileCoords + SVec2Int{ 0, 1 }, TileCoords + SVec2Int{ 1, 1 } })
+            {
+                auto JointIndex = Level->WallJointCoordsToIndex(JointCoords.X, JointCoords.Y);
+                if (!PushedWallJoints.test(JointIndex))
+                {
+                    PushedWallJoints.set(JointIndex);
+                    PushWallJoint(JointCoords);
+                }
+            }
+            PushTile(TileCoords, Level->GetTile(VisibleSet[Index]));
+        }
+    }
+    else
+    {
+        for (int SideCounter = -DrawDistanceSide; SideCounter <= DrawDistanceSide; ++SideCounter)
+        {
+            for (int ForwardCounter = -1; ForwardCounter < DrawDistanceForward; ++ForwardCounter)
+            {
+                auto RelativeX = (POVDirectionVectorForward.X * ForwardCounter) + (POVDirectionVectorSide.X * SideCounter);
+                auto RelativeY = (POVDirectionVectorForward.Y * ForwardCounter) + (POVDirectionVectorSide.Y * SideCounter);
+
+                auto TileCoords = SVec2Int{ POVOrigin.X + RelativeX, POVOrigin.Y + RelativeY };
+
+                /* @TODO: Draw joints in separate loop. */
+                /* @TODO: Maybe don't store them at all? */
+                PushWallJoint(TileCoords);
+
                 auto Tile = Level->GetTileAt(TileCoords);
 
                 if (Tile == nullptr)
@@ -1306,71 +2309,202 @@ void SRenderer::Draw3DLevel(SWorldLevel* Level, const SVec2Int& POVOrigin, const
                     break;
                 }
 
-                if (Tile->CheckFlag(TILE_FLOOR_BIT))
-                {
-                    FloorDrawCall.Push(TileTransform);
-                }
-                else if (Tile->CheckFlag(TILE_HOLE_BIT))
-                {
-                    HoleDrawCall.Push(TileTransform);
-                }
+                PushTile(TileCoords, Tile);
+            }
+        }
+    }
 
-                for (auto& Direction : SDirection::All())
-                {
-                    if (Tile->IsEdgeEmpty(Direction))
-                    {
-                        continue;
-                    }
+    if (Options.bDepthOrdered)
+    {
+        /* Nearest first within each draw call, so the depth test rejects most of what's behind. */
+        SVec2Int const Eye = POVOrigin * LEVEL_INSTANCE_POSITION_SCALE;
+        auto DistanceSquared = [&](const SLevelInstance& Instance) {
+            auto const X = (int32_t)Instance.X - Eye.X;
+            auto const Z = (int32_t)Instance.Z - Eye.Y;
+            return (X * X) + (Z * Z);
+        };
+        for (auto& DrawCall : DrawSet.DrawData.DrawCalls)
+        {
+            std::sort(DrawCall.Instances.begin(), DrawCall.Instances.begin() + DrawCall.Count, [&](const SLevelInstance& A, const SLevelInstance& B) {
+                return DistanceSquared(A) < DistanceSquared(B);
+            });
+        }
+    }
+}
 
-                    auto Transform = TileTransform;
-                    Transform.Rotate(Direction.RotationFromDirection(),
-                        { 0.0f, 1.0f, 0.0f });
+/* Walls and doors hide most of what's behind them, floors hardly hide anything. */
+static constexpr std::array<uint8_t, ETileGeometryType::Count> DepthOrderedDrawCalls = {
+    ETileGeometryType::Wall,
+    ETileGeometryType::Door,
+    ETileGeometryType::DoorFrame,
+    ETileGeometryType::WallJoint,
+    ETileGeometryType::Floor,
+    ETileGeometryType::Hole,
+    ETileGeometryType::Ceil,
+    ETileGeometryType::CustomA,
+    ETileGeometryType::CustomB,
+    ETileGeometryType::CustomC,
+};
 
-                    if (Tile->CheckEdgeFlag(TILE_EDGE_WALL_BIT, Direction))
-                    {
-                        WallDrawCall.Push(Transform);
-                    }
+static void BuildLevelDrawSetJob(void* Data)
+{
+    auto& Slot = *static_cast<SLevelDrawSetCache::SSlot*>(Data);
+    Slot.Renderer->BuildLevelDrawSet(Slot.Level, *Slot.Tileset, Slot.Coords, Slot.Direction, nullptr, Slot.Options, Slot.DrawSet);
+}
 
-                    if (Tile->CheckEdgeFlag(TILE_EDGE_DOOR_BIT, Direction))
-                    {
-                        DoorFrameDrawCall.Push(Transform);
+void SRenderer::PrefetchLevelDrawSets(const SWorldLevel* Level, const SVec2Int& POVOrigin, SDirection POVDirection, const SLevelDrawSetOptions& Options)
+{
+    /* Steps keep the direction, turns keep the coords. */
+    auto Prefetch = [&](const SVec2Int& Coords, SDirection Direction) {
+        if (!Level->IsValidTile(Coords) || LevelDrawSetCache.Find(Level, Coords, Direction) != nullptr)
+        {
+            return;
+        }
 
-                        /* Check two adjacent tiles for ongoing door animation.
-                         * Prevents static doors from being drawn if the animation is playing. */
-                        if (Level->DoorInfo.Timeline.IsPlaying())
-                        {
-                            if (TileCoords == Level->DoorInfo.TileCoords && Direction == Level->DoorInfo.Direction)
-                            {
-                                continue;
-                            }
-                            if (TileCoords == POVOrigin && Direction == POVDirectionInverted)
-                            {
-                                continue;
-                            }
-                        }
+        auto& Slot = LevelDrawSetCache.Claim(Level, Coords, Direction);
+        Slot.Renderer = this;
+        Slot.Tileset = LevelDrawSet.DrawData.TileSet;
+        Slot.Options = Options;
+        Jobs::Run(LevelDrawSetCache.PrefetchCounter, &BuildLevelDrawSetJob, &Slot);
+    };
 
-                        Draw3DLevelDoor(DoorDrawCall, TileCoords, Direction, -1.0f);
-                    }
+    for (auto& Direction : SDirection::All())
+    {
+        Prefetch(POVOrigin + Direction.GetVector<int>(), POVDirection);
+    }
+    Prefetch(POVOrigin, POVDirection.Side());
+    Prefetch(POVOrigin, POVDirection.Side().Inverted());
+}
+
+void SRenderer::Draw3DLevel(SWorldLevel* Level, const SVec2Int& POVOrigin, const SDirection& POVDirection)
+{
+    Memory::SAllocationGuard AllocationGuard{ "SRenderer::Draw3DLevel" };
+
+    auto& DoorDrawCall = LevelDrawSet.DrawData.DrawCalls[ETileGeometryType::Door];
+
+    /* @TODO: Generic CleanDynamic method? */
+    DoorDrawCall.DynamicCount = 0;
+
+    const auto* Tileset = LevelDrawSet.DrawData.TileSet;
+    /* Only the animated door is left to instance when the level is pulled from its tiles. */
+    bool bPulled = bPullLevels && LevelTiles.Level == Level && Tileset != nullptr;
+    /* Only doors are left to instance when the level is baked. */
+    bool bBaked = !bPulled && bBakeLevels && LevelMesh.Level == Level;
+    SLevelDrawSetOptions Options{ bBaked, bPortalCulling, bDepthOrderLevels };
+
+    if (bPulled)
+    {
+        if (Level->DirtyFlags & ELevelDirtyFlags::DrawSet)
+        {
+            LevelDrawSet.DrawData.Clear();
+            LevelDrawSet.VisibleTileCount = 0;
+            Level->DirtyFlags &= ~ELevelDirtyFlags::DrawSet;
+        }
+
+        SEntry3D PulledEntry;
+
+        PulledEntry.Geometry = Tileset;
+        PulledEntry.Model = SMat4x4::Identity();
+        PulledEntry.PulledGeometryTypes = (1u << ETileGeometryType::Floor) | (1u << ETileGeometryType::Hole) |
+            (1u << ETileGeometryType::Wall) | (1u << ETileGeometryType::DoorFrame);
+        if (Level->bUseWallJoints)
+        {
+            PulledEntry.PulledGeometryTypes |= 1u << ETileGeometryType::WallJoint;
+        }
+        if (Tileset->DoorAnimationType == EDoorAnimationType::TwoDoors)
+        {
+            PulledEntry.PulledGeometryTypes |= 1u << ETileGeometryType::Door;
+        }
+
+        /* Same test as Draw3DLevelDoor(), the door it pushes as a dynamic instance is left out of the tiles. */
+        const auto& DoorInfo = Level->DoorInfo;
+        bool bDoorAnimated = DoorInfo.TileCoords.X + DoorInfo.TileCoords.Y >= 0 && DoorInfo.Timeline.Value > 0.0f;
+        auto AnimatedDoorCoords = bDoorAnimated ? SVec2(DoorInfo.TileCoords) : SVec2{ -1.0f, -1.0f };
+
+        PulledEntry.Mode = SEntryMode{
+            UBER3D_MODE_LEVEL_PULLED,
+            { (float)POVOrigin.X, (float)POVOrigin.Y, (float)POVDirection.Index, Tileset->DoorOffset },
+            { AnimatedDoorCoords.X, AnimatedDoorCoords.Y, (float)DoorInfo.Direction.Index, 0.0f }
+        };
+
+        Queue3D.Enqueue(PulledEntry);
+    }
+    else if (Level->DirtyFlags & ELevelDirtyFlags::DrawSet)
+    {
+        /* The animated door changes the draw set for as long as it plays, those aren't worth caching. */
+        const SDrawDoorInfo* OpenDoor = Level->DoorInfo.Timeline.IsPlaying() ? &Level->DoorInfo : nullptr;
+        if (!bCacheDrawSets)
+        {
+            BuildLevelDrawSet(Level, *Tileset, POVOrigin, POVDirection, OpenDoor, Options, LevelDrawSet);
+        }
+        else
+        {
+            /* Slots are only touched once the workers are done with them. */
+            LevelDrawSetCache.WaitForPrefetch();
+
+            if (OpenDoor != nullptr)
+            {
+                BuildLevelDrawSet(Level, *Tileset, POVOrigin, POVDirection, OpenDoor, Options, LevelDrawSet);
+            }
+            else
+            {
+                auto* Slot = LevelDrawSetCache.Find(Level, POVOrigin, POVDirection);
+                if (Slot == nullptr)
+                {
+                    Slot = &LevelDrawSetCache.Claim(Level, POVOrigin, POVDirection);
+                    BuildLevelDrawSet(Level, *Tileset, POVOrigin, POVDirection, nullptr, Options, Slot->DrawSet);
                 }
+                LevelDrawSetCache.Touch(*Slot);
+                LevelDrawSet.CopyFrom(Slot->DrawSet);
             }
+
+            PrefetchLevelDrawSets(Level, POVOrigin, POVDirection, Options);
         }
+
+        if (bBaked)
+        {
+            LevelMesh.SelectVisibleChunks(LevelDrawSet.MinCoords, LevelDrawSet.MaxCoords, bDepthOrderLevels ? &POVOrigin : nullptr);
+        }
+
         Level->DirtyFlags &= ~ELevelDirtyFlags::DrawSet;
 
         Log::Draw<ELogLevel::Debug>("%s(): Regenerated Level Draw Set", __func__);
     }
 
     Draw3DLevelDoor(
+        *Tileset,
         DoorDrawCall,
         Level->DoorInfo.TileCoords,
         Level->DoorInfo.Direction,
         Level->DoorInfo.Timeline.Value);
 
+    if (bBaked)
+    {
+        SEntry3D BakedEntry;
+
+        BakedEntry.Geometry = &LevelMesh;
+        BakedEntry.Model = SMat4x4::Identity();
+        BakedEntry.DrawRanges = LevelMesh.VisibleRanges.data();
+        BakedEntry.DrawRangeCount = LevelMesh.VisibleRangeCount;
+
+        /* Baked vertices are in world space already. */
+        BakedEntry.Mode = SEntryMode{
+            UBER3D_MODE_BASIC
+        };
+
+        Queue3D.Enqueue(BakedEntry);
+    }
+
     SEntry3D Entry;
 
-    Entry.Geometry = LevelDrawData.TileSet;
+    Entry.Geometry = LevelDrawSet.DrawData.TileSet;
     Entry.Model = SMat4x4::Identity();
-    Entry.InstancedDrawCall = &LevelDrawData.DrawCalls[0];
+    Entry.InstancedDrawCall = &LevelDrawSet.DrawData.DrawCalls[0];
     Entry.InstancedDrawCallCount = ETileGeometryType::Count;
+    if (bDepthOrderLevels)
+    {
+        Entry.InstancedDrawCallOrder = DepthOrderedDrawCalls.data();
+    }
 
     Entry.Mode = SEntryMode{
         UBER3D_MODE_LEVEL
@@ -1379,7 +2513,8 @@ void SRenderer::Draw3DLevel(SWorldLevel* Level, const SVec2Int& POVOrigin, const
     Queue3D.Enqueue(Entry);
 }
 
-void SRenderer::Draw3DLevelDoor(SInstancedDrawCall& DoorDrawCall, const SVec2Int& TileCoords, SDirection Direction, float AnimationAlpha) const
+void SRenderer::Draw3DLevelDoor(const STileset& Tileset, SInstancedDrawCall& DoorDrawCall, const SVec2Int& TileCoords, SDirection Direction,
+    float AnimationAlpha) const
 {
     if (TileCoords.X + TileCoords.Y < 0)
     {
@@ -1392,44 +2527,45 @@ void SRenderer::Draw3DLevelDoor(SInstancedDrawCall& DoorDrawCall, const SVec2Int
     DirectionalOffset.Z = Temp.Y;
 
     auto TileCoordsOffset = SVec3{ (float)TileCoords.X, 0.0f, (float)TileCoords.Y };
+    auto DoorwayCenter = (DirectionalOffset * 0.5f) + TileCoordsOffset;
 
-    SMat4x4 Transform = SMat4x4::Identity();
-    Transform.Translate((DirectionalOffset * 0.5f) + TileCoordsOffset);
-
-    switch (LevelDrawData.TileSet->DoorAnimationType)
+    switch (Tileset.DoorAnimationType)
     {
         case EDoorAnimationType::TwoDoors:
         {
-            /* Right door. */
-            auto RightTransform = Transform;
+            /* Each door is turned to face a direction and then moved by DoorOffset along its own X axis, which
+             * points to the side of that direction. The left door faces the doorway direction itself, the right
+             * one the inverted direction. */
+            auto DoorOffset = Tileset.DoorOffset;
 
-            RightTransform.Rotate(SDirection{ Direction }.Inverted().RotationFromDirection(), { 0.0f, 1.0f, 0.0f });
-            RightTransform.Translate({ LevelDrawData.TileSet->DoorOffset, 0.0f, 0.0f });
+            /* Right door. */
+            auto RightDirection = SDirection{ Direction }.Inverted();
+            auto RightSide = RightDirection.Side().GetVector<float>();
+            auto RightInstance = SLevelInstance::Make(DoorwayCenter + SVec3{ RightSide.X, 0.0f, RightSide.Y } * DoorOffset,
+                RightDirection.YawFromDirection());
 
             /* Left door. */
-            auto LeftTransform = Transform;
-
-            LeftTransform.Rotate(Math::PI, { 0.0f, 1.0f, 0.0f });
-            LeftTransform.Rotate(SDirection{ Direction }.Inverted().RotationFromDirection(), { 0.0f, 1.0f, 0.0f });
-            LeftTransform.Translate({ LevelDrawData.TileSet->DoorOffset, 0.0f, 0.0f });
+            auto LeftSide = SDirection{ Direction }.Side().GetVector<float>();
+            auto LeftInstance = SLevelInstance::Make(DoorwayCenter + SVec3{ LeftSide.X, 0.0f, LeftSide.Y } * DoorOffset,
+                SDirection{ Direction }.YawFromDirection());
 
             /* Animate relevant doors. */
             if (AnimationAlpha > 0.0f)
             {
                 auto A = AnimationAlpha * Math::HalfPI;
 
-                LeftTransform.Rotate(A);
+                LeftInstance.Yaw += SLevelInstance::YawFromRadians(A);
                 //                A = std::max(0.0f, A - 0.4f);
                 //                A *= 1.35f;
-                RightTransform.Rotate(-A);
+                RightInstance.Yaw -= SLevelInstance::YawFromRadians(A);
 
-                DoorDrawCall.PushDynamic(LeftTransform);
-                DoorDrawCall.PushDynamic(RightTransform);
+                DoorDrawCall.PushDynamic(LeftInstance);
+                DoorDrawCall.PushDynamic(RightInstance);
             }
             else if (AnimationAlpha < 0.0f)
             {
-                DoorDrawCall.Push(LeftTransform);
-                DoorDrawCall.Push(RightTransform);
+                DoorDrawCall.Push(LeftInstance);
+                DoorDrawCall.Push(RightInstance);
             }
         }
         break;
@@ -1481,67 +2617,41 @@ void SAtlas::Init(int InTextureUnitID)
 {
     TextureUnitID = InTextureUnitID;
     InitEmpty(WidthAndHeight, WidthAndHeight, true);
-    std::iota(SortingIndices.begin(), SortingIndices.end(), 0);
 }
 
-SSpriteHandle SAtlas::AddSprite(const SAsset& Resource)
+void SAtlas::Upload(const SAsset& CookedAtlas, const SSprite* InSprites, int InSpriteCount)
 {
-    CRawImageInfo const RawImageInfo(Resource);
+    SCookedAtlas const Atlas(CookedAtlas);
+    if (!Atlas.IsValid())
+    {
+        return;
+    }
+    if (Atlas.Width != WidthAndHeight || Atlas.Height > WidthAndHeight || Atlas.SpriteCount != InSpriteCount)
+    {
+        Log::Draw<ELogLevel::Critical>("Cooked atlas (%dx%d, %d sprites) doesn't match its sprite table (%d sprites), rerun the atlas cooker",
+            Atlas.Width, Atlas.Height, Atlas.SpriteCount, InSpriteCount);
+        return;
+    }
 
-    Sprites[CurrentIndex].SizePixels = { RawImageInfo.Width, RawImageInfo.Height };
-    Sprites[CurrentIndex].Resource = &Resource;
-    return { this, &Sprites[CurrentIndex++] };
-}
+    Sprites = InSprites;
+    SpriteCount = InSpriteCount;
 
-void SAtlas::Build()
-{
     glActiveTexture(GL_TEXTURE0 + TextureUnitID);
     glBindTexture(GL_TEXTURE_2D, ID);
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+        0, 0,
+        Atlas.Width, Atlas.Height,
+        GL_RGBA,
+        GL_UNSIGNED_BYTE, Atlas.Pixels);
+    glActiveTexture(GL_TEXTURE0);
+}
 
-    std::sort(SortingIndices.begin(), SortingIndices.end(), [&](const int& IndexA, const int& IndexB) {
-        return Sprites[IndexA].SizePixels.Y > Sprites[IndexB].SizePixels.Y;
-    });
-
-    int CursorX{};
-    int CursorY{};
-    int MaxHeight{};
-
-    for (int Index = 0; Index < CurrentIndex; ++Index)
+SSpriteHandle SAtlas::GetSprite(int Index) const
+{
+    if (Index < 0 || Index >= SpriteCount)
     {
-        auto& Sprite = Sprites[SortingIndices[Index]];
-        CRawImage const Image(*Sprite.Resource);
-
-        if (CursorX + Image.Width > WidthAndHeight)
-        {
-            CursorY += MaxHeight;
-            CursorX = 0;
-            MaxHeight = 0;
-        }
-
-        if (CursorY + Image.Height > WidthAndHeight)
-        {
-            break;
-        }
-
-        float MinU = (float)(CursorX) / (float)(WidthAndHeight);
-        float MinV = (float)(CursorY) / (float)(WidthAndHeight);
-        float MaxU = MinU + ((float)(Image.Width) / (float)WidthAndHeight);
-        float MaxV = MinV + ((float)(Image.Height) / (float)WidthAndHeight);
-        Sprite.UVRect = { MinU, MinV, MaxU, MaxV };
-
-        glTexSubImage2D(GL_TEXTURE_2D, 0,
-            CursorX, CursorY,
-            Image.Width, Image.Height,
-            GL_RGBA,
-            GL_UNSIGNED_BYTE, Image.Data);
-
-        CursorX += Image.Width;
-
-        if (Image.Height > MaxHeight)
-        {
-            MaxHeight = Image.Height;
-        }
+        Log::Draw<ELogLevel::Critical>("Sprite %d is out of range, the atlas has %d sprites", Index, SpriteCount);
+        return { this, nullptr };
     }
-
-    glActiveTexture(GL_TEXTURE0);
+    return { this, &Sprites[Index] };
 }
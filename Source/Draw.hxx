@@ -5,14 +5,19 @@
 #include "AssetTools.hxx"
 #include "SharedConstants.hxx"
 #include "Math.hxx"
+#include "Jobs.hxx"
+#include "Memory.hxx"
 #include "Tile.hxx"
 #include "Utility.hxx"
 
 #define RENDERER_QUEUE2D_SIZE 16
 #define RENDERER_QUEUE3D_SIZE 8
 
+/* Baked level meshes are split into chunks of LEVEL_CHUNK_SIZE * LEVEL_CHUNK_SIZE tiles. */
+#define LEVEL_CHUNK_SIZE 4
+#define LEVEL_MAX_CHUNK_COUNT (((MAX_LEVEL_WIDTH + LEVEL_CHUNK_SIZE - 1) / LEVEL_CHUNK_SIZE) * ((MAX_LEVEL_HEIGHT + LEVEL_CHUNK_SIZE - 1) / LEVEL_CHUNK_SIZE))
+
 #define ATLAS_COUNT 4
-#define ATLAS_MAX_SPRITE_COUNT 16
 #define ATLAS_COMMON 0
 #define ATLAS_PRIMARY2D 1
 #define ATLAS_PRIMARY3D 2
@@ -27,7 +32,10 @@ namespace ETextureUnits
         AtlasPrimary3D,
         MainFramebuffer,
         MapFramebuffer,
-        WorldTextures
+        WorldTextures,
+        Instances,
+        LevelInstances,
+        LevelTiles
     };
 }
 
@@ -42,6 +50,7 @@ inline constexpr SVec2 MapWorldLayerTextureSize{
 };
 
 struct SWorldLevel;
+struct SDrawDoorInfo;
 
 struct SShaderGlobals
 {
@@ -129,19 +138,23 @@ private:
 
     static void CheckProgram(unsigned ProgramID);
 
-    static unsigned int CreateVertexShader(const char* Data, int Length);
+    static unsigned int CreateShader(unsigned int Type, const char* Data, int Length, int Permutation);
+
+    static unsigned int CreateVertexShader(const char* Data, int Length, int Permutation);
 
-    static unsigned int CreateFragmentShader(const char* Data, int Length);
+    static unsigned int CreateFragmentShader(const char* Data, int Length, int Permutation);
 
     static unsigned int CreateProgram(unsigned int VertexShader, unsigned int FragmentShader);
 
+    static void LinkProgram(unsigned int ProgramID, unsigned int VertexShader, unsigned int FragmentShader);
+
 protected:
     virtual void InitUniforms();
-    virtual void InitUniformBlocks() {};
-    virtual void CleanupUniformBlocks() const {};
 
 public:
     unsigned ID{};
+    /* Mode the program is specialized for through SHADER_MODE, -1 if it reads u_mode instead. */
+    int Permutation = -1;
     int UniformGlobals{};
     int UniformModeID{};
     int UniformModeControlAID{};
@@ -155,7 +168,7 @@ public:
 #endif
 
     void
-    Init(const SAsset& InVertexShaderAsset, const SAsset& InFragmentShaderAsset);
+    Init(const SAsset& InVertexShaderAsset, const SAsset& InFragmentShaderAsset, int InPermutation = -1);
 
     void Cleanup() const;
 
@@ -205,15 +218,22 @@ struct SProgramMap : SProgram2D
 {
 protected:
     void InitUniforms() override;
-    void InitUniformBlocks() override;
-    void CleanupUniformBlocks() const override;
 
 public:
-    SUniformBlock UniformBlockCommon{};
-    SUniformBlock UniformBlockEditor{};
-    SUniformBlock UniformBlockMap{};
-    SUniformBlock UniformBlockWorld{};
     int UniformWorldTextures{};
+};
+
+/* Shared by every map program permutation. */
+struct SMapUniformBlocks
+{
+    SUniformBlock Common{};
+    SUniformBlock Editor{};
+    SUniformBlock Map{};
+    SUniformBlock World{};
+
+    void Init();
+
+    void Cleanup() const;
 
     void SetEditorData(const SVec2& SelectedTile, const SVec4& SelectedBlock, uint32_t bEnabled, uint32_t bToggleMode, uint32_t bBlockMode) const;
     void SetCursor(const SVec2& Cursor) const;
@@ -225,11 +245,57 @@ protected:
     void InitUniforms() override;
 
 public:
-    int UniformModelID{};
+    int UniformInstancesID{};
+    int UniformLevelInstancesID{};
+    int UniformInstanceOffsetID{};
+    int UniformLevelTilesID{};
+    int UniformLevelSizeID{};
+    int UniformLevelPullKindID{};
+    int UniformModeControlAID{};
+    int UniformModeControlBID{};
     int UniformCommonAtlasID{};
     int UniformPrimaryAtlasID{};
 };
 
+/* One program per shader mode, compiled with SHADER_MODE defined so the mode checks fold away instead of
+ * branching on u_mode for every fragment. */
+template <typename TProgram, int Count>
+struct SProgramPermutations
+{
+    std::array<TProgram, Count> Programs;
+
+    void Init(const SAsset& VertexShaderAsset, const SAsset& FragmentShaderAsset)
+    {
+        for (int Mode = 0; Mode < Count; ++Mode)
+        {
+            Programs[Mode].Init(VertexShaderAsset, FragmentShaderAsset, Mode);
+        }
+    }
+
+    void Cleanup() const
+    {
+        for (const auto& Program : Programs)
+        {
+            Program.Cleanup();
+        }
+    }
+
+#ifdef EQUINOX_REACH_DEVELOPMENT
+    void Reload()
+    {
+        for (auto& Program : Programs)
+        {
+            Program.Reload();
+        }
+    }
+#endif
+
+    const TProgram& operator[](int Mode) const
+    {
+        return Programs[Mode];
+    }
+};
+
 struct SWorldFramebuffer
 {
     int Width{};
@@ -267,6 +333,28 @@ struct SMainFramebuffer
     void ResetViewport() const;
 };
 
+/* Vertex buffer formats, all interleaved with position, texture coordinate and normal at locations 0, 1 and 2. */
+enum class EVertexLayout
+{
+    /* SCookedVertex, uploaded straight from the cooked mesh. */
+    Float,
+    /* SPackedVertex, half the size. Only for meshes with texture coordinates within [0, 1]. */
+    Packed
+};
+
+struct SPackedVertex
+{
+    /* Half floats. */
+    uint16_t Position[3]{};
+    uint16_t : 16;
+    /* Normalized to [0, 1]. */
+    uint16_t TexCoord[2]{};
+    /* Normalized 10-10-10-2, X in the lowest bits. */
+    uint32_t Normal{};
+};
+
+static_assert(sizeof(SPackedVertex) == 16);
+
 struct SGeometry
 {
     unsigned VAO{};
@@ -274,8 +362,13 @@ struct SGeometry
     unsigned EBO{};
     unsigned CBO{};
     int ElementCount{};
+    EVertexLayout VertexLayout{};
+    /* Bytes per index, 16-bit unless the geometry has too many vertices. */
+    int IndexSize = sizeof(uint16_t);
 
-    void InitFromRawMesh(const CRawMesh& RawMesh);
+    /* Uploads the embedded cooked mesh, see SCookedMeshHeader. Falls back to EVertexLayout::Float if the mesh
+     * can't be packed. */
+    void InitFromCookedMesh(const SAsset& Resource, EVertexLayout InVertexLayout = EVertexLayout::Float);
 
     virtual void Cleanup();
 };
@@ -284,6 +377,8 @@ struct SSubGeometry
 {
     int ElementOffset{};
     int ElementCount{};
+    /* Added to every index, so meshes sharing a buffer keep their cooked indices. */
+    int BaseVertex{};
 };
 
 namespace ETileGeometryType
@@ -317,6 +412,8 @@ struct STileset : SGeometry
     EDoorAnimationType DoorAnimationType{};
     float DoorOffset{};
     std::array<SSubGeometry, ETileGeometryType::Count> TileGeometry;
+    /* Cooked meshes of every tile type, kept for SLevelMesh::Bake(). Null for the placeholder tileset. */
+    std::array<const SAsset*, ETileGeometryType::Count> MeshAssets{};
 
     void InitPlaceholder();
 
@@ -326,7 +423,30 @@ struct STileset : SGeometry
         const SAsset& Wall,
         const SAsset& WallJoint,
         const SAsset& DoorFrame,
-        const SAsset& Door);
+        const SAsset& Door,
+        EVertexLayout InVertexLayout = EVertexLayout::Packed);
+};
+
+/* Static geometry of a level (floors, holes, walls, wall joints and door frames) baked in world space into one
+ * vertex and index buffer when the level loads. The indices are laid out chunk by chunk, so drawing the level is a
+ * few element ranges instead of one instance per tile. Doors move, they stay instanced. */
+struct SLevelMesh : SGeometry
+{
+    /* Level the mesh was baked from. */
+    const SWorldLevel* Level{};
+    int ChunkCountX{};
+    int ChunkCountY{};
+    /* Row major. */
+    std::array<SSubGeometry, LEVEL_MAX_CHUNK_COUNT> Chunks{};
+    /* Picked by SelectVisibleChunks(), chunks that follow each other in the index buffer share a range. */
+    std::array<SSubGeometry, LEVEL_MAX_CHUNK_COUNT> VisibleRanges{};
+    int VisibleRangeCount{};
+
+    void Bake(const SWorldLevel& InLevel, const STileset& Tileset);
+
+    /* Picks every chunk overlapping the tiles from MinCoords to MaxCoords, inclusive. The chunks are ordered nearest
+     * first from SortOrigin if there is one. */
+    void SelectVisibleChunks(const SVec2Int& MinCoords, const SVec2Int& MaxCoords, const SVec2Int* SortOrigin = nullptr);
 };
 
 struct SCamera
@@ -386,20 +506,57 @@ struct SEntry2D : SEntry
     SVec4 UVRect{};
 };
 
+/* Level tile or door instance, Uber3D.vert rebuilds the model matrix from it in UBER3D_MODE_LEVEL.
+ * Level geometry is only ever translated and rotated around Y, so that's all it stores. */
+struct SLevelInstance
+{
+    /* Fixed point, LEVEL_INSTANCE_POSITION_SCALE units per tile. */
+    int16_t X{};
+    int16_t Y{};
+    int16_t Z{};
+    /* Rotation around Y in 1/65536 turns, see SDirection::YawFromDirection(). */
+    uint16_t Yaw{};
+
+    static constexpr int16_t ToFixed(float Value)
+    {
+        return static_cast<int16_t>(Value * LEVEL_INSTANCE_POSITION_SCALE + (Value < 0.0f ? -0.5f : 0.5f));
+    }
+
+    static constexpr uint16_t YawFromRadians(float Angle)
+    {
+        return static_cast<uint16_t>(static_cast<int32_t>(Angle * (65536.0f / (2.0f * Math::PI)) + (Angle < 0.0f ? -0.5f : 0.5f)));
+    }
+
+    static constexpr SLevelInstance Make(const SVec3& Position, uint16_t Yaw)
+    {
+        return { ToFixed(Position.X), ToFixed(Position.Y), ToFixed(Position.Z), Yaw };
+    }
+};
+
+static_assert(sizeof(SLevelInstance) == 8, "Level instances are read as one RGBA16I texel");
+static_assert((MAX_LEVEL_WIDTH + 1) * LEVEL_INSTANCE_POSITION_SCALE <= INT16_MAX &&
+    (MAX_LEVEL_HEIGHT + 1) * LEVEL_INSTANCE_POSITION_SCALE <= INT16_MAX, "Level instance positions must fit in 16 bits");
+
 struct SInstancedDrawCall
 {
     const SSubGeometry* SubGeometry{};
-    std::array<SMat4x4, UBER3D_MODEL_COUNT> Transform{};
+    /* Count static instances, then DynamicCount instances that are pushed again every frame. */
+    std::pmr::vector<SLevelInstance> Instances{ Memory::GetPoolResource() };
     int Count{};
     int DynamicCount{};
-    void Push(const SMat4x4& NewTransform)
+    /* Where SRenderer::Flush put the instances in the level instance buffer. */
+    int InstanceOffset{};
+    int InstanceCount{};
+    void Push(const SLevelInstance& NewInstance)
     {
-        Transform[Count % UBER3D_MODEL_COUNT] = NewTransform;
+        Instances.resize(Count + DynamicCount);
+        Instances.insert(Instances.begin() + Count, NewInstance);
         Count++;
     }
-    void PushDynamic(const SMat4x4& NewTransform)
+    void PushDynamic(const SLevelInstance& NewInstance)
     {
-        Transform[(Count + DynamicCount) % UBER3D_MODEL_COUNT] = NewTransform;
+        Instances.resize(Count + DynamicCount);
+        Instances.push_back(NewInstance);
         DynamicCount++;
     }
 };
@@ -419,14 +576,156 @@ struct SInstancedDrawData
     }
 };
 
+/* View of portal culling, a bit wider than the camera's horizontal half field of view, about 63 degrees. */
+inline constexpr float PortalCullingHalfFieldOfView = Math::Radians(70.0f);
+
+/* What a level draw set is built with, see SRenderer::BuildLevelDrawSet(). */
+struct SLevelDrawSetOptions
+{
+    /* Only doors are instanced, the rest is in the baked level mesh. */
+    bool bBaked{};
+    bool bPortalCulling{};
+    /* Instances are sorted nearest first and walls facing away from the POV are left out. */
+    bool bDepthOrdered{};
+};
+
+/* Everything Draw3DLevel builds for one POV. */
+struct SLevelDrawSet
+{
+    SInstancedDrawData<ETileGeometryType::Count> DrawData;
+    std::array<uint16_t, MAX_LEVEL_TILE_COUNT> VisibleTiles{};
+    int VisibleTileCount{};
+    /* Bounds of the pushed tiles, the baked mesh draws the chunks overlapping them. */
+    SVec2Int MinCoords{};
+    SVec2Int MaxCoords{};
+
+    /* Copies the static instances and visible tiles, the tileset and sub geometries are left alone. Doesn't
+     * allocate as long as the draw calls have enough capacity reserved. */
+    void CopyFrom(const SLevelDrawSet& Other);
+};
+
+/* Least recently used level draw sets keyed by level and POV. Once a POV is drawn, the POVs the blob can reach with
+ * one move are built on the job workers while the move animates, so the next draw set is usually a lookup. */
+struct SLevelDrawSetCache
+{
+    static constexpr int Capacity = 16;
+
+    struct SSlot
+    {
+        const SWorldLevel* Level{};
+        SVec2Int Coords{};
+        SDirection Direction{};
+        uint64_t LastUsed{};
+        /* Build arguments, kept here because jobs only get a pointer. */
+        const struct SRenderer* Renderer{};
+        const STileset* Tileset{};
+        SLevelDrawSetOptions Options{};
+        SLevelDrawSet DrawSet;
+    };
+
+    std::array<SSlot, Capacity> Slots;
+    uint64_t UseCounter{};
+    /* Pending prefetch jobs, every slot is only read once they're done. */
+    Jobs::SCounter PrefetchCounter;
+
+    [[nodiscard]] SSlot* Find(const SWorldLevel* Level, const SVec2Int& Coords, SDirection Direction);
+
+    /* Returns the least recently used slot keyed to the given POV, its draw set still has to be built. */
+    [[nodiscard]] SSlot& Claim(const SWorldLevel* Level, const SVec2Int& Coords, SDirection Direction);
+
+    void Touch(SSlot& Slot)
+    {
+        Slot.LastUsed = ++UseCounter;
+    }
+
+    void WaitForPrefetch()
+    {
+        Jobs::Wait(PrefetchCounter);
+    }
+
+    /* Drops every slot, for when the level, the tileset or the draw set options change. */
+    void Invalidate();
+};
+
 struct SEntry3D : SEntry
 {
     SMat4x4 Model{};
     const SGeometry* Geometry{};
+    /* Drawn with level instances, which only UBER3D_MODE_LEVEL reads. */
     SInstancedDrawCall* InstancedDrawCall{};
     int InstancedDrawCallCount{};
+    /* Order the draw calls are submitted in, by index, nullptr for as they are. */
+    const uint8_t* InstancedDrawCallOrder{};
+    /* Where SRenderer::Flush put Model in the instance buffer, -1 if it didn't fit. */
+    int InstanceOffset{};
+    /* Element ranges drawn instead of the whole geometry, see SLevelMesh. */
+    const SSubGeometry* DrawRanges{};
+    int DrawRangeCount{};
+    /* UBER3D_MODE_LEVEL_PULLED: bit per ETileGeometryType of Geometry, which has to be an STileset, expanded from
+     * the level tiles. */
+    uint32_t PulledGeometryTypes{};
+};
+
+/* Streams the per-instance data of every 3D draw in a frame, read with texelFetch through a texture buffer.
+ * The buffer holds FrameCount regions used in turn, each one fenced so it's only written again once the GPU is
+ * done with it. */
+struct SInstanceBuffer
+{
+    static constexpr int FrameCount = 3;
+
+    unsigned BO{};
+    unsigned TextureID{};
+    int TextureUnitID{};
+    int ElementSize{};
+    /* Elements per region. */
+    int Capacity{};
+    int MaxCapacity{};
+    int Frame{};
+    /* GLsync per region. */
+    void* Fences[FrameCount]{};
+
+    /* Every element is ElementTexels texels of TextureFormat. */
+    void Init(int InTextureUnitID, unsigned TextureFormat, int InElementSize, int ElementTexels, int InCapacity);
+
+    void Cleanup();
+
+    /* Maps the next region for at least Count elements, growing the buffer if needed.
+     * Capacity may still be below Count if the driver's texture buffer size limit is reached. */
+    [[nodiscard]] void* Map(int Count);
+
+    /* Returns false if the driver lost the mapped data, the region is undefined then. */
+    bool Unmap() const;
+
+    /* Called once the draws reading the current region are submitted. */
+    void Fence();
+
+    [[nodiscard]] int GetRegionOffset() const { return Frame * Capacity; }
+
+private:
+    void Resize(int InCapacity);
+
+    void DeleteFences();
+};
+
+/* Tiles of the current level in a texture buffer, one RGBA32UI texel per STile, read by Uber3D.vert in
+ * UBER3D_MODE_LEVEL_PULLED. */
+struct SLevelTileBuffer
+{
+    unsigned BO{};
+    unsigned TextureID{};
+    /* Level the tiles were uploaded from. */
+    const SWorldLevel* Level{};
+    SVec2Int Size{};
+
+    void Init(int TextureUnitID);
+
+    void Cleanup();
+
+    void Upload(const SWorldLevel* InLevel);
 };
 
+static_assert(sizeof(STile) == 16, "Tiles are read as one RGBA32UI texel");
+
 template <typename TEntry, int Size>
 struct SRenderQueue
 {
@@ -452,33 +751,38 @@ struct SRenderQueue
 
 struct SSpriteHandle
 {
-    struct SAtlas* Atlas{};
-    struct SSprite* Sprite{};
+    const struct SAtlas* Atlas{};
+    const struct SSprite* Sprite{};
 };
 
 struct SSprite
 {
     SVec4 UVRect{};
     SVec2Int SizePixels{};
-    const SAsset* Resource{};
 };
 
+/* Atlases are packed at build time by EquinoxReachAtlasCooker, which also generates the sprite table
+ * (CookedAtlas::<Name>::Sprites) used to look up sprites by index. */
 struct SAtlas : STexture
 {
 private:
-    static inline std::array<int, ATLAS_MAX_SPRITE_COUNT> SortingIndices;
     static constexpr int WidthAndHeight = ATLAS_SIZE;
-    int CurrentIndex{};
     int TextureUnitID{};
+    const SSprite* Sprites{};
+    int SpriteCount{};
 
 public:
-    std::array<SSprite, ATLAS_MAX_SPRITE_COUNT> Sprites;
-
     void Init(int InTextureUnitID);
 
-    SSpriteHandle AddSprite(const SAsset& Resource);
+    void Upload(const SAsset& CookedAtlas, const SSprite* InSprites, int InSpriteCount);
+
+    template <int SpriteCount>
+    void Upload(const SAsset& CookedAtlas, const SSprite (&InSprites)[SpriteCount])
+    {
+        Upload(CookedAtlas, InSprites, SpriteCount);
+    }
 
-    void Build();
+    [[nodiscard]] SSpriteHandle GetSprite(int Index) const;
 };
 
 struct SRenderer
@@ -488,17 +792,37 @@ struct SRenderer
     SAtlas Atlases[3];
 
     SUniformBlock GlobalsUniformBlock;
+    SInstanceBuffer InstanceBuffer;
+    SInstanceBuffer LevelInstanceBuffer;
+    SLevelTileBuffer LevelTiles;
+
+    SMapUniformBlocks MapUniformBlocks;
 
     SProgramHUD ProgramHUD;
-    SProgramMap ProgramMap;
-    SProgramUber2D ProgramUber2D;
-    SProgram3D ProgramUber3D;
+    SProgramPermutations<SProgramMap, MAP_MODE_COUNT> ProgramMap;
+    SProgramPermutations<SProgramUber2D, UBER2D_MODE_COUNT> ProgramUber2D;
+    SProgramPermutations<SProgram3D, UBER3D_MODE_COUNT> ProgramUber3D;
     SProgramPostProcess ProgramPostProcess;
 
     SMainFramebuffer MainFramebuffer;
     SWorldFramebuffer WorldLayersFramebuffer;
     SGeometry Quad2D;
-    SInstancedDrawData<ETileGeometryType::Count> LevelDrawData;
+    SLevelDrawSet LevelDrawSet;
+    SLevelDrawSetCache LevelDrawSetCache;
+    SLevelMesh LevelMesh;
+    /* Draw levels from their baked mesh, only doors are instanced then. */
+    bool bBakeLevels = true;
+    /* Find the visible tiles with STilemap::FindVisibleTiles() on every step instead of looking up the visible sets
+     * precomputed on load. Draw sets with a door being opened always do. */
+    bool bPortalCulling = false;
+    /* Submit level instances front to back and skip back facing walls, overdraw is expensive on software
+     * rasterizers. */
+    bool bDepthOrderLevels = true;
+    /* Look level draw sets up in LevelDrawSetCache and prefetch the next ones. */
+    bool bCacheDrawSets = true;
+    /* Expand the level geometry around the POV from LevelTiles in Uber3D.vert instead of building draw sets. Only
+     * the door being animated is still instanced. */
+    bool bPullLevels = false;
 
     void Init(int Width, int Height);
 
@@ -506,6 +830,10 @@ struct SRenderer
 
     void SetupTileset(const STileset* TileSet);
 
+    /* Bakes the static geometry of a freshly loaded level with the current tileset, does nothing unless
+     * bBakeLevels is set. */
+    void BakeLevel(const SWorldLevel* Level);
+
     /* Map */
     void SetMapIcons(const std::array<SSpriteHandle, MAP_ICON_COUNT>& SpriteHandles) const;
     void UploadMapData(const SWorldLevel* Level, const SCoordsAndDirection& POV) const;
@@ -514,6 +842,9 @@ struct SRenderer
 
     void SetTime(float Time) const;
 
+    /* Writes the transforms of every queued 3D entry into the instance buffer. */
+    void UploadInstances();
+
     void Flush(const SPlatformState& WindowData);
 
 #pragma region Queue_2D_API
@@ -555,7 +886,17 @@ struct SRenderer
 
     void Draw3DLevel(SWorldLevel* Level, const SVec2Int& POVOrigin, const SDirection& POVDirection);
 
-    void Draw3DLevelDoor(SInstancedDrawCall& DoorDrawCall, const SVec2Int& TileCoords, SDirection Direction, float AnimationAlpha = 0.0f) const;
+    /* Builds the level draw set seen from a POV. Reads the level's tiles, wall joints and visible sets, the door
+     * settings of Tileset and its other arguments, but no renderer state, so it can run on a job worker. OpenDoor is
+     * the door being animated, if any. */
+    void BuildLevelDrawSet(const SWorldLevel* Level, const STileset& Tileset, const SVec2Int& POVOrigin, SDirection POVDirection,
+        const SDrawDoorInfo* OpenDoor, const SLevelDrawSetOptions& Options, SLevelDrawSet& DrawSet) const;
+
+    /* Queues builds of the draw sets for every POV one move away that aren't cached yet. */
+    void PrefetchLevelDrawSets(const SWorldLevel* Level, const SVec2Int& POVOrigin, SDirection POVDirection, const SLevelDrawSetOptions& Options);
+
+    void Draw3DLevelDoor(const STileset& Tileset, SInstancedDrawCall& DoorDrawCall, const SVec2Int& TileCoords, SDirection Direction,
+        float AnimationAlpha = 0.0f) const;
 
 #pragma endregion
 };
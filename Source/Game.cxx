@@ -7,42 +7,40 @@
 #include "Constants.hxx"
 #include "Log.hxx"
 #include "Math.hxx"
+#include "Memory.hxx"
 #include "Player.hxx"
 #include "SharedConstants.hxx"
 #include "AssetTools.hxx"
 #include "Audio.hxx"
 #include "Draw.hxx"
+#include "Jobs.hxx"
 #include "Serialization.hxx"
+#include "Atlas/Common.hxx"
+#include "Atlas/Primary2D.hxx"
+#include "Atlas/Primary3D.hxx"
 
 namespace Asset::Common
 {
-    EXTERN_ASSET(FramePNG)
-    EXTERN_ASSET(RefPNG)
-    EXTERN_ASSET(AngelPNG)
-    EXTERN_ASSET(NoisePNG)
-    EXTERN_ASSET(QuadOBJ)
-    EXTERN_ASSET(PillarOBJ)
+    EXTERN_ASSET(QuadMesh)
+    EXTERN_ASSET(PillarMesh)
     EXTERN_ASSET(DoorCreekWAV)
 }
 
-namespace Asset::HUD
+namespace Asset::Atlas
 {
-    /* Map Icons */
-    EXTERN_ASSET(MapIconPlayer)
-    EXTERN_ASSET(MapIconA)
-    EXTERN_ASSET(MapIconB)
-    EXTERN_ASSET(MapIconHole)
+    EXTERN_ASSET(Common)
+    EXTERN_ASSET(Primary2D)
+    EXTERN_ASSET(Primary3D)
 }
 
 namespace Asset::Tileset::Hotel
 {
-    EXTERN_ASSET(FloorOBJ)
-    EXTERN_ASSET(HoleOBJ)
-    EXTERN_ASSET(WallOBJ)
-    EXTERN_ASSET(WallJointOBJ)
-    EXTERN_ASSET(DoorFrameOBJ)
-    EXTERN_ASSET(DoorOBJ)
-    EXTERN_ASSET(AtlasPNG)
+    EXTERN_ASSET(FloorMesh)
+    EXTERN_ASSET(HoleMesh)
+    EXTERN_ASSET(WallMesh)
+    EXTERN_ASSET(WallJointMesh)
+    EXTERN_ASSET(DoorFrameMesh)
+    EXTERN_ASSET(DoorMesh)
 }
 
 namespace Asset::Map
@@ -63,8 +61,13 @@ static const SRectInt WorldRect{ Constants::ReferenceWidth - 128, MapRectMin.Min
 SGame::SGame()
     : MapRect(MapRectMin)
 {
+    Jobs::Init();
     Platform.Init();
-    Audio.Init();
+
+    /* Sound clips are converted on the workers while the main thread sets up GL. */
+    Jobs::SCounter LoadCounter;
+    Audio.Init(LoadCounter);
+    Audio.QueueLoadSoundClip(Asset::Common::DoorCreekWAV, DoorCreek, LoadCounter);
 
 #ifdef EQUINOX_REACH_DEVELOPMENT
     DevTools.Init(this);
@@ -73,41 +76,37 @@ SGame::SGame()
     Renderer.Init(Platform.Width, Platform.Height);
 
     auto& CommonAtlas = Renderer.Atlases[ATLAS_COMMON];
-    NoiseSprite = CommonAtlas.AddSprite(
-        Asset::Common::NoisePNG);
-    RefSprite = CommonAtlas.AddSprite(
-        Asset::Common::RefPNG);
-    MapIcons[MAP_ICON_PLAYER] = CommonAtlas.AddSprite(Asset::HUD::MapIconPlayer);
-    MapIcons[MAP_ICON_A] = CommonAtlas.AddSprite(Asset::HUD::MapIconA);
-    MapIcons[MAP_ICON_B] = CommonAtlas.AddSprite(Asset::HUD::MapIconB);
-    MapIcons[MAP_ICON_HOLE] = CommonAtlas.AddSprite(Asset::HUD::MapIconHole);
-    CommonAtlas.Build();
-
+    CommonAtlas.Upload(Asset::Atlas::Common, CookedAtlas::Common::Sprites);
+    NoiseSprite = CommonAtlas.GetSprite(CookedAtlas::Common::Noise);
+    RefSprite = CommonAtlas.GetSprite(CookedAtlas::Common::Ref);
+    MapIcons[MAP_ICON_PLAYER] = CommonAtlas.GetSprite(CookedAtlas::Common::Player);
+    MapIcons[MAP_ICON_A] = CommonAtlas.GetSprite(CookedAtlas::Common::IconA);
+    MapIcons[MAP_ICON_B] = CommonAtlas.GetSprite(CookedAtlas::Common::IconB);
+    MapIcons[MAP_ICON_HOLE] = CommonAtlas.GetSprite(CookedAtlas::Common::Hole);
     Renderer.SetMapIcons(MapIcons);
 
     auto& PrimaryAtlas2D = Renderer.Atlases[ATLAS_PRIMARY2D];
-    AngelSprite = PrimaryAtlas2D.AddSprite(
-        Asset::Common::AngelPNG);
-    FrameSprite = PrimaryAtlas2D.AddSprite(
-        Asset::Common::FramePNG);
-    PrimaryAtlas2D.Build();
+    PrimaryAtlas2D.Upload(Asset::Atlas::Primary2D, CookedAtlas::Primary2D::Sprites);
+    AngelSprite = PrimaryAtlas2D.GetSprite(CookedAtlas::Primary2D::Angel);
+    FrameSprite = PrimaryAtlas2D.GetSprite(CookedAtlas::Primary2D::Frame);
 
     auto& PrimaryAtlas3D = Renderer.Atlases[ATLAS_PRIMARY3D];
-    PrimaryAtlas3D.AddSprite(
-        Asset::Tileset::Hotel::AtlasPNG);
-    PrimaryAtlas3D.Build();
+    PrimaryAtlas3D.Upload(Asset::Atlas::Primary3D, CookedAtlas::Primary3D::Sprites);
 
     Tileset.InitBasic(
-        Asset::Tileset::Hotel::FloorOBJ,
-        Asset::Tileset::Hotel::HoleOBJ,
-        Asset::Tileset::Hotel::WallOBJ,
-        Asset::Tileset::Hotel::WallJointOBJ,
-        Asset::Tileset::Hotel::DoorFrameOBJ,
-        Asset::Tileset::Hotel::DoorOBJ);
+        Asset::Tileset::Hotel::FloorMesh,
+        Asset::Tileset::Hotel::HoleMesh,
+        Asset::Tileset::Hotel::WallMesh,
+        Asset::Tileset::Hotel::WallJointMesh,
+        Asset::Tileset::Hotel::DoorFrameMesh,
+        Asset::Tileset::Hotel::DoorMesh);
     Tileset.DoorAnimationType = EDoorAnimationType::TwoDoors;
     Tileset.DoorOffset = 0.22f;
     Renderer.SetupTileset(&Tileset);
 
+    Jobs::Wait(LoadCounter);
+    Audio.FinishLoading();
+
     Camera.RegenerateProjection();
 
     // Level = SLevel{
@@ -171,8 +170,6 @@ SGame::SGame()
     PlayerParty.AddCharacter({ "Juggernaut", 30.0f, 50.0f, 10, 1 });
     PlayerParty.AddCharacter({ "Vulture", 45.0f, 50.0f, 10, 2, false });
     PlayerParty.AddCharacter({ "Mortar", 30.0f, 30.0f, 10, 2, true });
-
-    Audio.LoadSoundClip(Asset::Common::DoorCreekWAV, DoorCreek);
 }
 
 EKeyState SGame::UpdateKeyState(EKeyState OldKeyState, const bool* KeyboardState, const uint8_t Scancode)
@@ -330,6 +327,8 @@ void SGame::Run()
 #endif
 
         Platform.SwapBuffers();
+
+        Memory::NextFrame();
     }
 
 #ifdef EQUINOX_REACH_DEVELOPMENT
@@ -341,6 +340,7 @@ void SGame::Run()
     Tileset.Cleanup();
     Audio.Cleanup();
     Platform.Cleanup();
+    Jobs::Cleanup();
 }
 
 void SGame::UpdateInputState()
@@ -365,6 +365,8 @@ void SGame::UpdateInputState()
 
 void SGame::HandleBlobMovement()
 {
+    Memory::SAllocationGuard AllocationGuard{ "SGame::HandleBlobMovement" };
+
     Blob.Update(Platform.DeltaTime);
 
     const auto bBlobWasIdle = !Blob.IsMoving();
@@ -632,19 +634,26 @@ void SGame::OnBlobMoved()
 
 void SGame::ChangeLevel()
 {
+    /* Prefetch jobs may still be reading the level, it has to stay untouched until they're done. The overloads
+     * below do the same before they overwrite it. */
+    Renderer.LevelDrawSetCache.Invalidate();
     World.GetLevel()->PostProcess();
+    Renderer.BakeLevel(World.GetLevel());
+    Renderer.LevelTiles.Upload(World.GetLevel());
     OnBlobMoved();
     Renderer.UploadMapData(World.GetLevel(), Blob.UnreliableCoordsAndDirection());
 }
 
 void SGame::ChangeLevel(const SWorldLevel& NewLevel)
 {
+    Renderer.LevelDrawSetCache.Invalidate();
     *World.GetLevel() = NewLevel;
     ChangeLevel();
 }
 
 void SGame::ChangeLevel(const SAsset& LevelAsset)
 {
+    Renderer.LevelDrawSetCache.Invalidate();
     Serialization::MemoryStream LevelStream(LevelAsset.SignedCharPtr(), LevelAsset.Length);
     World.GetLevel()->Deserialize(LevelStream);
     ChangeLevel();
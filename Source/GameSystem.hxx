@@ -1,7 +1,7 @@
 #pragma once
 
 #include <array>
-#include <variant>
+#include "HandlePool.hxx"
 
 constexpr int PARTY_COLS = 3;
 constexpr int PARTY_ROWS = 2;
@@ -26,60 +26,57 @@ struct SPlayerChar : SBaseChar
 {
 };
 
+/* Characters bigger than one slot occupy a secondary slot that refers to the same character. */
 struct SPartySlot
 {
 private:
-    std::variant<std::monostate, SBaseChar, SBaseChar*> Slot;
+    SHandle<SBaseChar> Char;
+    bool bSecondary{};
 
 public:
     [[nodiscard]] bool IsEmpty() const
     {
-        return std::holds_alternative<std::monostate>(Slot);
+        return !Char.IsValid();
     }
 
     [[nodiscard]] bool IsRealChar() const
     {
-        return std::holds_alternative<SBaseChar>(Slot);
+        return Char.IsValid() && !bSecondary;
     }
 
     [[nodiscard]] bool IsSecondaryChar() const
     {
-        return std::holds_alternative<SBaseChar*>(Slot);
+        return Char.IsValid() && bSecondary;
     }
 
     void SetEmpty()
     {
-        Slot = std::monostate();
+        Char = {};
+        bSecondary = false;
     }
 
-    void SetRealChar(const SBaseChar& Char)
+    void SetRealChar(SHandle<SBaseChar> InChar)
     {
-        Slot = Char;
+        Char = InChar;
+        bSecondary = false;
     }
 
-    void SetSecondaryChar(SBaseChar* Char)
+    void SetSecondaryChar(SHandle<SBaseChar> InChar)
     {
-        Slot = Char;
+        Char = InChar;
+        bSecondary = true;
     }
 
-    SBaseChar& GetRealChar()
+    [[nodiscard]] SHandle<SBaseChar> GetChar() const
     {
-        return std::get<SBaseChar>(Slot);
-    }
-
-    SBaseChar* GetSecondaryChar()
-    {
-        return std::get<SBaseChar*>(Slot);
-    }
-
-    SBaseChar* GetRealCharPtr()
-    {
-        return &std::get<SBaseChar>(Slot);
+        return Char;
     }
 };
 
 struct SParty
 {
+    /* Slots refer to characters by handle, so a copied party stays self-contained. */
+    SHandlePool<SBaseChar, PARTY_SIZE> Characters;
     std::array<SPartySlot, PARTY_SIZE> Slots{};
 
     bool AddCharacter(const SBaseChar& Char)
@@ -93,7 +90,7 @@ struct SParty
             }
             if (Char.Size == 1)
             {
-                Slots[I].SetRealChar(Char);
+                Slots[I].SetRealChar(Characters.Create(Char));
                 return true;
             }
             if (Char.Size == 2)
@@ -102,8 +99,9 @@ struct SParty
                 bool bNextSlotIsFree = NextSlotIndex < PARTY_SIZE && Slots[NextSlotIndex].IsEmpty();
                 if (bNextSlotIsFree)
                 {
-                    Slots[I].SetRealChar(Char);
-                    Slots[NextSlotIndex].SetSecondaryChar(Slots[I].GetRealCharPtr());
+                    auto Handle = Characters.Create(Char);
+                    Slots[I].SetRealChar(Handle);
+                    Slots[NextSlotIndex].SetSecondaryChar(Handle);
                     return true;
                 }
             }
@@ -111,16 +109,13 @@ struct SParty
         return false;
     }
 
+    [[nodiscard]] SBaseChar* GetChar(const SPartySlot& Slot)
+    {
+        return Characters.Get(Slot.GetChar());
+    }
+
     [[nodiscard]] int GetPartyCount() const
     {
-        auto Count = 0;
-        for (const auto& Slot : Slots)
-        {
-            if (Slot.IsRealChar())
-            {
-                Count++;
-            }
-        }
-        return Count;
+        return static_cast<int>(Characters.Size());
     }
 };
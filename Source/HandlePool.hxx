@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+/* 32-bit reference into an SHandlePool: low 16 bits are the slot, high 16 bits its generation.
+ * Generations start at 1, so a zero handle is never valid. */
+template <typename T>
+struct SHandle
+{
+    static constexpr uint32_t IndexBits = 16;
+    static constexpr uint32_t IndexMask = (1u << IndexBits) - 1;
+
+    uint32_t Value{};
+
+    constexpr SHandle() = default;
+
+    constexpr SHandle(uint32_t Index, uint32_t Generation)
+        : Value((Generation << IndexBits) | Index)
+    {
+    }
+
+    [[nodiscard]] constexpr uint32_t Index() const { return Value & IndexMask; }
+    [[nodiscard]] constexpr uint32_t Generation() const { return Value >> IndexBits; }
+    [[nodiscard]] constexpr bool IsValid() const { return Value != 0; }
+
+    constexpr bool operator==(const SHandle& Other) const { return Value == Other.Value; }
+    constexpr bool operator!=(const SHandle& Other) const { return Value != Other.Value; }
+};
+
+/* Fixed capacity pool of game objects addressed by generational handles.
+ * Objects are kept densely packed for iteration; destroying one moves the last object into its place.
+ * Handles stay valid when the pool is copied, stale ones are detected by their generation. */
+template <typename T, std::size_t Capacity>
+struct SHandlePool
+{
+    static_assert(Capacity > 0 && Capacity <= SHandle<T>::IndexMask, "Slot index has to fit into the handle");
+
+private:
+    struct SSlot
+    {
+        uint16_t DenseIndex{};
+        uint16_t Generation = 1;
+        uint16_t NextFree{};
+    };
+
+    std::array<T, Capacity> Objects{};
+    std::array<uint16_t, Capacity> DenseToSlot{};
+    std::array<SSlot, Capacity> Slots{};
+    uint32_t Count{};
+    uint32_t FirstFree{};
+
+    [[nodiscard]] const SSlot* GetSlot(SHandle<T> Handle) const
+    {
+        if (Handle.Index() >= Capacity)
+        {
+            return nullptr;
+        }
+        const auto& Slot = Slots[Handle.Index()];
+        return Slot.Generation == Handle.Generation() && Slot.DenseIndex < Count && DenseToSlot[Slot.DenseIndex] == Handle.Index() ? &Slot : nullptr;
+    }
+
+public:
+    SHandlePool()
+    {
+        for (std::size_t Index = 0; Index < Capacity; ++Index)
+        {
+            Slots[Index].NextFree = static_cast<uint16_t>(Index + 1);
+        }
+    }
+
+    /* Returns an invalid handle when the pool is full. */
+    SHandle<T> Create(T Object = {})
+    {
+        if (Count >= Capacity)
+        {
+            return {};
+        }
+
+        auto SlotIndex = FirstFree;
+        auto& Slot = Slots[SlotIndex];
+        FirstFree = Slot.NextFree;
+
+        Slot.DenseIndex = static_cast<uint16_t>(Count);
+        DenseToSlot[Count] = static_cast<uint16_t>(SlotIndex);
+        Objects[Count] = std::move(Object);
+        Count++;
+
+        return { SlotIndex, Slot.Generation };
+    }
+
+    bool Destroy(SHandle<T> Handle)
+    {
+        if (GetSlot(Handle) == nullptr)
+        {
+            return false;
+        }
+
+        auto& Slot = Slots[Handle.Index()];
+        uint32_t Last = Count - 1;
+        if (Slot.DenseIndex != Last)
+        {
+            Objects[Slot.DenseIndex] = std::move(Objects[Last]);
+            DenseToSlot[Slot.DenseIndex] = DenseToSlot[Last];
+            Slots[DenseToSlot[Last]].DenseIndex = Slot.DenseIndex;
+        }
+        Objects[Last] = {};
+        Count--;
+
+        /* Generation 0 is skipped on wrap-around so zero handles stay invalid. */
+        Slot.Generation = Slot.Generation == UINT16_MAX ? 1 : Slot.Generation + 1;
+        Slot.NextFree = static_cast<uint16_t>(FirstFree);
+        FirstFree = Handle.Index();
+
+        return true;
+    }
+
+    void Clear()
+    {
+        while (Count > 0)
+        {
+            Destroy(GetHandle(Count - 1));
+        }
+    }
+
+    [[nodiscard]] bool IsAlive(SHandle<T> Handle) const
+    {
+        return GetSlot(Handle) != nullptr;
+    }
+
+    /* Returns nullptr for stale handles. Pointers are only valid until the next Create or Destroy. */
+    [[nodiscard]] T* Get(SHandle<T> Handle)
+    {
+        auto Slot = GetSlot(Handle);
+        return Slot != nullptr ? &Objects[Slot->DenseIndex] : nullptr;
+    }
+
+    [[nodiscard]] const T* Get(SHandle<T> Handle) const
+    {
+        auto Slot = GetSlot(Handle);
+        return Slot != nullptr ? &Objects[Slot->DenseIndex] : nullptr;
+    }
+
+    /* Handle of the object at the given position of the dense array. */
+    [[nodiscard]] SHandle<T> GetHandle(uint32_t DenseIndex) const
+    {
+        auto SlotIndex = DenseToSlot[DenseIndex];
+        return { SlotIndex, Slots[SlotIndex].Generation };
+    }
+
+    [[nodiscard]] uint32_t Size() const { return Count; }
+    [[nodiscard]] bool IsFull() const { return Count >= Capacity; }
+
+    T* begin() { return Objects.data(); }
+    T* end() { return Objects.data() + Count; }
+    const T* begin() const { return Objects.data(); }
+    const T* end() const { return Objects.data() + Count; }
+};
@@ -0,0 +1,145 @@
+#include "Jobs.hxx"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "Log.hxx"
+
+namespace Jobs
+{
+    struct SJob
+    {
+        FJob Function{};
+        void* Data{};
+        SCounter* Counter{};
+    };
+
+    struct SJobQueue
+    {
+        std::mutex Mutex;
+        /* Signalled when a job is queued or the pool shuts down. */
+        std::condition_variable JobQueued;
+        /* Signalled when a counter drops to zero. */
+        std::condition_variable CounterDone;
+        std::array<SJob, QueueCapacity> Jobs{};
+        std::size_t Head{};
+        std::size_t Count{};
+        bool bShutdown{};
+
+        std::array<std::thread, MaxWorkerCount> Workers;
+        int WorkerCount{};
+
+        /* Expects Mutex to be locked and the queue not to be empty. */
+        SJob Pop()
+        {
+            auto Job = Jobs[Head];
+            Head = (Head + 1) % QueueCapacity;
+            Count--;
+            return Job;
+        }
+    };
+
+    static SJobQueue Queue;
+
+    static void Execute(const SJob& Job)
+    {
+        Job.Function(Job.Data);
+        if (Job.Counter->Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard Lock(Queue.Mutex);
+            Queue.CounterDone.notify_all();
+        }
+    }
+
+    static void WorkerMain()
+    {
+        while (true)
+        {
+            SJob Job;
+            {
+                std::unique_lock Lock(Queue.Mutex);
+                Queue.JobQueued.wait(Lock, [] { return Queue.Count > 0 || Queue.bShutdown; });
+                if (Queue.Count == 0)
+                {
+                    return;
+                }
+                Job = Queue.Pop();
+            }
+            Execute(Job);
+        }
+    }
+
+    void Init(int WorkerCount)
+    {
+        if (WorkerCount <= 0)
+        {
+            WorkerCount = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+        }
+        WorkerCount = std::clamp(WorkerCount, 0, MaxWorkerCount);
+
+        Queue.bShutdown = false;
+        for (Queue.WorkerCount = 0; Queue.WorkerCount < WorkerCount; ++Queue.WorkerCount)
+        {
+            Queue.Workers[Queue.WorkerCount] = std::thread(WorkerMain);
+        }
+
+        Log::Jobs<ELogLevel::Info>("Started %d worker threads", Queue.WorkerCount);
+    }
+
+    void Cleanup()
+    {
+        {
+            std::lock_guard Lock(Queue.Mutex);
+            Queue.bShutdown = true;
+        }
+        Queue.JobQueued.notify_all();
+
+        for (int Index = 0; Index < Queue.WorkerCount; ++Index)
+        {
+            Queue.Workers[Index].join();
+        }
+        Queue.WorkerCount = 0;
+    }
+
+    int GetWorkerCount()
+    {
+        return Queue.WorkerCount;
+    }
+
+    void Run(SCounter& Counter, FJob Job, void* Data)
+    {
+        Counter.Pending.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard Lock(Queue.Mutex);
+            if (Queue.WorkerCount > 0 && Queue.Count < QueueCapacity)
+            {
+                Queue.Jobs[(Queue.Head + Queue.Count) % QueueCapacity] = { Job, Data, &Counter };
+                Queue.Count++;
+                Queue.JobQueued.notify_one();
+                return;
+            }
+        }
+
+        Execute({ Job, Data, &Counter });
+    }
+
+    void Wait(SCounter& Counter)
+    {
+        std::unique_lock Lock(Queue.Mutex);
+        while (Counter.Pending.load(std::memory_order_acquire) > 0)
+        {
+            if (Queue.Count > 0)
+            {
+                auto Job = Queue.Pop();
+                Lock.unlock();
+                Execute(Job);
+                Lock.lock();
+                continue;
+            }
+            Queue.CounterDone.wait(Lock);
+        }
+    }
+}
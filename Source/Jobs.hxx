@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/* Small worker pool for startup work such as asset decoding.
+ * Jobs are plain function pointers with user data, queuing never allocates. */
+namespace Jobs
+{
+    static constexpr int MaxWorkerCount = 15;
+    static constexpr std::size_t QueueCapacity = 256;
+
+    using FJob = void (*)(void* Data);
+
+    /* Number of unfinished jobs in a group, wait on it to join them. */
+    struct SCounter
+    {
+        std::atomic<int> Pending{};
+    };
+
+    /* Starts WorkerCount threads, 0 picks one less than the number of hardware threads. */
+    void Init(int WorkerCount = 0);
+    void Cleanup();
+
+    [[nodiscard]] int GetWorkerCount();
+
+    /* Data has to stay valid until the job has run. Runs the job right away when there are no workers
+     * or the queue is full. */
+    void Run(SCounter& Counter, FJob Job, void* Data);
+
+    /* Runs queued jobs on the calling thread until Counter drops to zero. */
+    void Wait(SCounter& Counter);
+}
@@ -59,6 +59,8 @@ namespace Log
     LOG_CATEGORY(Platform)
     LOG_CATEGORY(Draw)
     LOG_CATEGORY(Game)
+    LOG_CATEGORY(Jobs)
+    LOG_CATEGORY(AssetPack)
 #ifdef EQUINOX_REACH_DEVELOPMENT
     LOG_CATEGORY(DevTools)
 #endif
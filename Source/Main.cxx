@@ -1,7 +1,21 @@
 #include <SDL3/SDL_main.h>
+#include <cstdlib>
 #include "Memory.hxx"
 #include "Game.hxx"
 
+#ifdef EQUINOX_REACH_ASSET_PACK
+    #include <filesystem>
+    #include "AssetPack.hxx"
+#endif
+
+/* Heap sizes can be overridden in megabytes, e.g. EQUINOX_REACH_HEAP_SIZE=64. */
+static std::size_t GetHeapSizeFromEnvironment(const char* Name, std::size_t Default)
+{
+    const char* Value = std::getenv(Name);
+    std::size_t Megabytes = Value != nullptr ? std::strtoull(Value, nullptr, 10) : 0;
+    return Megabytes != 0 ? Megabytes * 1024 * 1024 : Default;
+}
+
 void EquinoxReach()
 {
     auto Game = Memory::MakeShared<SGame>();
@@ -14,7 +28,30 @@ extern "C"
     int
     main(int argc, char* argv[])
 {
+    Memory::Init(GetHeapSizeFromEnvironment("EQUINOX_REACH_HEAP_SIZE", DefaultHeapSize),
+        GetHeapSizeFromEnvironment("EQUINOX_REACH_HEAP_GROWTH", DefaultHeapGrowthStep));
+
+    if (const char* TracePath = std::getenv("EQUINOX_REACH_MEMORY_TRACE"))
+    {
+        Memory::StartTrace(TracePath);
+    }
+
+#ifdef EQUINOX_REACH_ASSET_PACK
+    /* The pack sits next to the executable, EQUINOX_REACH_ASSET_PACK is its file name. */
+    auto PackPath = std::filesystem::path(argc > 0 ? argv[0] : "").parent_path() / EQUINOX_REACH_ASSET_PACK;
+    if (!AssetPack::Mount(PackPath.string().c_str()))
+    {
+        return 1;
+    }
+#endif
+
     EquinoxReach();
 
+#ifdef EQUINOX_REACH_ASSET_PACK
+    AssetPack::Unmount();
+#endif
+
+    Memory::StopTrace();
+
     return 0;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <type_traits>
 
@@ -530,4 +532,43 @@ namespace Math
         const auto Step = DeltaTime * InterpSpeed;
         return Current + std::clamp((Target - Current), -Step, Step);
     }
+
+    /* IEEE 754 binary16, rounded to nearest even. Overflows become infinity, NaN stays NaN. */
+    inline uint16_t FloatToHalf(float Value)
+    {
+        uint32_t Bits;
+        std::memcpy(&Bits, &Value, sizeof(Bits));
+
+        auto Sign = static_cast<uint16_t>((Bits >> 16) & 0x8000);
+        uint32_t Magnitude = Bits & 0x7FFFFFFF;
+
+        if (Magnitude >= 0x7F800000)
+        {
+            return Sign | 0x7C00 | (Magnitude > 0x7F800000 ? 0x200 : 0);
+        }
+        if (Magnitude >= 0x477FF000)
+        {
+            return Sign | 0x7C00;
+        }
+        if (Magnitude < 0x38800000)
+        {
+            /* Subnormal, shift the mantissa with its implicit bit into place and round. */
+            if (Magnitude < 0x33000000)
+            {
+                return Sign;
+            }
+            uint32_t Exponent = Magnitude >> 23;
+            uint32_t Mantissa = (Magnitude & 0x7FFFFF) | 0x800000;
+            uint32_t Shift = 126 - Exponent;
+            uint32_t Half = Mantissa >> Shift;
+            uint32_t Remainder = Mantissa & ((1u << Shift) - 1);
+            uint32_t Midpoint = 1u << (Shift - 1);
+            Half += (Remainder > Midpoint || (Remainder == Midpoint && (Half & 1))) ? 1 : 0;
+            return Sign | static_cast<uint16_t>(Half);
+        }
+
+        /* Rebias the exponent from 127 to 15, rounding may carry into the exponent, which is still correct. */
+        uint32_t Rounded = Magnitude + 0xFFF + ((Magnitude >> 13) & 1);
+        return Sign | static_cast<uint16_t>((Rounded - 0x38000000) >> 13);
+    }
 }
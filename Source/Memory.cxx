@@ -3,272 +3,1054 @@
 #include "Log.hxx"
 #include "Utility.hxx"
 
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <utility>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+static inline std::size_t FindLastSet(std::size_t Value)
+{
+    return (sizeof(unsigned long long) * 8 - 1) - __builtin_clzll(Value);
+}
+
+static inline std::size_t FindFirstSet(uint32_t Value)
+{
+    return __builtin_ctz(Value);
+}
+
+/* Opt-in recorder behind Memory::StartTrace. Events are buffered with the default allocator,
+ * so recording never recurses into the inline resource. */
+struct SAllocationTrace
+{
+    static constexpr std::size_t FlushEventCount = 1 << 16;
+
+    std::atomic<bool> bRecording{};
+    std::mutex Mutex;
+    std::FILE* File{};
+    std::vector<SAllocationTraceEvent> Events;
+    std::chrono::steady_clock::time_point StartTime;
+    std::size_t EventCount{};
+
+    ~SAllocationTrace()
+    {
+        Stop();
+    }
+
+    bool Start(const char* Path)
+    {
+        std::unique_lock Lock{ Mutex };
+        if (File != nullptr)
+        {
+            return false;
+        }
+
+        File = std::fopen(Path, "wb");
+        if (File == nullptr)
+        {
+            Log::Memory<ELogLevel::Critical>("Failed to open allocation trace %s", Path);
+            return false;
+        }
+
+        SAllocationTraceHeader Header{};
+        std::fwrite(&Header, sizeof(Header), 1, File);
+
+        Events.reserve(FlushEventCount);
+        StartTime = std::chrono::steady_clock::now();
+        EventCount = 0;
+        bRecording.store(true, std::memory_order_relaxed);
+
+        Log::Memory<ELogLevel::Info>("Recording allocation trace to %s", Path);
+
+        return true;
+    }
+
+    void Stop()
+    {
+        std::unique_lock Lock{ Mutex };
+        if (File == nullptr)
+        {
+            return;
+        }
+
+        bRecording.store(false, std::memory_order_relaxed);
+        Flush();
+        std::fclose(File);
+        File = nullptr;
+
+        Log::Memory<ELogLevel::Info>("Stopped allocation trace, %zu events recorded", EventCount);
+    }
+
+    void Flush()
+    {
+        std::fwrite(Events.data(), sizeof(SAllocationTraceEvent), Events.size(), File);
+        Events.clear();
+    }
+
+    inline void Record(EAllocationEvent Type, const void* Ptr, const void* OldPtr, std::size_t Size, std::size_t Alignment, EMemoryCategory Category)
+    {
+        if (!bRecording.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        std::unique_lock Lock{ Mutex };
+        if (File == nullptr)
+        {
+            return;
+        }
+
+        SAllocationTraceEvent Event{};
+        Event.Timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - StartTime).count();
+        Event.Ptr = reinterpret_cast<uint64_t>(Ptr);
+        Event.OldPtr = reinterpret_cast<uint64_t>(OldPtr);
+        Event.Size = static_cast<uint32_t>(Size);
+        Event.Type = Type;
+        Event.Category = Category;
+        Event.AlignmentLog2 = static_cast<uint8_t>(__builtin_ctzll(Alignment));
+        Events.push_back(Event);
+        EventCount++;
+
+        if (Events.size() >= FlushEventCount)
+        {
+            Flush();
+        }
+    }
+};
+
+/* Defined before the resources, so it outlives them during exit. */
+static SAllocationTrace AllocationTrace;
+
+/* Tag of the innermost Memory::SAllocationGuard on this thread. */
+static thread_local const char* AllocationGuardTag{};
+
+struct SAllocationGuardReport
+{
+    std::mutex Mutex;
+    std::array<Memory::SAllocationGuardViolation, Memory::MaxAllocationGuardViolations> Violations{};
+#ifdef EQUINOX_REACH_DEVELOPMENT
+    std::atomic<bool> bTrap{};
+#endif
+
+    void Report(const char* Tag, std::size_t Bytes)
+    {
+        {
+            std::unique_lock Lock{ Mutex };
+            for (auto& Violation : Violations)
+            {
+                if (Violation.Tag == nullptr)
+                {
+                    Violation.Tag = Tag;
+                    Log::Memory<ELogLevel::Critical>("Allocating %zu bytes inside allocation guard %s", Bytes, Tag);
+                }
+                if (Violation.Tag == Tag || std::strcmp(Violation.Tag, Tag) == 0)
+                {
+                    Violation.Count++;
+                    Violation.LastBytes = Bytes;
+                    break;
+                }
+            }
+        }
+
+#ifdef EQUINOX_REACH_DEVELOPMENT
+        if (bTrap.load(std::memory_order_relaxed))
+        {
+    #ifdef _WIN32
+            DebugBreak();
+    #else
+            std::raise(SIGTRAP);
+    #endif
+        }
+#endif
+    }
+};
+
+static SAllocationGuardReport AllocationGuardReport;
+
+static inline void CheckAllocationGuard(std::size_t Bytes)
+{
+    if (AllocationGuardTag != nullptr)
+    {
+        AllocationGuardReport.Report(AllocationGuardTag, Bytes);
+    }
+}
+
+/* Pool resource that reports its allocations to the guard, even the ones served from its own free lists. */
+class CGuardedPoolResource final : public std::pmr::synchronized_pool_resource
+{
+public:
+    using std::pmr::synchronized_pool_resource::synchronized_pool_resource;
+
+protected:
+    void* do_allocate(size_t Bytes, size_t Alignment) override
+    {
+        CheckAllocationGuard(Bytes);
+
+        /* Refills from the upstream resource were already reported above. */
+        auto Tag = std::exchange(AllocationGuardTag, nullptr);
+        void* Ptr = std::pmr::synchronized_pool_resource::do_allocate(Bytes, Alignment);
+        AllocationGuardTag = Tag;
+
+        return Ptr;
+    }
+};
+
+static std::byte* ReserveAddressSpace(std::size_t Size)
+{
+#ifdef _WIN32
+    return static_cast<std::byte*>(VirtualAlloc(nullptr, Size, MEM_RESERVE, PAGE_NOACCESS));
+#else
+    void* Ptr = mmap(nullptr, Size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (Ptr == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    #ifdef MADV_HUGEPAGE
+    /* Set on the reservation, so every chunk committed later is backed by huge pages where possible. */
+    madvise(Ptr, Size, MADV_HUGEPAGE);
+    #endif
+    return static_cast<std::byte*>(Ptr);
+#endif
+}
+
+static bool CommitAddressSpace(std::byte* Ptr, std::size_t Size)
+{
+#ifdef _WIN32
+    if (VirtualAlloc(Ptr, Size, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+    {
+        return false;
+    }
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+    std::size_t PageSize = SystemInfo.dwPageSize;
+#else
+    if (mprotect(Ptr, Size, PROT_READ | PROT_WRITE) != 0)
+    {
+        return false;
+    }
+    #ifdef MADV_POPULATE_WRITE
+    if (madvise(Ptr, Size, MADV_POPULATE_WRITE) == 0)
+    {
+        return true;
+    }
+    #endif
+    std::size_t PageSize = sysconf(_SC_PAGESIZE);
+#endif
+
+    /* Prefault the pages now instead of stalling on first touch mid-game. */
+    for (std::size_t Offset = 0; Offset < Size; Offset += PageSize)
+    {
+        reinterpret_cast<volatile std::byte*>(Ptr)[Offset] = std::byte{};
+    }
+    return true;
+}
+
 CInlineResource::CInlineResource(std::pmr::memory_resource* up)
     : Upstream(up)
 {
-    Log::Memory<ELogLevel::Critical>("Creating inline resource, total size: %zu bytes, data(): %p", HeapSize, Buffer.data());
+    /* Extra room so the base can be aligned to a huge page boundary. */
+    auto Reservation = ReserveAddressSpace(HeapReserveSize + HeapChunkAlignment);
+    if (Reservation == nullptr)
+    {
+        Log::Memory<ELogLevel::Critical>("Failed to reserve %zu bytes of address space, using upstream only", HeapReserveSize);
+        return;
+    }
+
+    Base = static_cast<std::byte*>(AlignPtr(Reservation, HeapChunkAlignment));
+    ReservedSize = HeapReserveSize;
+
+    Log::Memory<ELogLevel::Critical>("Creating inline resource, reserved: %zu bytes, data(): %p", ReservedSize, Base);
 }
 
 CInlineResource::~CInlineResource()
 {
+    /* The mapping is left to the OS, other static objects may still free into it during exit. */
     Log::Memory<ELogLevel::Critical>("Destroying inline resource, NumberOfBlocks: %zu", NumberOfBlocks());
 }
 
-void CInlineResource::DestroyBlock(SAllocationHeader* AllocationHeader)
+void CInlineResource::Init(std::size_t InitialSize, std::size_t InGrowthStep)
 {
-    if (AllocationHeader->PreviousBlock == nullptr)
+    std::unique_lock Lock{ Mutex };
+
+    GrowthStep = InGrowthStep;
+    while (CommittedSize < InitialSize && Grow(InitialSize - CommittedSize))
     {
-        FirstAllocation = AllocationHeader->NextBlock;
+    }
+}
+
+bool CInlineResource::Grow(std::size_t Bytes)
+{
+    /* The block has to be found again by MappingSearch, which rounds up to the next size class. */
+    if (Bytes >= SmallBlockSize)
+    {
+        Bytes += (std::size_t(1) << (FindLastSet(Bytes) - SLIndexCountLog2)) - 1;
+    }
+
+    /* A free block at the end of the heap gets merged with the new chunk, so it only has to make up the difference. */
+    if (CommittedSize != 0)
+    {
+        auto Last = reinterpret_cast<SBlockHeader*>(Base + CommittedSize - SBlockHeader::Overhead)->PreviousPhysical;
+        if (Last != nullptr && Last->IsFree())
+        {
+            Bytes -= std::min(Bytes, Last->GetSize());
+        }
+    }
+
+    /* Room for the new block header and the sentinel. */
+    std::size_t ChunkSize = DoAlign(std::max(Bytes + SBlockHeader::Overhead * 2, GrowthStep), HeapChunkAlignment);
+    if (CommittedSize + ChunkSize > ReservedSize)
+    {
+        return false;
+    }
+
+    auto Chunk = Base + CommittedSize;
+    if (!CommitAddressSpace(Chunk, ChunkSize))
+    {
+        Log::Memory<ELogLevel::Critical>("Failed to commit %zu bytes at %p", ChunkSize, Chunk);
+        return false;
+    }
+
+    SBlockHeader* Block{};
+    if (CommittedSize == 0)
+    {
+        /* One free block spanning the whole chunk, followed by a zero-sized sentinel. */
+        Block = reinterpret_cast<SBlockHeader*>(Chunk);
+        Block->PreviousPhysical = nullptr;
+        Block->Size = ChunkSize - (SBlockHeader::Overhead * 2);
     }
     else
     {
-        AllocationHeader->PreviousBlock->NextBlock = AllocationHeader->NextBlock;
+        /* The old sentinel becomes the header of a free block covering the new chunk. */
+        Block = reinterpret_cast<SBlockHeader*>(Chunk - SBlockHeader::Overhead);
+        Block->Size = ChunkSize - SBlockHeader::Overhead;
+    }
+    Block->SetFree(true);
+
+    auto Sentinel = Block->NextPhysical();
+    Sentinel->PreviousPhysical = Block;
+    Sentinel->Size = 0;
+
+    InsertFreeBlock(MergeWithNeighbors(Block));
+
+    CommittedSize += ChunkSize;
+    GrowthCount++;
+
+    Log::Memory<ELogLevel::Info>("Growing inline resource by %zu bytes, total size: %zu bytes", ChunkSize, CommittedSize);
+
+    return true;
+}
+
+void CInlineResource::MappingInsert(std::size_t Size, std::size_t& FL, std::size_t& SL)
+{
+    if (Size < SmallBlockSize)
+    {
+        FL = 0;
+        SL = Size / (SmallBlockSize / SLIndexCount);
     }
-    if (AllocationHeader->NextBlock != nullptr)
+    else
     {
-        AllocationHeader->NextBlock->PreviousBlock = AllocationHeader->PreviousBlock;
+        FL = FindLastSet(Size);
+        SL = (Size >> (FL - SLIndexCountLog2)) ^ SLIndexCount;
+        FL -= FLIndexShift - 1;
     }
 }
 
-size_t CInlineResource::NumberOfBlocks()
+void CInlineResource::MappingSearch(std::size_t Size, std::size_t& FL, std::size_t& SL)
 {
-    std::unique_lock Lock{ Mutex };
+    /* Round up to the next size class so any block found there is big enough. */
+    if (Size >= SmallBlockSize)
+    {
+        Size += (std::size_t(1) << (FindLastSet(Size) - SLIndexCountLog2)) - 1;
+    }
+    MappingInsert(Size, FL, SL);
+}
 
-    if (FirstAllocation == nullptr)
+CInlineResource::SBlockHeader* CInlineResource::SearchSuitableBlock(std::size_t& FL, std::size_t& SL)
+{
+    if (FL >= FLIndexCount)
     {
-        return 0;
+        return nullptr;
+    }
+
+    uint32_t SLMap = SLBitmaps[FL] & (~0u << SL);
+    if (SLMap == 0)
+    {
+        /* No block in this size class, look for a bigger one. */
+        uint32_t FLMap = FL + 1 < 32 ? FLBitmap & (~0u << (FL + 1)) : 0;
+        if (FLMap == 0)
+        {
+            return nullptr;
+        }
+        FL = FindFirstSet(FLMap);
+        SLMap = SLBitmaps[FL];
     }
+    SL = FindFirstSet(SLMap);
 
-    size_t Num = 0;
+    return FreeBlocks[FL][SL];
+}
+
+void CInlineResource::InsertFreeBlock(SBlockHeader* Block)
+{
+    std::size_t FL{}, SL{};
+    MappingInsert(Block->GetSize(), FL, SL);
 
-    SAllocationHeader* AllocationHeader = FirstAllocation;
-    while (AllocationHeader != nullptr)
+    auto Current = FreeBlocks[FL][SL];
+    Block->NextFree = Current;
+    Block->PreviousFree = nullptr;
+    if (Current != nullptr)
     {
-        Num++;
-        AllocationHeader = AllocationHeader->NextBlock;
+        Current->PreviousFree = Block;
     }
+    FreeBlocks[FL][SL] = Block;
+
+    FLBitmap |= 1u << FL;
+    SLBitmaps[FL] |= 1u << SL;
 
-    return Num;
+    FreeBytes += Block->GetSize();
 }
 
-void* CInlineResource::do_allocate(size_t bytes, size_t alignment)
+void CInlineResource::RemoveFreeBlock(SBlockHeader* Block)
 {
-    std::unique_lock Lock{ Mutex };
-    return AllocateInline(nullptr, bytes, alignment);
+    std::size_t FL{}, SL{};
+    MappingInsert(Block->GetSize(), FL, SL);
+
+    if (Block->NextFree != nullptr)
+    {
+        Block->NextFree->PreviousFree = Block->PreviousFree;
+    }
+    if (Block->PreviousFree != nullptr)
+    {
+        Block->PreviousFree->NextFree = Block->NextFree;
+    }
+
+    FreeBytes -= Block->GetSize();
+
+    if (FreeBlocks[FL][SL] == Block)
+    {
+        FreeBlocks[FL][SL] = Block->NextFree;
+        if (FreeBlocks[FL][SL] == nullptr)
+        {
+            SLBitmaps[FL] &= ~(1u << SL);
+            if (SLBitmaps[FL] == 0)
+            {
+                FLBitmap &= ~(1u << FL);
+            }
+        }
+    }
 }
 
-void CInlineResource::do_deallocate(void* ptr, [[maybe_unused]] size_t bytes, [[maybe_unused]] size_t alignment)
+CInlineResource::SBlockHeader* CInlineResource::SplitBlock(SBlockHeader* Block, std::size_t Size)
 {
-    std::unique_lock Lock{ Mutex };
-    AllocateInline(ptr, 0);
+    /* Remaining part becomes a new block right after the first Size bytes. */
+    auto Remaining = reinterpret_cast<SBlockHeader*>(Block->Data() + Size);
+    std::size_t RemainingSize = Block->GetSize() - (Size + SBlockHeader::Overhead);
+
+    Remaining->PreviousPhysical = Block;
+    Remaining->Size = RemainingSize;
+    Remaining->NextPhysical()->PreviousPhysical = Remaining;
+
+    Block->SetSize(Size);
+
+    return Remaining;
 }
 
-void* CInlineResource::do_reallocate(void* ptr, size_t bytes)
+CInlineResource::SBlockHeader* CInlineResource::AbsorbBlock(SBlockHeader* Previous, SBlockHeader* Block)
 {
-    std::unique_lock Lock{ Mutex };
-    return AllocateInline(ptr, bytes);
+    Previous->SetSize(Previous->GetSize() + Block->GetSize() + SBlockHeader::Overhead);
+    Previous->NextPhysical()->PreviousPhysical = Previous;
+    return Previous;
+}
+
+CInlineResource::SBlockHeader* CInlineResource::MergeWithNeighbors(SBlockHeader* Block)
+{
+    auto Previous = Block->PreviousPhysical;
+    if (Previous != nullptr && Previous->IsFree())
+    {
+        RemoveFreeBlock(Previous);
+        Block = AbsorbBlock(Previous, Block);
+    }
+
+    auto Next = Block->NextPhysical();
+    if (!Next->IsLast() && Next->IsFree())
+    {
+        RemoveFreeBlock(Next);
+        Block = AbsorbBlock(Block, Next);
+    }
+
+    return Block;
 }
 
-void* CInlineResource::AllocateInline(void* SrcPtr, size_t Bytes, const size_t Alignment)
+void CInlineResource::TrimUsedBlock(SBlockHeader* Block, std::size_t Size)
 {
-    std::size_t BytesWithHeader = Bytes + sizeof(SAllocationHeader);
-    std::size_t FinalAllocationSize = BytesWithHeader + (Alignment - 1);
-    std::size_t ReallocBytes{};
-    if (SrcPtr != nullptr)
+    if (Block->GetSize() < Size + sizeof(SBlockHeader))
     {
-        auto BytePtr = static_cast<std::byte*>(SrcPtr);
-        auto AllocationHeader = reinterpret_cast<SAllocationHeader*>(BytePtr) - 1;
+        return;
+    }
 
-        /* Freeing. */
-        if (Bytes == 0)
-        {
-            /* Check if the pointer is within our range. */
-            if (BytePtr < Buffer.data() || BytePtr >= Buffer.data() + Buffer.size())
-            {
-                Log::Memory<ELogLevel::Verbose>("Freeing from upstream at %p", BytePtr);
-                Upstream->deallocate(SrcPtr, Bytes, Alignment);
-                return nullptr;
-            }
+    auto Remaining = SplitBlock(Block, Size);
+    Remaining->SetFree(true);
+    InsertFreeBlock(MergeWithNeighbors(Remaining));
+}
 
-            DestroyBlock(AllocationHeader);
+void* CInlineResource::AllocateBlock(std::size_t Bytes, std::size_t Alignment)
+{
+    std::size_t Size = std::max(DoAlign(Bytes, AlignSize), MinBlockSize);
+    if (Size > MaxBlockSize)
+    {
+        return nullptr;
+    }
 
-            Log::Memory<ELogLevel::Verbose>("Freeing %zu bytes at %p", AllocationHeader->Length, BytePtr);
+    /* Reserve enough room to carve a properly aligned block out of a bigger one. */
+    std::size_t SearchSize = Size;
+    if (Alignment > AlignSize)
+    {
+        SearchSize += Alignment + sizeof(SBlockHeader);
+    }
 
+    std::size_t FL{}, SL{};
+    MappingSearch(SearchSize, FL, SL);
+    auto Block = SearchSuitableBlock(FL, SL);
+    if (Block == nullptr)
+    {
+        if (!Grow(SearchSize))
+        {
             return nullptr;
         }
 
-        /* Reallocating. */
-        if (AllocationHeader->NextBlock != nullptr)
+        MappingSearch(SearchSize, FL, SL);
+        Block = SearchSuitableBlock(FL, SL);
+        if (Block == nullptr)
         {
-            if (BytePtr + BytesWithHeader >= reinterpret_cast<std::byte*>(AllocationHeader->NextBlock) || !IsAlignedPtr(SrcPtr, Alignment))
-            {
-                Log::Memory<ELogLevel::Verbose>("Pending reallocation of %zu bytes into %zu at %p", AllocationHeader->Length, Bytes, BytePtr);
-                /* Can't go beyond NextBlock! */
-                ReallocBytes = std::min(AllocationHeader->Length, Bytes);
-                DestroyBlock(AllocationHeader);
-            }
-            else
-            {
-                Log::Memory<ELogLevel::Verbose>("Reallocating %zu bytes at %p", Bytes, BytePtr);
-                AllocationHeader->Length = Bytes;
-                return SrcPtr;
-            }
+            return nullptr;
+        }
+    }
+
+    RemoveFreeBlock(Block);
+
+    if (Alignment > AlignSize)
+    {
+        auto AlignedData = static_cast<std::byte*>(AlignPtr(Block->Data(), Alignment));
+        auto Gap = static_cast<std::size_t>(AlignedData - Block->Data());
+
+        /* Leading gap has to be able to hold a free block on its own. */
+        if (Gap != 0 && Gap < sizeof(SBlockHeader))
+        {
+            AlignedData = static_cast<std::byte*>(AlignPtr(Block->Data() + sizeof(SBlockHeader), Alignment));
+            Gap = static_cast<std::size_t>(AlignedData - Block->Data());
+        }
+
+        if (Gap != 0)
+        {
+            auto Aligned = SplitBlock(Block, Gap - SBlockHeader::Overhead);
+            Aligned->SetFree(true);
+            InsertFreeBlock(Block);
+            Block = Aligned;
+        }
+    }
+
+    Block->SetFree(false);
+    TrimUsedBlock(Block, Size);
+
+    UsedBlockCount++;
+
+    return Block->Data();
+}
+
+void CInlineResource::FreeBlock(void* Ptr)
+{
+    auto Block = SBlockHeader::FromData(Ptr);
+
+    Block->SetFree(true);
+    InsertFreeBlock(MergeWithNeighbors(Block));
+
+    UsedBlockCount--;
+}
+
+void* CInlineResource::ReallocateBlock(void* Ptr, std::size_t Bytes)
+{
+    auto Block = SBlockHeader::FromData(Ptr);
+    std::size_t Size = std::max(DoAlign(Bytes, AlignSize), MinBlockSize);
+    std::size_t CurrentSize = Block->GetSize();
+
+    if (Size > CurrentSize)
+    {
+        /* Try to grow in place by absorbing the next free block. */
+        auto Next = Block->NextPhysical();
+        if (!Next->IsLast() && Next->IsFree() && CurrentSize + Next->GetSize() + SBlockHeader::Overhead >= Size)
+        {
+            RemoveFreeBlock(Next);
+            AbsorbBlock(Block, Next);
         }
         else
         {
-            if (BytePtr + BytesWithHeader >= Buffer.data() + Buffer.size() || !IsAlignedPtr(SrcPtr, Alignment))
+            void* NewPtr = AllocateBlock(Bytes, AlignSize);
+            if (NewPtr == nullptr)
             {
-                Log::Memory<ELogLevel::Verbose>("Pending reallocation of %zu bytes into %zu at %p", AllocationHeader->Length, Bytes, BytePtr);
-                /* Can't go beyond end of the buffer! */
-                ReallocBytes = std::min(AllocationHeader->Length, Bytes);
-                DestroyBlock(AllocationHeader);
-            }
-            else
-            {
-                Log::Memory<ELogLevel::Verbose>("Reallocating %zu bytes at %p", Bytes, BytePtr);
-                AllocationHeader->Length = Bytes;
-                return SrcPtr;
+                NewPtr = AllocateUpstream(Bytes, alignof(std::max_align_t), Block->GetCategory());
             }
+
+            Log::Memory<ELogLevel::Verbose>("Copying %zu bytes to %p", CurrentSize, NewPtr);
+            std::memcpy(NewPtr, Ptr, CurrentSize);
+            FreeBlock(Ptr);
+
+            return NewPtr;
         }
     }
-    else if (Bytes == 0)
+
+    TrimUsedBlock(Block, Size);
+
+    return Ptr;
+}
+
+void* CInlineResource::AllocateUpstream(std::size_t Bytes, std::size_t Alignment, EMemoryCategory Category)
+{
+    Alignment = std::max(Alignment, alignof(SUpstreamHeader));
+    std::size_t Offset = DoAlign(sizeof(SUpstreamHeader), Alignment);
+
+    auto BasePtr = static_cast<std::byte*>(Upstream->allocate(Bytes + Offset, Alignment));
+    auto NewPtr = BasePtr + Offset;
+
+    auto Header = reinterpret_cast<SUpstreamHeader*>(NewPtr) - 1;
+    Header->Length = Bytes;
+    Header->Alignment = Alignment;
+    Header->Offset = Offset;
+    Header->Category = Category;
+
+    UpstreamFallbacks++;
+    UpstreamBytesInUse += Bytes;
+
+    Log::Memory<ELogLevel::Verbose>("Allocating %zu bytes from upstream at %p", Bytes, NewPtr);
+
+    return NewPtr;
+}
+
+void CInlineResource::FreeUpstream(void* Ptr)
+{
+    auto Header = reinterpret_cast<SUpstreamHeader*>(Ptr) - 1;
+
+    Log::Memory<ELogLevel::Verbose>("Freeing %zu bytes from upstream at %p", Header->Length, Ptr);
+
+    UpstreamBytesInUse -= Header->Length;
+
+    Upstream->deallocate(static_cast<std::byte*>(Ptr) - Header->Offset, Header->Length + Header->Offset, Header->Alignment);
+}
+
+thread_local CInlineResource::SThreadCache CInlineResource::ThreadCache;
+
+CInlineResource::SThreadCache::~SThreadCache()
+{
+    bShutdown = true;
+    if (Owner == nullptr)
+    {
+        return;
+    }
+
+    for (std::size_t Bin = 0; Bin < ThreadCacheBinCount; ++Bin)
+    {
+        Owner->DrainThreadCache(this, Bin, Counts[Bin]);
+    }
+}
+
+CInlineResource::SThreadCache* CInlineResource::GetThreadCache()
+{
+    auto Cache = &ThreadCache;
+    if (Cache->bShutdown)
+    {
+        return nullptr;
+    }
+
+    /* Thread caches serve a single resource; any other instance goes straight to its heap. */
+    if (Cache->Owner == nullptr)
+    {
+        Cache->Owner = this;
+    }
+
+    return Cache->Owner == this ? Cache : nullptr;
+}
+
+void* CInlineResource::PopThreadCache(std::size_t Bytes, std::size_t Alignment, EMemoryCategory Category)
+{
+    std::size_t Size = std::max(DoAlign(Bytes, AlignSize), MinBlockSize);
+    if (Size > ThreadCacheMaxSize || Alignment > AlignSize)
     {
         return nullptr;
     }
 
-    std::byte* NewPtr{};
-    SAllocationHeader* NewPreviousBlock = nullptr;
-    SAllocationHeader* NewNextBlock = nullptr;
+    auto Cache = GetThreadCache();
+    if (Cache == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::size_t Bin = std::size_t(Category) * ThreadCacheSizeClassCount + (Size / AlignSize) - 1;
+    if (Cache->Counts[Bin] == 0)
+    {
+        RefillThreadCache(Cache, Bin);
+        if (Cache->Counts[Bin] == 0)
+        {
+            return nullptr;
+        }
+    }
+
+    auto Block = Cache->Bins[Bin];
+    Cache->Bins[Bin] = Block->NextFree;
+    Cache->Counts[Bin]--;
+    CachedBlockCount.fetch_sub(1, std::memory_order_relaxed);
 
-    if (FinalAllocationSize > Buffer.size())
+    return Block->Data();
+}
+
+bool CInlineResource::PushThreadCache(void* Ptr)
+{
+    auto Block = SBlockHeader::FromData(Ptr);
+    std::size_t Size = Block->GetSize();
+    if (Size > ThreadCacheMaxSize)
+    {
+        return false;
+    }
+
+    auto Cache = GetThreadCache();
+    if (Cache == nullptr)
     {
-        NewPtr = static_cast<std::byte*>(Upstream->allocate(Bytes, Alignment));
+        return false;
+    }
+
+    /* Cached blocks stay marked as used so the heap never merges them. */
+    std::size_t Bin = std::size_t(Block->GetCategory()) * ThreadCacheSizeClassCount + (Size / AlignSize) - 1;
+    Block->NextFree = Cache->Bins[Bin];
+    Cache->Bins[Bin] = Block;
+    Cache->Counts[Bin]++;
+    CachedBlockCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (Cache->Counts[Bin] > ThreadCacheBinCapacity)
+    {
+        DrainThreadCache(Cache, Bin, ThreadCacheBinCapacity / 2);
+    }
+
+    return true;
+}
+
+void CInlineResource::RefillThreadCache(SThreadCache* Cache, std::size_t Bin)
+{
+    std::size_t Size = (Bin % ThreadCacheSizeClassCount + 1) * AlignSize;
+    auto Category = static_cast<EMemoryCategory>(Bin / ThreadCacheSizeClassCount);
 
-        Log::Memory<ELogLevel::Verbose>("Allocating %zu bytes from upstream at %p", Bytes, NewPtr);
+    std::unique_lock Lock{ Mutex };
 
-        if (ReallocBytes != 0)
+    for (uint32_t Index = 0; Index < ThreadCacheBatchSize; ++Index)
+    {
+        void* Ptr = AllocateBlock(Size, AlignSize);
+        if (Ptr == nullptr)
         {
-            Log::Memory<ELogLevel::Verbose>("Copying %zu bytes to %p", std::min(ReallocBytes, Bytes), NewPtr);
-            std::memcpy(NewPtr, SrcPtr, std::min(ReallocBytes, Bytes));
+            break;
         }
 
-        return NewPtr;
+        auto Block = SBlockHeader::FromData(Ptr);
+        Block->SetCategory(Category);
+        Block->NextFree = Cache->Bins[Bin];
+        Cache->Bins[Bin] = Block;
+        Cache->Counts[Bin]++;
+        CachedBlockCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void CInlineResource::DrainThreadCache(SThreadCache* Cache, std::size_t Bin, uint32_t Count)
+{
+    if (Count == 0)
+    {
+        return;
+    }
+
+    std::unique_lock Lock{ Mutex };
+
+    for (uint32_t Index = 0; Index < Count && Cache->Bins[Bin] != nullptr; ++Index)
+    {
+        auto Block = Cache->Bins[Bin];
+        Cache->Bins[Bin] = Block->NextFree;
+        Cache->Counts[Bin]--;
+        CachedBlockCount.fetch_sub(1, std::memory_order_relaxed);
+
+        FreeBlock(Block->Data());
+    }
+}
+
+void CInlineResource::TrackAllocation(void* Ptr)
+{
+    std::size_t Size{};
+    EMemoryCategory Category{};
+    if (IsInlinePtr(Ptr))
+    {
+        auto Block = SBlockHeader::FromData(Ptr);
+        Category = Block->GetCategory();
+        Size = Block->GetSize();
+    }
+    else
+    {
+        auto Header = reinterpret_cast<SUpstreamHeader*>(Ptr) - 1;
+        Category = Header->Category;
+        Size = Header->Length;
+    }
+
+    CategoryBytes[std::size_t(Category)].fetch_add(Size, std::memory_order_relaxed);
+
+    std::size_t Current = BytesInUse.fetch_add(Size, std::memory_order_relaxed) + Size;
+    std::size_t Peak = PeakBytesInUse.load(std::memory_order_relaxed);
+    while (Current > Peak && !PeakBytesInUse.compare_exchange_weak(Peak, Current, std::memory_order_relaxed))
+    {
+    }
+}
+
+void CInlineResource::TrackFree(void* Ptr)
+{
+    std::size_t Size{};
+    EMemoryCategory Category{};
+    if (IsInlinePtr(Ptr))
+    {
+        auto Block = SBlockHeader::FromData(Ptr);
+        Category = Block->GetCategory();
+        Size = Block->GetSize();
     }
     else
     {
-        if (FirstAllocation == nullptr)
+        auto Header = reinterpret_cast<SUpstreamHeader*>(Ptr) - 1;
+        Category = Header->Category;
+        Size = Header->Length;
+    }
+
+    CategoryBytes[std::size_t(Category)].fetch_sub(Size, std::memory_order_relaxed);
+    BytesInUse.fetch_sub(Size, std::memory_order_relaxed);
+}
+
+EMemoryCategory CInlineResource::GetCategory(void* Ptr) const
+{
+    if (IsInlinePtr(Ptr))
+    {
+        return SBlockHeader::FromData(Ptr)->GetCategory();
+    }
+    return (reinterpret_cast<SUpstreamHeader*>(Ptr) - 1)->Category;
+}
+
+std::size_t CInlineResource::FindLargestFreeBlock() const
+{
+    if (FLBitmap == 0)
+    {
+        return 0;
+    }
+
+    /* The largest block is somewhere in the highest non-empty size class. */
+    std::size_t FL = FindLastSet(FLBitmap);
+    std::size_t SL = FindLastSet(SLBitmaps[FL]);
+
+    std::size_t Largest{};
+    for (auto Block = FreeBlocks[FL][SL]; Block != nullptr; Block = Block->NextFree)
+    {
+        Largest = std::max(Largest, Block->GetSize());
+    }
+
+    return Largest;
+}
+
+size_t CInlineResource::NumberOfBlocks()
+{
+    std::unique_lock Lock{ Mutex };
+    return UsedBlockCount - CachedBlockCount.load(std::memory_order_relaxed);
+}
+
+void CInlineResource::NextFrame()
+{
+    std::unique_lock Lock{ Mutex };
+    LastFrameAllocations = FrameAllocations.exchange(0, std::memory_order_relaxed);
+    LastFrameFrees = FrameFrees.exchange(0, std::memory_order_relaxed);
+}
+
+SMemoryStats CInlineResource::GetStats()
+{
+    std::unique_lock Lock{ Mutex };
+
+    SMemoryStats Stats{};
+    Stats.HeapSize = CommittedSize;
+    Stats.HeapGrowthCount = GrowthCount;
+    Stats.BytesInUse = BytesInUse.load(std::memory_order_relaxed);
+    Stats.PeakBytesInUse = PeakBytesInUse.load(std::memory_order_relaxed);
+    Stats.FreeBytes = FreeBytes;
+    Stats.LargestFreeBlock = FindLargestFreeBlock();
+    Stats.Fragmentation = FreeBytes > 0 ? 1.0f - float(Stats.LargestFreeBlock) / float(FreeBytes) : 0.0f;
+    Stats.CachedBlocks = CachedBlockCount.load(std::memory_order_relaxed);
+    Stats.UsedBlocks = UsedBlockCount - Stats.CachedBlocks;
+    Stats.FrameAllocations = LastFrameAllocations;
+    Stats.FrameFrees = LastFrameFrees;
+    Stats.UpstreamFallbacks = UpstreamFallbacks;
+    Stats.UpstreamBytesInUse = UpstreamBytesInUse;
+    for (std::size_t Index = 0; Index < Stats.CategoryBytes.size(); ++Index)
+    {
+        Stats.CategoryBytes[Index] = CategoryBytes[Index].load(std::memory_order_relaxed);
+    }
+
+    return Stats;
+}
+
+void CInlineResource::GetBlockMap(uint8_t* Cells, std::size_t CellCount)
+{
+    std::memset(Cells, 0, CellCount);
+
+    std::unique_lock Lock{ Mutex };
+
+    if (CommittedSize == 0)
+    {
+        return;
+    }
+
+    std::size_t CellSize = (CommittedSize + CellCount - 1) / CellCount;
+    for (auto Block = reinterpret_cast<SBlockHeader*>(Base); !Block->IsLast(); Block = Block->NextPhysical())
+    {
+        if (Block->IsFree())
         {
-            NewPtr = Buffer.data();
+            continue;
         }
-        else
+
+        auto Begin = static_cast<std::size_t>(reinterpret_cast<std::byte*>(Block) - Base);
+        auto End = Begin + SBlockHeader::Overhead + Block->GetSize();
+        for (std::size_t Cell = Begin / CellSize; Cell <= (End - 1) / CellSize && Cell < CellCount; ++Cell)
         {
-            if (reinterpret_cast<std::byte*>(FirstAllocation) > Buffer.data() && reinterpret_cast<std::byte*>(FirstAllocation) - Buffer.data() >= (int)BytesWithHeader)
-            {
-                NewPtr = Buffer.data();
-                NewNextBlock = FirstAllocation;
-                FirstAllocation = nullptr;
-            }
-            else
-            {
-                SAllocationHeader* AllocationHeader = FirstAllocation;
-                while (AllocationHeader != nullptr)
-                {
-                    auto DataAfterHeader = reinterpret_cast<std::byte*>(AllocationHeader) + AllocationHeader->Length + sizeof(SAllocationHeader);
-
-                    /* See if there is free space after the header. */
-                    if (AllocationHeader->NextBlock != nullptr)
-                    {
-                        auto NextBlockData = reinterpret_cast<std::byte*>(AllocationHeader->NextBlock);
-                        if (DataAfterHeader + FinalAllocationSize < NextBlockData)
-                        {
-                            /* We can fit an allocation between two. */
-                            NewPtr = DataAfterHeader;
-                            NewPreviousBlock = AllocationHeader;
-                            NewNextBlock = AllocationHeader->NextBlock;
-                            break;
-                        }
-                        else
-                        {
-                            AllocationHeader = AllocationHeader->NextBlock;
-                            continue;
-                        }
-                    }
-                    else
-                    {
-                        /* No next block; just check if it fits. */
-                        if (DataAfterHeader + FinalAllocationSize >= Buffer.data() + Buffer.size())
-                        {
-                            NewPtr = static_cast<std::byte*>(Upstream->allocate(Bytes, Alignment));
-
-                            Log::Memory<ELogLevel::Verbose>("Allocating %zu bytes from upstream at %p", Bytes, NewPtr);
-
-                            if (ReallocBytes != 0)
-                            {
-                                Log::Memory<ELogLevel::Verbose>("Copying %zu bytes to %p", std::min(ReallocBytes, Bytes), NewPtr);
-                                std::memcpy(NewPtr, SrcPtr, std::min(ReallocBytes, Bytes));
-                            }
-
-                            return NewPtr;
-                        }
-                        else
-                        {
-                            NewPtr = DataAfterHeader;
-                            NewPreviousBlock = AllocationHeader;
-                            NewNextBlock = AllocationHeader->NextBlock;
-                            break;
-                        }
-                    }
-                }
-            }
+            Cells[Cell] = 1 + static_cast<uint8_t>(Block->GetCategory());
         }
     }
+}
 
-    if (NewPtr == nullptr)
+void* CInlineResource::Allocate(std::size_t Bytes, std::size_t Alignment, EMemoryCategory Category)
+{
+    if (Bytes == 0)
     {
-        Log::Memory<ELogLevel::Verbose>("Failed to allocate %zu bytes", Bytes);
-        exit(1);
+        return nullptr;
     }
-    else
+
+    CheckAllocationGuard(Bytes);
+
+    void* NewPtr = PopThreadCache(Bytes, Alignment, Category);
+    if (NewPtr == nullptr)
     {
-        /* Shift pointer to point to allocated data. */
-        NewPtr = static_cast<std::byte*>(AlignPtr(NewPtr + sizeof(SAllocationHeader), Alignment));
-#ifdef EQUINOX_REACH_DEVELOPMENT
-        if (ReallocBytes == 0)
+        std::unique_lock Lock{ Mutex };
+
+        NewPtr = AllocateBlock(Bytes, Alignment);
+        if (NewPtr != nullptr)
         {
-            Log::Memory<ELogLevel::Verbose>("Allocating %zu bytes at %p", Bytes, NewPtr);
+            SBlockHeader::FromData(NewPtr)->SetCategory(Category);
         }
-#endif
+        else
+        {
+            NewPtr = AllocateUpstream(Bytes, Alignment, Category);
+        }
+
+        Log::Memory<ELogLevel::Verbose>("Allocating %zu bytes at %p", Bytes, NewPtr);
+    }
+
+    TrackAllocation(NewPtr);
+    FrameAllocations.fetch_add(1, std::memory_order_relaxed);
+    AllocationTrace.Record(EAllocationEvent::Allocate, NewPtr, nullptr, Bytes, Alignment, Category);
+
+    return NewPtr;
+}
+
+void CInlineResource::Deallocate(void* Ptr)
+{
+    if (Ptr == nullptr)
+    {
+        return;
     }
 
-    auto NewAllocationHeader = reinterpret_cast<SAllocationHeader*>(NewPtr) - 1;
-    NewAllocationHeader->Length = Bytes;
-    NewAllocationHeader->NextBlock = NewNextBlock;
-    NewAllocationHeader->PreviousBlock = NewPreviousBlock;
+    /* Recorded before the block is released, so the trace never sees its address handed out twice. */
+    AllocationTrace.Record(EAllocationEvent::Free, Ptr, nullptr, 0, alignof(std::max_align_t), GetCategory(Ptr));
+    TrackFree(Ptr);
+    FrameFrees.fetch_add(1, std::memory_order_relaxed);
 
-    if (FirstAllocation == nullptr)
+    if (IsInlinePtr(Ptr) && PushThreadCache(Ptr))
     {
-        FirstAllocation = NewAllocationHeader;
+        return;
     }
 
-    if (NewNextBlock != nullptr)
+    std::unique_lock Lock{ Mutex };
+
+    if (!IsInlinePtr(Ptr))
     {
-        NewNextBlock->PreviousBlock = NewAllocationHeader;
+        FreeUpstream(Ptr);
+        return;
     }
 
-    if (NewPreviousBlock != nullptr)
+    Log::Memory<ELogLevel::Verbose>("Freeing %zu bytes at %p", SBlockHeader::FromData(Ptr)->GetSize(), Ptr);
+
+    FreeBlock(Ptr);
+}
+
+void* CInlineResource::Reallocate(void* Ptr, std::size_t Bytes, EMemoryCategory Category)
+{
+    if (Ptr == nullptr)
     {
-        NewPreviousBlock->NextBlock = NewAllocationHeader;
+        return Allocate(Bytes, alignof(std::max_align_t), Category);
     }
 
-    if (ReallocBytes != 0)
+    if (Bytes == 0)
     {
-        Log::Memory<ELogLevel::Verbose>("Copying %zu bytes to %p", std::min(ReallocBytes, Bytes), NewPtr);
-        std::memcpy(NewPtr, SrcPtr, std::min(ReallocBytes, Bytes));
+        Deallocate(Ptr);
+        return nullptr;
+    }
+
+    CheckAllocationGuard(Bytes);
+    TrackFree(Ptr);
+    FrameAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    void* NewPtr{};
+    {
+        std::unique_lock Lock{ Mutex };
+
+        if (!IsInlinePtr(Ptr))
+        {
+            /* Upstream blocks are never resized in place; try to move them back into the buffer. */
+            auto Header = reinterpret_cast<SUpstreamHeader*>(Ptr) - 1;
+            NewPtr = AllocateBlock(Bytes, alignof(std::max_align_t));
+            if (NewPtr == nullptr)
+            {
+                NewPtr = AllocateUpstream(Bytes, alignof(std::max_align_t), Category);
+            }
+            std::memcpy(NewPtr, Ptr, std::min(Header->Length, Bytes));
+            FreeUpstream(Ptr);
+        }
+        else
+        {
+            Log::Memory<ELogLevel::Verbose>("Reallocating %zu bytes at %p", Bytes, Ptr);
+
+            NewPtr = ReallocateBlock(Ptr, Bytes);
+        }
+
+        if (IsInlinePtr(NewPtr))
+        {
+            SBlockHeader::FromData(NewPtr)->SetCategory(Category);
+        }
     }
 
+    TrackAllocation(NewPtr);
+    AllocationTrace.Record(EAllocationEvent::Reallocate, NewPtr, Ptr, Bytes, alignof(std::max_align_t), Category);
+
     return NewPtr;
 }
 
+void* CInlineResource::do_allocate(size_t bytes, size_t alignment)
+{
+    return Allocate(bytes, alignment, EMemoryCategory::Pmr);
+}
+
+void CInlineResource::do_deallocate(void* ptr, [[maybe_unused]] size_t bytes, [[maybe_unused]] size_t alignment)
+{
+    Deallocate(ptr);
+}
+
 void* CTopmostResource::do_allocate(size_t Bytes, size_t Align)
 {
     Log::Memory<ELogLevel::Critical>("Allocating %d bytes through topmost resource", Bytes);
@@ -286,7 +1068,12 @@ namespace Memory
 {
     CTopmostResource TopmostResource;
     CInlineResource InlineResource(&TopmostResource);
-    std::pmr::synchronized_pool_resource PoolResource(&InlineResource);
+    CGuardedPoolResource PoolResource(&InlineResource);
+
+    void Init(std::size_t InitialHeapSize, std::size_t HeapGrowthStep)
+    {
+        InlineResource.Init(InitialHeapSize, HeapGrowthStep);
+    }
 
     std::pmr::memory_resource* GetInlineResource()
     {
@@ -298,31 +1085,95 @@ namespace Memory
         return &PoolResource;
     }
 
-    void* Malloc(size_t Bytes)
+    void* Malloc(size_t Bytes, EMemoryCategory Category)
     {
-        void* Ptr = InlineResource.do_allocate(Bytes, alignof(std::max_align_t));
+        void* Ptr = InlineResource.Allocate(Bytes, alignof(std::max_align_t), Category);
         return Ptr;
     }
 
-    void* Calloc(size_t Num, size_t Bytes)
+    void* Calloc(size_t Num, size_t Bytes, EMemoryCategory Category)
     {
-        void* Ptr = InlineResource.do_allocate(Num * Bytes, alignof(std::max_align_t));
+        void* Ptr = InlineResource.Allocate(Num * Bytes, alignof(std::max_align_t), Category);
         std::memset(Ptr, 0, Bytes * Num);
         return Ptr;
     }
 
-    void* Realloc(void* Ptr, size_t Bytes)
+    void* Realloc(void* Ptr, size_t Bytes, EMemoryCategory Category)
     {
-        return InlineResource.do_reallocate(Ptr, Bytes);
+        return InlineResource.Reallocate(Ptr, Bytes, Category);
     }
 
     void Free(void* Ptr)
     {
-        InlineResource.do_deallocate(Ptr, 0, alignof(std::max_align_t));
+        InlineResource.Deallocate(Ptr);
     }
 
     std::size_t NumberOfBlocks()
     {
         return InlineResource.NumberOfBlocks();
     }
-}
\ No newline at end of file
+
+    SMemoryStats GetStats()
+    {
+        return InlineResource.GetStats();
+    }
+
+    void GetBlockMap(uint8_t* Cells, std::size_t CellCount)
+    {
+        InlineResource.GetBlockMap(Cells, CellCount);
+    }
+
+    SAllocationGuard::SAllocationGuard(const char* Tag)
+        : PreviousTag(std::exchange(AllocationGuardTag, Tag))
+    {
+    }
+
+    SAllocationGuard::~SAllocationGuard()
+    {
+        AllocationGuardTag = PreviousTag;
+    }
+
+    std::array<SAllocationGuardViolation, MaxAllocationGuardViolations> GetAllocationGuardViolations()
+    {
+        std::unique_lock Lock{ AllocationGuardReport.Mutex };
+        return AllocationGuardReport.Violations;
+    }
+
+    void ResetAllocationGuardViolations()
+    {
+        std::unique_lock Lock{ AllocationGuardReport.Mutex };
+        AllocationGuardReport.Violations = {};
+    }
+
+#ifdef EQUINOX_REACH_DEVELOPMENT
+    void SetAllocationGuardTrap(bool bTrap)
+    {
+        AllocationGuardReport.bTrap.store(bTrap, std::memory_order_relaxed);
+    }
+
+    bool IsAllocationGuardTrapEnabled()
+    {
+        return AllocationGuardReport.bTrap.load(std::memory_order_relaxed);
+    }
+#endif
+
+    bool StartTrace(const char* Path)
+    {
+        return AllocationTrace.Start(Path);
+    }
+
+    void StopTrace()
+    {
+        AllocationTrace.Stop();
+    }
+
+    bool IsTracing()
+    {
+        return AllocationTrace.bRecording.load(std::memory_order_relaxed);
+    }
+
+    void NextFrame()
+    {
+        InlineResource.NextFrame();
+    }
+}
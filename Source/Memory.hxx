@@ -3,30 +3,252 @@
 #include <vector>
 #include <memory>
 #include <cstring>
+#include <cstdint>
 #include <mutex>
+#include <atomic>
 #include <memory_resource>
 #include <cstddef>
 #include <array>
 
-static constexpr std::size_t HeapSize = 1024 * 1024 * 16;
+/* Defaults for Memory::Init, both can be changed at runtime before the game starts. */
+static constexpr std::size_t DefaultHeapSize = 1024 * 1024 * 16;
+static constexpr std::size_t DefaultHeapGrowthStep = 1024 * 1024 * 8;
+/* Address space reserved up front; the heap can never grow past it. */
+static constexpr std::size_t HeapReserveSize = std::size_t(1024) * 1024 * 1024;
+/* Chunks are committed in multiples of the transparent huge page size. */
+static constexpr std::size_t HeapChunkAlignment = 1024 * 1024 * 2;
 
+/* Who asked for the memory; kept with every block for the heap telemetry. */
+enum class EMemoryCategory : uint8_t
+{
+    Pmr,
+    SDL,
+    Stb,
+    ImGui,
+    Asset,
+    Count
+};
+
+static constexpr const char* MemoryCategoryNames[] = { "pmr", "SDL", "stb", "ImGui", "asset" };
+
+struct SMemoryStats
+{
+    std::size_t HeapSize{};
+    std::size_t HeapGrowthCount{};
+    std::size_t BytesInUse{};
+    std::size_t PeakBytesInUse{};
+    std::size_t FreeBytes{};
+    std::size_t LargestFreeBlock{};
+    /* 0 when all free memory is one block, close to 1 when it's scattered in small gaps. */
+    float Fragmentation{};
+    std::size_t UsedBlocks{};
+    std::size_t CachedBlocks{};
+    std::size_t FrameAllocations{};
+    std::size_t FrameFrees{};
+    std::size_t UpstreamFallbacks{};
+    std::size_t UpstreamBytesInUse{};
+    std::array<std::size_t, std::size_t(EMemoryCategory::Count)> CategoryBytes{};
+};
+
+enum class EAllocationEvent : uint8_t
+{
+    Allocate,
+    Reallocate,
+    Free
+};
+
+/* Allocation traces are a header followed by tightly packed events, see Memory::StartTrace. */
+struct SAllocationTraceHeader
+{
+    static constexpr uint32_t CurrentMagic = 0x544D5245; /* "ERMT" */
+    static constexpr uint32_t CurrentVersion = 1;
+
+    uint32_t Magic = CurrentMagic;
+    uint32_t Version = CurrentVersion;
+};
+
+struct SAllocationTraceEvent
+{
+    /* Nanoseconds since the trace was started. */
+    uint64_t Timestamp{};
+    uint64_t Ptr{};
+    /* Only set for reallocations. */
+    uint64_t OldPtr{};
+    uint32_t Size{};
+    EAllocationEvent Type{};
+    EMemoryCategory Category{};
+    uint8_t AlignmentLog2{};
+    uint8_t Padding{};
+};
+
+static_assert(sizeof(SAllocationTraceEvent) == 32, "Trace events are written to disk as is");
+
+/* Two-level segregated fit (TLSF) allocator working on top of a reserved address range.
+ * Allocation, deallocation and reallocation are O(1). Free blocks are coalesced with their physical neighbors.
+ * The heap grows by committing prefaulted chunks right after the previous one, so it stays a single pool. */
 class CInlineResource final : public std::pmr::memory_resource
 {
 private:
-    struct alignas(alignof(std::max_align_t)) SAllocationHeader
+    static constexpr std::size_t AlignSizeLog2 = 4;
+    static constexpr std::size_t AlignSize = 1 << AlignSizeLog2;
+
+    /* Number of second level subdivisions per first level size class. */
+    static constexpr std::size_t SLIndexCountLog2 = 5;
+    static constexpr std::size_t SLIndexCount = 1 << SLIndexCountLog2;
+
+    /* Blocks smaller than SmallBlockSize are all kept in the first size class. */
+    static constexpr std::size_t FLIndexShift = SLIndexCountLog2 + AlignSizeLog2;
+    static constexpr std::size_t FLIndexMax = 32;
+    static constexpr std::size_t FLIndexCount = FLIndexMax - FLIndexShift + 1;
+    static constexpr std::size_t SmallBlockSize = 1 << FLIndexShift;
+
+    struct alignas(AlignSize) SBlockHeader
+    {
+        SBlockHeader* PreviousPhysical{};
+        std::size_t Size{};
+
+        /* Free list links overlap the payload, so they are only valid for free blocks. */
+        SBlockHeader* NextFree{};
+        SBlockHeader* PreviousFree{};
+
+        /* Sizes are multiples of AlignSize, so the low bits hold the free flag and the category. */
+        static constexpr std::size_t FreeBit = 1 << 0;
+        static constexpr std::size_t CategoryShift = 1;
+        static constexpr std::size_t CategoryMask = 0b111 << CategoryShift;
+        static constexpr std::size_t FlagsMask = FreeBit | CategoryMask;
+
+        [[nodiscard]] inline std::size_t GetSize() const { return Size & ~FlagsMask; }
+        inline void SetSize(std::size_t NewSize) { Size = NewSize | (Size & FlagsMask); }
+        [[nodiscard]] inline bool IsFree() const { return Size & FreeBit; }
+        inline void SetFree(bool bFree) { Size = bFree ? (Size | FreeBit) : (Size & ~FreeBit); }
+        [[nodiscard]] inline bool IsLast() const { return GetSize() == 0; }
+
+        [[nodiscard]] inline EMemoryCategory GetCategory() const
+        {
+            return static_cast<EMemoryCategory>((Size & CategoryMask) >> CategoryShift);
+        }
+
+        inline void SetCategory(EMemoryCategory Category)
+        {
+            Size = (Size & ~CategoryMask) | (static_cast<std::size_t>(Category) << CategoryShift);
+        }
+
+        [[nodiscard]] inline std::byte* Data()
+        {
+            return reinterpret_cast<std::byte*>(this) + Overhead;
+        }
+
+        [[nodiscard]] inline SBlockHeader* NextPhysical()
+        {
+            return reinterpret_cast<SBlockHeader*>(Data() + GetSize());
+        }
+
+        static inline SBlockHeader* FromData(void* Ptr)
+        {
+            return reinterpret_cast<SBlockHeader*>(static_cast<std::byte*>(Ptr) - Overhead);
+        }
+
+        /* Only PreviousPhysical and Size are kept for the blocks in use. */
+        static constexpr std::size_t Overhead = sizeof(SBlockHeader*) + sizeof(std::size_t);
+    };
+
+    static_assert(SBlockHeader::Overhead == AlignSize, "Block data has to stay aligned to AlignSize");
+    static_assert(SBlockHeader::FlagsMask < AlignSize, "Block flags have to fit below AlignSize");
+
+    static constexpr std::size_t MinBlockSize = sizeof(SBlockHeader) - SBlockHeader::Overhead;
+    static constexpr std::size_t MaxBlockSize = std::size_t(1) << (FLIndexMax - 1);
+
+    /* Allocations that didn't fit into the inline buffer keep their size for Realloc/Free. */
+    struct alignas(alignof(std::max_align_t)) SUpstreamHeader
     {
         std::size_t Length{};
-        SAllocationHeader* PreviousBlock{};
-        SAllocationHeader* NextBlock{};
+        std::size_t Alignment{};
+        std::size_t Offset{};
+        EMemoryCategory Category{};
     };
 
-    alignas(alignof(std::max_align_t))
-        std::array<std::byte, HeapSize> Buffer{};
-    SAllocationHeader* FirstAllocation{};
+    /* Small blocks are cached per thread and only go back to the shared heap in batches.
+     * Bins are kept per category too, so block headers are never written outside of Mutex. */
+    static constexpr std::size_t ThreadCacheMaxSize = SmallBlockSize;
+    static constexpr std::size_t ThreadCacheSizeClassCount = ThreadCacheMaxSize / AlignSize;
+    static constexpr std::size_t ThreadCacheBinCount = ThreadCacheSizeClassCount * std::size_t(EMemoryCategory::Count);
+    static constexpr uint32_t ThreadCacheBinCapacity = 32;
+    static constexpr uint32_t ThreadCacheBatchSize = 8;
+
+    struct SThreadCache
+    {
+        CInlineResource* Owner{};
+        bool bShutdown{};
+        std::array<SBlockHeader*, ThreadCacheBinCount> Bins{};
+        std::array<uint32_t, ThreadCacheBinCount> Counts{};
+
+        ~SThreadCache();
+    };
+
+    static thread_local SThreadCache ThreadCache;
+
+    std::byte* Base{};
+    std::size_t ReservedSize{};
+    std::size_t CommittedSize{};
+    std::size_t GrowthStep = DefaultHeapGrowthStep;
+    std::size_t GrowthCount{};
+    uint32_t FLBitmap{};
+    std::array<uint32_t, FLIndexCount> SLBitmaps{};
+    std::array<std::array<SBlockHeader*, SLIndexCount>, FLIndexCount> FreeBlocks{};
+    std::size_t UsedBlockCount{};
+    std::atomic<std::size_t> CachedBlockCount{};
+
+    /* Telemetry. Atomics are only touched with relaxed ordering, the rest is guarded by Mutex. */
+    std::atomic<std::size_t> BytesInUse{};
+    std::atomic<std::size_t> PeakBytesInUse{};
+    std::atomic<std::size_t> FrameAllocations{};
+    std::atomic<std::size_t> FrameFrees{};
+    std::array<std::atomic<std::size_t>, std::size_t(EMemoryCategory::Count)> CategoryBytes{};
+    std::size_t LastFrameAllocations{};
+    std::size_t LastFrameFrees{};
+    std::size_t FreeBytes{};
+    std::size_t UpstreamFallbacks{};
+    std::size_t UpstreamBytesInUse{};
     std::pmr::memory_resource* Upstream = std::pmr::new_delete_resource();
     std::mutex Mutex;
 
-    void DestroyBlock(SAllocationHeader* AllocationHeader);
+    static void MappingInsert(std::size_t Size, std::size_t& FL, std::size_t& SL);
+    static void MappingSearch(std::size_t Size, std::size_t& FL, std::size_t& SL);
+
+    SBlockHeader* SearchSuitableBlock(std::size_t& FL, std::size_t& SL);
+    void InsertFreeBlock(SBlockHeader* Block);
+    void RemoveFreeBlock(SBlockHeader* Block);
+    static SBlockHeader* SplitBlock(SBlockHeader* Block, std::size_t Size);
+    static SBlockHeader* AbsorbBlock(SBlockHeader* Previous, SBlockHeader* Block);
+    SBlockHeader* MergeWithNeighbors(SBlockHeader* Block);
+    void TrimUsedBlock(SBlockHeader* Block, std::size_t Size);
+
+    bool Grow(std::size_t Bytes);
+
+    void* AllocateBlock(std::size_t Bytes, std::size_t Alignment);
+    void FreeBlock(void* Ptr);
+    void* ReallocateBlock(void* Ptr, std::size_t Bytes);
+
+    SThreadCache* GetThreadCache();
+    void* PopThreadCache(std::size_t Bytes, std::size_t Alignment, EMemoryCategory Category);
+    bool PushThreadCache(void* Ptr);
+    void RefillThreadCache(SThreadCache* Cache, std::size_t Bin);
+    void DrainThreadCache(SThreadCache* Cache, std::size_t Bin, uint32_t Count);
+
+    void* AllocateUpstream(std::size_t Bytes, std::size_t Alignment, EMemoryCategory Category);
+    void FreeUpstream(void* Ptr);
+
+    void TrackAllocation(void* Ptr);
+    void TrackFree(void* Ptr);
+    /* Category the block at Ptr was allocated with, inline or upstream. */
+    [[nodiscard]] EMemoryCategory GetCategory(void* Ptr) const;
+    [[nodiscard]] std::size_t FindLargestFreeBlock() const;
+
+    /* The whole reservation is checked, so it's safe to call while another thread grows the heap. */
+    [[nodiscard]] bool IsInlinePtr(const void* Ptr) const
+    {
+        return Ptr >= Base && Ptr < Base + ReservedSize;
+    }
 
     static constexpr std::size_t DoAlign(std::size_t Num, std::size_t Alignment)
     {
@@ -48,15 +270,28 @@ public:
 
     ~CInlineResource() final;
 
+    /* Commits at least InitialSize bytes and sets how much gets committed whenever the heap runs out. */
+    void Init(std::size_t InitialSize, std::size_t InGrowthStep);
+
     size_t NumberOfBlocks();
 
-    void* do_allocate(size_t bytes, size_t alignment) override;
+    /* Closes the per-frame allocation counters. */
+    void NextFrame();
 
-    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+    SMemoryStats GetStats();
+
+    /* Fills every cell with 0 when its part of the committed heap is free, otherwise 1 + the category of a block touching it. */
+    void GetBlockMap(uint8_t* Cells, std::size_t CellCount);
 
-    void* do_reallocate(void* ptr, size_t bytes);
+    void* Allocate(std::size_t Bytes, std::size_t Alignment, EMemoryCategory Category);
 
-    void* AllocateInline(void* SrcPtr, size_t Bytes, size_t Alignment = alignof(std::max_align_t));
+    void Deallocate(void* Ptr);
+
+    void* Reallocate(void* Ptr, std::size_t Bytes, EMemoryCategory Category);
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
 
     [[nodiscard]] inline bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
     {
@@ -78,6 +313,9 @@ class CTopmostResource final : public std::pmr::memory_resource
 
 namespace Memory
 {
+    /* Allocating before Init commits a first chunk of DefaultHeapGrowthStep bytes. */
+    void Init(std::size_t InitialHeapSize = DefaultHeapSize, std::size_t HeapGrowthStep = DefaultHeapGrowthStep);
+
     std::pmr::memory_resource* GetInlineResource();
     std::pmr::memory_resource* GetPoolResource();
 
@@ -93,10 +331,50 @@ namespace Memory
         return std::pmr::vector<T>(GetPoolResource());
     }
 
-    void* Malloc(size_t Bytes);
-    void* Calloc(size_t Num, size_t Bytes);
-    void* Realloc(void* Ptr, size_t Bytes);
+    void* Malloc(size_t Bytes, EMemoryCategory Category);
+    void* Calloc(size_t Num, size_t Bytes, EMemoryCategory Category);
+    void* Realloc(void* Ptr, size_t Bytes, EMemoryCategory Category);
     void Free(void* Ptr);
 
     std::size_t NumberOfBlocks();
+    SMemoryStats GetStats();
+
+    /* While alive, any allocation on this thread through the inline or the pool resource is reported under Tag. */
+    struct SAllocationGuard
+    {
+    private:
+        const char* PreviousTag{};
+
+    public:
+        explicit SAllocationGuard(const char* Tag);
+        ~SAllocationGuard();
+
+        SAllocationGuard(const SAllocationGuard&) = delete;
+        SAllocationGuard& operator=(const SAllocationGuard&) = delete;
+    };
+
+    struct SAllocationGuardViolation
+    {
+        const char* Tag{};
+        std::size_t Count{};
+        std::size_t LastBytes{};
+    };
+
+    static constexpr std::size_t MaxAllocationGuardViolations = 16;
+
+    std::array<SAllocationGuardViolation, MaxAllocationGuardViolations> GetAllocationGuardViolations();
+    void ResetAllocationGuardViolations();
+#ifdef EQUINOX_REACH_DEVELOPMENT
+    /* Raises a debugger trap on every violation. */
+    void SetAllocationGuardTrap(bool bTrap);
+    bool IsAllocationGuardTrapEnabled();
+#endif
+
+    /* Records every allocation made through the inline resource into a binary trace file. */
+    bool StartTrace(const char* Path);
+    void StopTrace();
+    bool IsTracing();
+    void GetBlockMap(uint8_t* Cells, std::size_t CellCount);
+
+    void NextFrame();
 }
@@ -25,7 +25,12 @@ void SPlatform::Init()
     },
         nullptr);
 
-    if (SDL_SetMemoryFunctions(&Memory::Malloc, &Memory::Calloc, &Memory::Realloc, &Memory::Free) != true)
+    if (SDL_SetMemoryFunctions(
+            [](size_t Bytes) { return Memory::Malloc(Bytes, EMemoryCategory::SDL); },
+            [](size_t Num, size_t Bytes) { return Memory::Calloc(Num, Bytes, EMemoryCategory::SDL); },
+            [](void* Ptr, size_t Bytes) { return Memory::Realloc(Ptr, Bytes, EMemoryCategory::SDL); },
+            &Memory::Free)
+        != true)
     {
         SDL_LogError(SDL_LOG_CATEGORY_CUSTOM, "Error %s", SDL_GetError());
         exit(1);
@@ -59,13 +59,30 @@ SHARED_CONST(UBER2D_MODE_BACK_BLUR, 2)
 SHARED_CONST(UBER2D_MODE_GLOW, 3)
 SHARED_CONST(UBER2D_MODE_DISINTEGRATE, 4)
 SHARED_CONST(UBER2D_MODE_DISINTEGRATE_PLASMA, 5)
+SHARED_CONST(UBER2D_MODE_COUNT, 6)
 
 /* Uber3D Shader Modes */
 SHARED_CONST(UBER3D_MODE_BASIC, 0)
 SHARED_CONST(UBER3D_MODE_LEVEL, 1)
-
-/* Uber3D Limits */
-SHARED_CONST(UBER3D_MODEL_COUNT, 64)
+SHARED_CONST(UBER3D_MODE_LEVEL_PULLED, 2)
+SHARED_CONST(UBER3D_MODE_COUNT, 3)
+
+/* Uber3D Level Instances */
+SHARED_CONST(LEVEL_INSTANCE_POSITION_SCALE, 256)
+
+/* Uber3D Pulled Level, what a tile is expanded into and the window of tiles around the POV that is expanded */
+SHARED_CONST(LEVEL_PULL_FLOOR, 0)
+SHARED_CONST(LEVEL_PULL_HOLE, 1)
+SHARED_CONST(LEVEL_PULL_WALL, 2)
+SHARED_CONST(LEVEL_PULL_WALL_JOINT, 3)
+SHARED_CONST(LEVEL_PULL_DOOR_FRAME, 4)
+SHARED_CONST(LEVEL_PULL_DOOR, 5)
+
+SHARED_CONST(LEVEL_WINDOW_BACK, 1)
+SHARED_CONST(LEVEL_WINDOW_FORWARD, 4)
+SHARED_CONST(LEVEL_WINDOW_SIDE, 4)
+SHARED_CONST(LEVEL_WINDOW_WIDTH, (LEVEL_WINDOW_SIDE * 2 + 1))
+SHARED_CONST(LEVEL_WINDOW_TILE_COUNT, ((LEVEL_WINDOW_BACK + LEVEL_WINDOW_FORWARD + 1) * LEVEL_WINDOW_WIDTH))
 
 /* HUD Shader Modes */
 SHARED_CONST(HUD_MODE_BORDER_DASHED, 0)
@@ -75,6 +92,7 @@ SHARED_CONST(HUD_MODE_BUTTON, 1)
 SHARED_CONST(MAP_MODE_NORMAL, 0)
 SHARED_CONST(MAP_MODE_WORLD_LAYER, 1)
 SHARED_CONST(MAP_MODE_WORLD, 2)
+SHARED_CONST(MAP_MODE_COUNT, 3)
 
 /* Map */
 SHARED_CONST(WORLD_MAX_LAYERS, 8)
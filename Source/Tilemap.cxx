@@ -1,12 +1,330 @@
 #include "Tilemap.hxx"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 #include "CommonTypes.hxx"
 #include "Tile.hxx"
 
+/* Sight can't cross walls, doors, or the level bounds. */
+static bool IsEdgeOpaque(const STilemap& Tilemap, const SVec2Int& Coords, SDirection Direction)
+{
+    auto Tile = Tilemap.GetTileAt(Coords);
+    auto Neighbor = Tilemap.GetTileAt(Coords + Direction.GetVector<int>());
+    return Tile == nullptr || Neighbor == nullptr || !Tile->IsEdgeEmpty(Direction) || !Neighbor->IsEdgeEmpty(Direction.Inverted());
+}
+
+/* Walks the tiles the segment goes through, tile centers are on integer coordinates. */
+static bool IsSightLineClear(const STilemap& Tilemap, const SVec2& From, const SVec2& To)
+{
+    SVec2Int Coords{ (int)std::floor(From.X + 0.5f), (int)std::floor(From.Y + 0.5f) };
+    SVec2Int const TargetCoords{ (int)std::floor(To.X + 0.5f), (int)std::floor(To.Y + 0.5f) };
+    auto const Delta = To - From;
+
+    SVec2Int const Step{ Delta.X > 0.0f ? 1 : -1, Delta.Y > 0.0f ? 1 : -1 };
+    auto const DirectionX = Step.X > 0 ? SDirection::East() : SDirection::West();
+    auto const DirectionY = Step.Y > 0 ? SDirection::South() : SDirection::North();
+
+    /* Fraction of the segment walked when the next tile border is reached, and between two borders. */
+    auto const TDeltaX = Delta.X != 0.0f ? std::abs(1.0f / Delta.X) : INFINITY;
+    auto const TDeltaY = Delta.Y != 0.0f ? std::abs(1.0f / Delta.Y) : INFINITY;
+    auto TMaxX = Delta.X != 0.0f ? ((float)Coords.X + (0.5f * (float)Step.X) - From.X) / Delta.X : INFINITY;
+    auto TMaxY = Delta.Y != 0.0f ? ((float)Coords.Y + (0.5f * (float)Step.Y) - From.Y) / Delta.Y : INFINITY;
+
+    auto StepsLeft = std::abs(TargetCoords.X - Coords.X) + std::abs(TargetCoords.Y - Coords.Y);
+    while (StepsLeft > 0 && !(Coords == TargetCoords))
+    {
+        if (TMaxX < TMaxY)
+        {
+            if (IsEdgeOpaque(Tilemap, Coords, DirectionX))
+            {
+                return false;
+            }
+            Coords.X += Step.X;
+            TMaxX += TDeltaX;
+            StepsLeft--;
+        }
+        else if (TMaxY < TMaxX)
+        {
+            if (IsEdgeOpaque(Tilemap, Coords, DirectionY))
+            {
+                return false;
+            }
+            Coords.Y += Step.Y;
+            TMaxY += TDeltaY;
+            StepsLeft--;
+        }
+        else
+        {
+            /* Right through a corner, either way around it will do. */
+            bool bClearXFirst = !IsEdgeOpaque(Tilemap, Coords, DirectionX) && !IsEdgeOpaque(Tilemap, { Coords.X + Step.X, Coords.Y }, DirectionY);
+            bool bClearYFirst = !IsEdgeOpaque(Tilemap, Coords, DirectionY) && !IsEdgeOpaque(Tilemap, { Coords.X, Coords.Y + Step.Y }, DirectionX);
+            if (!bClearXFirst && !bClearYFirst)
+            {
+                return false;
+            }
+            Coords += Step;
+            TMaxX += TDeltaX;
+            TMaxY += TDeltaY;
+            StepsLeft -= 2;
+        }
+    }
+    return Coords == TargetCoords;
+}
+
+void STilemap::BuildVisibleSets()
+{
+    /* The eye is anywhere on its tile while moving or turning, sight lines go from any of these points to any of
+     * those on the target tile. */
+    static constexpr SVec2 EyeSamples[] = { { 0.0f, 0.0f }, { -0.4f, -0.4f }, { 0.4f, -0.4f }, { 0.4f, 0.4f }, { -0.4f, 0.4f } };
+    static constexpr SVec2 TargetSamples[] = { { 0.0f, 0.0f }, { -0.45f, -0.45f }, { 0.45f, -0.45f }, { 0.45f, 0.45f }, { -0.45f, 0.45f } };
+
+    VisibleSetOffsets.clear();
+    VisibleSets.clear();
+    VisibleSetOffsets.reserve((TileCount() * SDirection::Count) + 1);
+
+    /* Candidates are the tiles reachable through open edges without leaving the view, nothing else can be seen. */
+    std::array<uint16_t, MAX_LEVEL_TILE_COUNT> Candidates{};
+    std::bitset<MAX_LEVEL_TILE_COUNT> Queued{};
+
+    for (std::size_t Index = 0; Index < TileCount(); ++Index)
+    {
+        auto const EyeCoords = IndexToCoords(Index);
+        for (auto& ViewDirection : SDirection::All())
+        {
+            VisibleSetOffsets.push_back((uint32_t)VisibleSets.size());
+
+            auto IsInView = [&](const SVec2Int& Coords) { return IsInVisibleSetView(EyeCoords, ViewDirection, Coords); };
+
+            int CandidateCount = 0;
+            Queued.reset();
+            Candidates[CandidateCount++] = (uint16_t)Index;
+            Queued.set(Index);
+            for (int Head = 0; Head < CandidateCount; ++Head)
+            {
+                auto const Coords = IndexToCoords(Candidates[Head]);
+                for (auto& Direction : SDirection::All())
+                {
+                    auto const NeighborCoords = Coords + Direction.GetVector<int>();
+                    if (IsEdgeOpaque(*this, Coords, Direction) || !IsInView(NeighborCoords) || Queued.test(CoordsToIndex(NeighborCoords)))
+                    {
+                        continue;
+                    }
+                    Queued.set(CoordsToIndex(NeighborCoords));
+                    Candidates[CandidateCount++] = (uint16_t)CoordsToIndex(NeighborCoords);
+                }
+            }
+
+            auto DistanceSquared = [&](uint16_t CandidateIndex) {
+                auto const Relative = IndexToCoords(CandidateIndex) - EyeCoords;
+                return (Relative.X * Relative.X) + (Relative.Y * Relative.Y);
+            };
+            std::sort(Candidates.begin(), Candidates.begin() + CandidateCount, [&](uint16_t A, uint16_t B) {
+                auto const DistanceA = DistanceSquared(A);
+                auto const DistanceB = DistanceSquared(B);
+                return DistanceA != DistanceB ? DistanceA < DistanceB : A < B;
+            });
+
+            for (int CandidateIndex = 0; CandidateIndex < CandidateCount; ++CandidateIndex)
+            {
+                auto const TargetCoords = IndexToCoords(Candidates[CandidateIndex]);
+                bool bVisible = false;
+                for (int EyeSample = 0; EyeSample < (int)std::size(EyeSamples) && !bVisible; ++EyeSample)
+                {
+                    for (int TargetSample = 0; TargetSample < (int)std::size(TargetSamples) && !bVisible; ++TargetSample)
+                    {
+                        bVisible = IsSightLineClear(*this,
+                            SVec2{ (float)EyeCoords.X, (float)EyeCoords.Y } + EyeSamples[EyeSample],
+                            SVec2{ (float)TargetCoords.X, (float)TargetCoords.Y } + TargetSamples[TargetSample]);
+                    }
+                }
+                if (bVisible)
+                {
+                    VisibleSets.push_back(Candidates[CandidateIndex]);
+                }
+            }
+        }
+    }
+    VisibleSetOffsets.push_back((uint32_t)VisibleSets.size());
+}
+
+bool STilemap::IsInVisibleSetView(const SVec2Int& Eye, SDirection Direction, const SVec2Int& Target)
+{
+    auto const Forward = Direction.GetVector<int>();
+    auto const Relative = Target - Eye;
+    auto const ForwardDistance = (Relative.X * Forward.X) + (Relative.Y * Forward.Y);
+    auto const SideDistance = std::abs((Relative.X * Forward.Y) - (Relative.Y * Forward.X));
+    return ForwardDistance >= -1 && ForwardDistance <= VisibilityDistance && SideDistance <= std::max(ForwardDistance, 0) + 2;
+}
+
+bool STilemap::IsInPortalView(const SVec2Int& Eye, SDirection Direction, float HalfFieldOfView, const SVec2Int& Target)
+{
+    /* The eye tile and the tile behind are always walked. */
+    auto const Step = Direction.GetVector<int>();
+    if (Target == Eye || Target == Eye - Step)
+    {
+        return true;
+    }
+    auto const Relative = Target - Eye;
+    auto const ForwardDistance = (Relative.X * Step.X) + (Relative.Y * Step.Y);
+    if (ForwardDistance < 0 || ForwardDistance > VisibilityDistance)
+    {
+        return false;
+    }
+
+    /* Same eyes and angles as FindVisibleTiles(), the tile is in view if the angles of its corners overlap it. */
+    auto const Forward = Direction.GetVector<float>();
+    auto const Side = SVec2{ -Forward.Y, Forward.X };
+    auto const View = std::min(HalfFieldOfView, Math::HalfPI);
+    for (auto EyeOffset : { 0.0f, -0.45f })
+    {
+        auto const EyePosition = SVec2{ (float)Eye.X, (float)Eye.Y } + (Forward * EyeOffset);
+        auto MinAngle = Math::PI;
+        auto MaxAngle = -Math::PI;
+        for (auto& Corner : { SVec2{ -0.5f, -0.5f }, SVec2{ 0.5f, -0.5f }, SVec2{ 0.5f, 0.5f }, SVec2{ -0.5f, 0.5f } })
+        {
+            auto const Point = SVec2{ (float)Target.X, (float)Target.Y } + Corner - EyePosition;
+            auto const Angle = std::atan2((Point.X * Side.X) + (Point.Y * Side.Y), (Point.X * Forward.X) + (Point.Y * Forward.Y));
+            MinAngle = std::min(MinAngle, Angle);
+            MaxAngle = std::max(MaxAngle, Angle);
+        }
+        if (MinAngle < View && MaxAngle > -View)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int STilemap::FindVisibleTiles(const SVec2Int& Coords, SDirection Direction, float HalfFieldOfView, const SDrawDoorInfo* OpenDoor,
+    std::array<uint16_t, MAX_LEVEL_TILE_COUNT>& VisibleTiles) const
+{
+    if (!IsValidTile(Coords))
+    {
+        return 0;
+    }
+
+    auto IsPortal = [&](const SVec2Int& CellCoords, SDirection EdgeDirection) {
+        if (!IsEdgeOpaque(*this, CellCoords, EdgeDirection))
+        {
+            return true;
+        }
+        if (OpenDoor == nullptr || GetTileAt(CellCoords + EdgeDirection.GetVector<int>()) == nullptr)
+        {
+            return false;
+        }
+        auto const bDoor = GetTileAt(CellCoords)->CheckEdgeFlag(TILE_EDGE_DOOR_BIT, EdgeDirection);
+        auto const bOpenDoorEdge = (CellCoords == OpenDoor->TileCoords && EdgeDirection == OpenDoor->Direction) ||
+            (CellCoords + EdgeDirection.GetVector<int>() == OpenDoor->TileCoords && EdgeDirection.Inverted() == OpenDoor->Direction);
+        return bDoor && bOpenDoorEdge;
+    };
+
+    auto const Forward = Direction.GetVector<float>();
+    auto const Side = SVec2{ -Forward.Y, Forward.X };
+    std::bitset<MAX_LEVEL_TILE_COUNT> Visible{};
+
+    /* The eye is somewhere between the tile behind and this one while stepping, so the view is walked from the
+     * tile center and from close to its back edge. */
+    for (auto EyeOffset : { 0.0f, -0.45f })
+    {
+        auto const Eye = SVec2{ (float)Coords.X, (float)Coords.Y } + (Forward * EyeOffset);
+
+        /* Angle of a point seen from the eye, 0 straight ahead and positive towards Side. */
+        auto AngleTo = [&](const SVec2& Point) {
+            auto const Relative = Point - Eye;
+            return std::atan2((Relative.X * Side.X) + (Relative.Y * Side.Y), (Relative.X * Forward.X) + (Relative.Y * Forward.Y));
+        };
+
+        /* Every step leads away from the eye, so the breadth first walk reaches all the edges into a tile before
+         * it leaves that tile. A tile keeps the hull of the views it's reached with. */
+        std::array<SVec2, MAX_LEVEL_TILE_COUNT> Views{};
+        std::bitset<MAX_LEVEL_TILE_COUNT> Reached{};
+        std::array<uint16_t, MAX_LEVEL_TILE_COUNT> Queue{};
+        int QueueHead = 0;
+        int QueueTail = 0;
+
+        auto const StartIndex = CoordsToIndex(Coords);
+        Views[StartIndex] = { -std::min(HalfFieldOfView, Math::HalfPI), std::min(HalfFieldOfView, Math::HalfPI) };
+        Reached.set(StartIndex);
+        Queue[QueueTail++] = (uint16_t)StartIndex;
+
+        while (QueueHead < QueueTail)
+        {
+            auto const CellIndex = Queue[QueueHead++];
+            auto const CellCoords = IndexToCoords(CellIndex);
+            auto const View = Views[CellIndex];
+            Visible.set(CellIndex);
+
+            for (auto& EdgeDirection : SDirection::All())
+            {
+                auto const Normal = EdgeDirection.GetVector<float>();
+                auto const EdgeCenter = SVec2{ (float)CellCoords.X, (float)CellCoords.Y } + (Normal * 0.5f);
+                auto const NeighborCoords = CellCoords + EdgeDirection.GetVector<int>();
+
+                /* Only edges facing away from the eye, the others lead back where the walk came from. Nothing behind
+                 * the eye's row is walked, that keeps every edge on one side of the angle wraparound. */
+                auto const Facing = ((EdgeCenter.X - Eye.X) * Normal.X) + ((EdgeCenter.Y - Eye.Y) * Normal.Y);
+                auto const ForwardDistance = ((float)(NeighborCoords.X - Coords.X) * Forward.X) + ((float)(NeighborCoords.Y - Coords.Y) * Forward.Y);
+                if (Facing <= 0.0f || ForwardDistance < 0.0f || ForwardDistance > (float)VisibilityDistance || !IsPortal(CellCoords, EdgeDirection))
+                {
+                    continue;
+                }
+
+                auto const Tangent = SVec2{ -Normal.Y, Normal.X } * 0.5f;
+                auto const AngleA = AngleTo(EdgeCenter + Tangent);
+                auto const AngleB = AngleTo(EdgeCenter - Tangent);
+                auto const PortalView = SVec2{ std::max(View.X, std::min(AngleA, AngleB)), std::min(View.Y, std::max(AngleA, AngleB)) };
+                if (PortalView.Y - PortalView.X <= 0.0001f)
+                {
+                    continue;
+                }
+
+                auto const NeighborIndex = CoordsToIndex(NeighborCoords);
+                if (!Reached.test(NeighborIndex))
+                {
+                    Reached.set(NeighborIndex);
+                    Views[NeighborIndex] = PortalView;
+                    Queue[QueueTail++] = (uint16_t)NeighborIndex;
+                }
+                else
+                {
+                    Views[NeighborIndex] = { std::min(Views[NeighborIndex].X, PortalView.X), std::max(Views[NeighborIndex].Y, PortalView.Y) };
+                }
+            }
+        }
+    }
+
+    /* The tile behind, the eye may still be there. */
+    if (IsPortal(Coords, Direction.Inverted()))
+    {
+        Visible.set(CoordsToIndex(Coords - Direction.GetVector<int>()));
+    }
+
+    int Count = 0;
+    auto DistanceSquared = [&](uint16_t TileIndex) {
+        auto const Relative = IndexToCoords(TileIndex) - Coords;
+        return (Relative.X * Relative.X) + (Relative.Y * Relative.Y);
+    };
+    for (std::size_t Index = 0; Index < TileCount(); ++Index)
+    {
+        if (Visible.test(Index))
+        {
+            VisibleTiles[Count++] = (uint16_t)Index;
+        }
+    }
+    std::sort(VisibleTiles.begin(), VisibleTiles.begin() + Count, [&](uint16_t A, uint16_t B) {
+        auto const DistanceA = DistanceSquared(A);
+        auto const DistanceB = DistanceSquared(B);
+        return DistanceA != DistanceB ? DistanceA < DistanceB : A < B;
+    });
+    return Count;
+}
+
 void STilemap::PostProcess()
 {
+    BuildVisibleSets();
+
     WallJoints.reset();
     if (!bUseWallJoints)
     {
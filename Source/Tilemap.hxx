@@ -3,6 +3,7 @@
 #include <array>
 #include <bitset>
 #include "Math.hxx"
+#include "Memory.hxx"
 #include "Tile.hxx"
 #include "SharedConstants.hxx"
 
@@ -42,6 +43,9 @@ namespace ELevelDirtyFlags
     };
 }
 
+/* How many tiles ahead potentially visible sets reach, they widen by one tile to each side per tile forward. */
+inline constexpr int VisibilityDistance = 8;
+
 struct STilemap
 {
     int32_t Width{};
@@ -50,6 +54,12 @@ struct STilemap
     std::bitset<(MAX_LEVEL_WIDTH + 1) * (MAX_LEVEL_HEIGHT + 1)> WallJoints{};
     uint32_t bUseWallJoints = true;
 
+    /* Potentially visible sets built by PostProcess(): for every tile and direction, the indices of the tiles that
+     * can be seen from it, nearest first. Set (Index * SDirection::Count) + Direction spans from VisibleSetOffsets
+     * of itself to the next one. */
+    std::pmr::vector<uint32_t> VisibleSetOffsets{ Memory::GetPoolResource() };
+    std::pmr::vector<uint16_t> VisibleSets{ Memory::GetPoolResource() };
+
     [[nodiscard]] uint32_t TileCount() const { return Width * Height; }
 
     [[nodiscard]] STile* GetTileAtMutable(const SVec2Int& Coords)
@@ -156,6 +166,37 @@ struct STilemap
 
     void PostProcess();
 
+    /* Builds VisibleSets, walls and doors block sight. */
+    void BuildVisibleSets();
+
+    /* Returns nullptr if the sets aren't built. */
+    [[nodiscard]] const uint16_t* GetVisibleSet(const SVec2Int& Coords, SDirection Direction, int& Count) const
+    {
+        auto SetIndex = (CoordsToIndex(Coords) * SDirection::Count) + Direction.Index;
+        if (!IsValidTile(Coords) || SetIndex + 1 >= VisibleSetOffsets.size())
+        {
+            Count = 0;
+            return nullptr;
+        }
+        Count = (int)(VisibleSetOffsets[SetIndex + 1] - VisibleSetOffsets[SetIndex]);
+        return VisibleSets.data() + VisibleSetOffsets[SetIndex];
+    }
+
+    /* Whether Target is a candidate for the visible set of Eye looking towards Direction, see BuildVisibleSets(). */
+    [[nodiscard]] static bool IsInVisibleSetView(const SVec2Int& Eye, SDirection Direction, const SVec2Int& Target);
+
+    /* Whether FindVisibleTiles() from Eye could reach Target if nothing blocked sight. */
+    [[nodiscard]] static bool IsInPortalView(const SVec2Int& Eye, SDirection Direction, float HalfFieldOfView, const SVec2Int& Target);
+
+    /* Cell and portal visibility: walks from the tile at Coords through open edges, narrowing the view to each edge
+     * it crosses, up to VisibilityDistance tiles ahead. The view starts HalfFieldOfView to each side of Direction.
+     * OpenDoor is crossed like an open edge, the other doors block sight. Writes the indices of the visible tiles,
+     * nearest first, and returns how many there are. */
+    int FindVisibleTiles(const SVec2Int& Coords, SDirection Direction, float HalfFieldOfView, const SDrawDoorInfo* OpenDoor,
+        std::array<uint16_t, MAX_LEVEL_TILE_COUNT>& VisibleTiles) const;
+
+    [[nodiscard]] SVec2Int IndexToCoords(std::size_t Index) const { return { (int)(Index % Width), (int)(Index / Width) }; }
+
     void ToggleEdge(const SVec2Int& Coords, SDirection Direction, UFlagType NorthEdgeBit);
 
     void Edit(const SVec2Int& Coords, ETileFlag Flag, bool bHandleEdges = true);
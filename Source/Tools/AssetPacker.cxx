@@ -0,0 +1,179 @@
+/* Builds the asset pack that release builds map instead of embedding assets with INCBIN, runs at build time.
+ * Usage: EquinoxReachAssetPacker <output.erpk> [--root <directory>] <relative path>...
+ * Entries are named by their path relative to the last --root, e.g. "Shader/HUD.vert", which is what DEFINE_ASSET
+ * looks up. Entries up to MaxCompressedLength are compressed when that saves at least an eighth of their size, larger
+ * ones are stored as is so the game maps them instead of inflating them into the heap on mount. */
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "AssetPack.hxx"
+#include "Compression.hxx"
+
+struct SInputEntry
+{
+    std::string Name;
+    std::vector<uint8_t> Stored;
+    uint64_t Offset{};
+    uint32_t Length{};
+    uint32_t Flags{};
+};
+
+static bool ReadFile(const std::string& Path, std::vector<uint8_t>& Contents)
+{
+    std::FILE* File = std::fopen(Path.c_str(), "rb");
+    if (File == nullptr)
+    {
+        std::printf("Failed to open %s\n", Path.c_str());
+        return false;
+    }
+
+    std::fseek(File, 0, SEEK_END);
+    auto Length = std::ftell(File);
+    std::fseek(File, 0, SEEK_SET);
+
+    Contents.resize(static_cast<std::size_t>(Length));
+    bool bRead = Length == 0 || std::fread(Contents.data(), Contents.size(), 1, File) == 1;
+    std::fclose(File);
+
+    if (!bRead)
+    {
+        std::printf("Failed to read %s\n", Path.c_str());
+    }
+    return bRead;
+}
+
+static constexpr std::size_t MaxCompressedLength = 64 * 1024;
+
+static uint64_t Align(uint64_t Offset)
+{
+    return (Offset + AssetPackAlignment - 1) & ~uint64_t(AssetPackAlignment - 1);
+}
+
+int main(int ArgCount, char** Args)
+{
+    if (ArgCount < 3)
+    {
+        std::printf("Usage: EquinoxReachAssetPacker <output.erpk> [--root <directory>] <relative path>...\n");
+        return 1;
+    }
+
+    const char* OutputPath = Args[1];
+    std::filesystem::path Root;
+    std::vector<SInputEntry> Entries;
+    std::size_t TotalLength = 0;
+
+    for (int Index = 2; Index < ArgCount; ++Index)
+    {
+        if (std::strcmp(Args[Index], "--root") == 0 && Index + 1 < ArgCount)
+        {
+            Root = Args[++Index];
+            continue;
+        }
+
+        auto& Entry = Entries.emplace_back();
+        Entry.Name = Args[Index];
+        std::vector<uint8_t> Contents;
+        if (!ReadFile((Root / Entry.Name).string(), Contents))
+        {
+            return 1;
+        }
+        if (Contents.size() > UINT32_MAX)
+        {
+            std::printf("%s is too large for an asset pack entry\n", Entry.Name.c_str());
+            return 1;
+        }
+
+        Entry.Length = static_cast<uint32_t>(Contents.size());
+        TotalLength += Contents.size();
+
+        std::vector<uint8_t> Compressed;
+        if (Contents.size() <= MaxCompressedLength)
+        {
+            Compressed.resize(Compression::CompressBound(Contents.size()));
+            Compressed.resize(Compression::Compress(Contents.data(), Contents.size(), Compressed.data()));
+        }
+        if (!Compressed.empty() && Compressed.size() <= Contents.size() - (Contents.size() / 8))
+        {
+            Entry.Stored = std::move(Compressed);
+            Entry.Flags |= ASSET_PACK_ENTRY_COMPRESSED;
+        }
+        else
+        {
+            Entry.Stored = std::move(Contents);
+        }
+    }
+
+    SAssetPackHeader Header{};
+    Header.EntryCount = static_cast<uint32_t>(Entries.size());
+    Header.TableSize = 16;
+    while (Header.TableSize < Header.EntryCount * 2)
+    {
+        Header.TableSize *= 2;
+    }
+
+    std::vector<SAssetPackEntry> Table(Header.TableSize);
+    std::string Names;
+    uint64_t NamesOffset = sizeof(SAssetPackHeader) + (sizeof(SAssetPackEntry) * Table.size());
+    for (const auto& Entry : Entries)
+    {
+        Names += Entry.Name;
+        Names += '\0';
+    }
+
+    uint64_t Offset = Align(NamesOffset + Names.size());
+    uint64_t NameOffset = NamesOffset;
+    for (auto& Entry : Entries)
+    {
+        auto Hash = HashAssetPath(Entry.Name.c_str());
+        auto Slot = Hash & (Header.TableSize - 1);
+        while (Table[Slot].Hash != 0)
+        {
+            if (Table[Slot].Hash == Hash)
+            {
+                std::printf("%s is in the asset pack twice or collides with another entry\n", Entry.Name.c_str());
+                return 1;
+            }
+            Slot = (Slot + 1) & (Header.TableSize - 1);
+        }
+
+        Entry.Offset = Offset;
+        Table[Slot] = { Hash, Offset, static_cast<uint32_t>(Entry.Stored.size()), Entry.Length, static_cast<uint32_t>(NameOffset), Entry.Flags };
+        NameOffset += Entry.Name.size() + 1;
+        /* Every entry is followed by at least one zero byte, like INCBIN does. */
+        Offset = Align(Offset + Entry.Stored.size() + 1);
+    }
+
+    std::error_code Error;
+    std::filesystem::create_directories(std::filesystem::path(OutputPath).parent_path(), Error);
+
+    std::FILE* File = std::fopen(OutputPath, "wb");
+    if (File == nullptr)
+    {
+        std::printf("Failed to create %s\n", OutputPath);
+        return 1;
+    }
+
+    std::vector<uint8_t> Pack(Offset);
+    std::memcpy(Pack.data(), &Header, sizeof(Header));
+    std::memcpy(Pack.data() + sizeof(Header), Table.data(), sizeof(SAssetPackEntry) * Table.size());
+    std::memcpy(Pack.data() + NamesOffset, Names.data(), Names.size());
+    for (const auto& Entry : Entries)
+    {
+        std::memcpy(Pack.data() + Entry.Offset, Entry.Stored.data(), Entry.Stored.size());
+    }
+
+    bool bWritten = std::fwrite(Pack.data(), Pack.size(), 1, File) == 1;
+    bWritten = std::fclose(File) == 0 && bWritten;
+    if (!bWritten)
+    {
+        std::printf("Failed to write %s\n", OutputPath);
+        std::remove(OutputPath);
+        return 1;
+    }
+
+    std::printf("%s: %zu entries, %zu bytes of assets packed into %zu bytes\n", OutputPath, Entries.size(), TotalLength, Pack.size());
+    return 0;
+}
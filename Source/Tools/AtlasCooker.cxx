@@ -0,0 +1,330 @@
+/* Packs PNG sprites into one pre-composited atlas image and generates the matching SSprite UV table, runs at build time.
+ * Usage: EquinoxReachAtlasCooker <name> <output.erat> <output.hxx> <input.png>...
+ * Sprites are placed with MaxRects (best short side fit), the generated header declares one enumerator per input
+ * file stem in namespace CookedAtlas::<name>. */
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "AssetTools.hxx"
+#include "SharedConstants.hxx"
+
+struct SPackRect
+{
+    int X{};
+    int Y{};
+    int Width{};
+    int Height{};
+
+    [[nodiscard]] bool Contains(const SPackRect& Other) const
+    {
+        return Other.X >= X && Other.Y >= Y && Other.X + Other.Width <= X + Width && Other.Y + Other.Height <= Y + Height;
+    }
+
+    [[nodiscard]] bool Intersects(const SPackRect& Other) const
+    {
+        return Other.X < X + Width && Other.X + Other.Width > X && Other.Y < Y + Height && Other.Y + Other.Height > Y;
+    }
+};
+
+/* Keeps the maximal free rectangles of the atlas, placed rectangles split every free rectangle they overlap. */
+class CMaxRectsPacker
+{
+    std::vector<SPackRect> FreeRects;
+
+public:
+    CMaxRectsPacker(int Width, int Height)
+        : FreeRects{ { 0, 0, Width, Height } }
+    {
+    }
+
+    /* Best short side fit, ties are broken by the long side. Returns false if the rectangle doesn't fit anywhere. */
+    bool FindPosition(int Width, int Height, SPackRect& Best, int& BestShortSide, int& BestLongSide) const
+    {
+        bool bFound = false;
+        for (const auto& Free : FreeRects)
+        {
+            if (Free.Width < Width || Free.Height < Height)
+            {
+                continue;
+            }
+
+            int LeftoverX = Free.Width - Width;
+            int LeftoverY = Free.Height - Height;
+            int ShortSide = std::min(LeftoverX, LeftoverY);
+            int LongSide = std::max(LeftoverX, LeftoverY);
+            if (ShortSide < BestShortSide || (ShortSide == BestShortSide && LongSide < BestLongSide))
+            {
+                Best = { Free.X, Free.Y, Width, Height };
+                BestShortSide = ShortSide;
+                BestLongSide = LongSide;
+                bFound = true;
+            }
+        }
+        return bFound;
+    }
+
+    void Place(const SPackRect& Rect)
+    {
+        std::vector<SPackRect> Split;
+        for (auto It = FreeRects.begin(); It != FreeRects.end();)
+        {
+            if (!It->Intersects(Rect))
+            {
+                ++It;
+                continue;
+            }
+
+            auto Free = *It;
+            It = FreeRects.erase(It);
+            if (Rect.X > Free.X)
+            {
+                Split.push_back({ Free.X, Free.Y, Rect.X - Free.X, Free.Height });
+            }
+            if (Rect.X + Rect.Width < Free.X + Free.Width)
+            {
+                Split.push_back({ Rect.X + Rect.Width, Free.Y, Free.X + Free.Width - (Rect.X + Rect.Width), Free.Height });
+            }
+            if (Rect.Y > Free.Y)
+            {
+                Split.push_back({ Free.X, Free.Y, Free.Width, Rect.Y - Free.Y });
+            }
+            if (Rect.Y + Rect.Height < Free.Y + Free.Height)
+            {
+                Split.push_back({ Free.X, Rect.Y + Rect.Height, Free.Width, Free.Y + Free.Height - (Rect.Y + Rect.Height) });
+            }
+        }
+        FreeRects.insert(FreeRects.end(), Split.begin(), Split.end());
+
+        /* Drop free rectangles that are contained in another one. */
+        for (std::size_t Index = 0; Index < FreeRects.size(); ++Index)
+        {
+            for (std::size_t Other = Index + 1; Other < FreeRects.size(); ++Other)
+            {
+                if (FreeRects[Other].Contains(FreeRects[Index]))
+                {
+                    FreeRects.erase(FreeRects.begin() + (std::ptrdiff_t)Index);
+                    --Index;
+                    break;
+                }
+                if (FreeRects[Index].Contains(FreeRects[Other]))
+                {
+                    FreeRects.erase(FreeRects.begin() + (std::ptrdiff_t)Other);
+                    --Other;
+                }
+            }
+        }
+    }
+};
+
+struct SInputSprite
+{
+    std::string Name;
+    CRawImage Image;
+    SPackRect Rect;
+    bool bPlaced{};
+};
+
+static bool ReadFile(const char* Path, std::vector<char>& Contents)
+{
+    std::FILE* File = std::fopen(Path, "rb");
+    if (File == nullptr)
+    {
+        std::printf("Failed to open %s\n", Path);
+        return false;
+    }
+
+    std::fseek(File, 0, SEEK_END);
+    auto Length = std::ftell(File);
+    std::fseek(File, 0, SEEK_SET);
+
+    Contents.resize(static_cast<std::size_t>(Length));
+    bool bRead = Length == 0 || std::fread(Contents.data(), Contents.size(), 1, File) == 1;
+    std::fclose(File);
+
+    if (!bRead)
+    {
+        std::printf("Failed to read %s\n", Path);
+    }
+    return bRead;
+}
+
+static bool IsIdentifier(const std::string& Name)
+{
+    if (Name.empty() || std::isdigit(static_cast<unsigned char>(Name[0])))
+    {
+        return false;
+    }
+    return std::all_of(Name.begin(), Name.end(), [](char Char) { return std::isalnum(static_cast<unsigned char>(Char)) || Char == '_'; });
+}
+
+static bool WriteAtlas(const char* Path, const std::vector<SInputSprite>& Sprites, int Width, int Height)
+{
+    SCookedAtlasHeader Header{};
+    Header.Width = static_cast<uint32_t>(Width);
+    Header.Height = static_cast<uint32_t>(Height);
+    Header.SpriteCount = static_cast<uint32_t>(Sprites.size());
+
+    std::vector<unsigned char> Pixels(std::size_t(Width) * Height * 4);
+    for (const auto& Sprite : Sprites)
+    {
+        auto RowLength = std::size_t(Sprite.Rect.Width) * 4;
+        for (int Row = 0; Row < Sprite.Rect.Height; ++Row)
+        {
+            auto* Source = static_cast<const unsigned char*>(Sprite.Image.Data) + (RowLength * Row);
+            auto* Destination = Pixels.data() + (((std::size_t(Sprite.Rect.Y + Row) * Width) + Sprite.Rect.X) * 4);
+            std::memcpy(Destination, Source, RowLength);
+        }
+    }
+
+    std::FILE* File = std::fopen(Path, "wb");
+    if (File == nullptr)
+    {
+        std::printf("Failed to create %s\n", Path);
+        return false;
+    }
+
+    bool bWritten = std::fwrite(&Header, sizeof(Header), 1, File) == 1;
+    bWritten = bWritten && (Pixels.empty() || std::fwrite(Pixels.data(), Pixels.size(), 1, File) == 1);
+    bWritten = std::fclose(File) == 0 && bWritten;
+    if (!bWritten)
+    {
+        std::printf("Failed to write %s\n", Path);
+        std::remove(Path);
+    }
+    return bWritten;
+}
+
+static bool WriteTable(const char* Path, const char* AtlasName, const std::vector<SInputSprite>& Sprites)
+{
+    std::FILE* File = std::fopen(Path, "wb");
+    if (File == nullptr)
+    {
+        std::printf("Failed to create %s\n", Path);
+        return false;
+    }
+
+    std::fprintf(File, "/* Generated by EquinoxReachAtlasCooker, do not edit. */\n\n");
+    std::fprintf(File, "#pragma once\n\n#include \"Draw.hxx\"\n\n");
+    std::fprintf(File, "namespace CookedAtlas::%s\n{\n", AtlasName);
+    std::fprintf(File, "    enum\n    {\n");
+    for (const auto& Sprite : Sprites)
+    {
+        std::fprintf(File, "        %s,\n", Sprite.Name.c_str());
+    }
+    std::fprintf(File, "        Count\n    };\n\n");
+
+    std::fprintf(File, "    inline constexpr SSprite Sprites[Count] = {\n");
+    for (const auto& Sprite : Sprites)
+    {
+        const auto& Rect = Sprite.Rect;
+        std::fprintf(File, "        { { %.9ff, %.9ff, %.9ff, %.9ff }, { %d, %d } },\n",
+            float(Rect.X) / float(ATLAS_SIZE), float(Rect.Y) / float(ATLAS_SIZE),
+            float(Rect.X + Rect.Width) / float(ATLAS_SIZE), float(Rect.Y + Rect.Height) / float(ATLAS_SIZE),
+            Rect.Width, Rect.Height);
+    }
+    std::fprintf(File, "    };\n}\n");
+
+    bool bWritten = std::ferror(File) == 0;
+    bWritten = std::fclose(File) == 0 && bWritten;
+    if (!bWritten)
+    {
+        std::printf("Failed to write %s\n", Path);
+        std::remove(Path);
+    }
+    return bWritten;
+}
+
+int main(int ArgCount, char** Args)
+{
+    if (ArgCount < 5)
+    {
+        std::printf("Usage: EquinoxReachAtlasCooker <name> <output.erat> <output.hxx> <input.png>...\n");
+        return 1;
+    }
+
+    const char* AtlasName = Args[1];
+    const char* AtlasPath = Args[2];
+    const char* TablePath = Args[3];
+
+    std::vector<SInputSprite> Sprites;
+    for (int Index = 4; Index < ArgCount; ++Index)
+    {
+        std::vector<char> PNG;
+        if (!ReadFile(Args[Index], PNG))
+        {
+            return 1;
+        }
+
+        auto& Sprite = Sprites.emplace_back();
+        Sprite.Name = std::filesystem::path(Args[Index]).stem().string();
+        Sprite.Image = CRawImage{ SAsset{ PNG.data(), PNG.size() } };
+        if (Sprite.Image.Data == nullptr)
+        {
+            std::printf("%s: failed to decode\n", Args[Index]);
+            return 1;
+        }
+        if (!IsIdentifier(Sprite.Name))
+        {
+            std::printf("%s: file name is not a valid C++ identifier\n", Args[Index]);
+            return 1;
+        }
+        Sprite.Rect.Width = Sprite.Image.Width;
+        Sprite.Rect.Height = Sprite.Image.Height;
+    }
+
+    /* Place the sprite with the best fit among all remaining ones each round. */
+    CMaxRectsPacker Packer(ATLAS_SIZE, ATLAS_SIZE);
+    for (std::size_t Placed = 0; Placed < Sprites.size(); ++Placed)
+    {
+        SInputSprite* BestSprite{};
+        SPackRect BestRect{};
+        int BestShortSide = INT_MAX;
+        int BestLongSide = INT_MAX;
+        for (auto& Sprite : Sprites)
+        {
+            if (!Sprite.bPlaced && Packer.FindPosition(Sprite.Rect.Width, Sprite.Rect.Height, BestRect, BestShortSide, BestLongSide))
+            {
+                BestSprite = &Sprite;
+            }
+        }
+
+        if (BestSprite == nullptr)
+        {
+            for (const auto& Sprite : Sprites)
+            {
+                if (!Sprite.bPlaced)
+                {
+                    std::printf("%s: %s (%dx%d) doesn't fit into the %ux%u atlas\n", AtlasName, Sprite.Name.c_str(), Sprite.Rect.Width, Sprite.Rect.Height, ATLAS_SIZE, ATLAS_SIZE);
+                }
+            }
+            return 1;
+        }
+
+        BestSprite->Rect = BestRect;
+        BestSprite->bPlaced = true;
+        Packer.Place(BestRect);
+    }
+
+    int UsedHeight = 0;
+    for (const auto& Sprite : Sprites)
+    {
+        UsedHeight = std::max(UsedHeight, Sprite.Rect.Y + Sprite.Rect.Height);
+    }
+
+    std::error_code Error;
+    std::filesystem::create_directories(std::filesystem::path(AtlasPath).parent_path(), Error);
+    std::filesystem::create_directories(std::filesystem::path(TablePath).parent_path(), Error);
+
+    if (!WriteAtlas(AtlasPath, Sprites, ATLAS_SIZE, UsedHeight) || !WriteTable(TablePath, AtlasName, Sprites))
+    {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,614 @@
+/* Offline benchmarks for engine subsystems, runs without SDL or a GL context.
+ * Usage: EquinoxReachBenchmark memory <trace.ermt>
+ *        EquinoxReachBenchmark mesh [triangles]
+ *        EquinoxReachBenchmark parse [triangles] */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AssetTools.hxx"
+#include "Memory.hxx"
+#include "Utility.hxx"
+
+using SClock = std::chrono::steady_clock;
+
+static uint64_t NanosecondsSince(SClock::time_point Start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(SClock::now() - Start).count();
+}
+
+struct SLatencies
+{
+    std::vector<uint32_t> Samples;
+
+    void Add(uint64_t Nanoseconds)
+    {
+        Samples.push_back(static_cast<uint32_t>(std::min<uint64_t>(Nanoseconds, UINT32_MAX)));
+    }
+
+    [[nodiscard]] uint32_t Percentile(double Fraction) const
+    {
+        return Samples.empty() ? 0 : Samples[std::min(Samples.size() - 1, static_cast<std::size_t>(Fraction * double(Samples.size())))];
+    }
+
+    void Print(const char* Name)
+    {
+        std::sort(Samples.begin(), Samples.end());
+        std::printf("    %-12s %9zu ops   p50 %6u ns   p99 %6u ns   p99.9 %6u ns   max %8u ns\n",
+            Name, Samples.size(), Percentile(0.5), Percentile(0.99), Percentile(0.999), Samples.empty() ? 0 : Samples.back());
+    }
+};
+
+namespace MemoryBenchmark
+{
+    struct SOperation
+    {
+        EAllocationEvent Type{};
+        EMemoryCategory Category{};
+        uint32_t Slot{};
+        uint32_t Size{};
+        uint32_t Alignment{};
+    };
+
+    struct STrace
+    {
+        std::vector<SOperation> Operations;
+        std::size_t SlotCount{};
+        std::size_t PeakRequestedBytes{};
+        uint64_t Duration{};
+    };
+
+    /* Pointers are turned into dense slots up front, so the replay itself does no hashing.
+     * Blocks allocated before the trace was started are skipped. */
+    static bool LoadTrace(const char* Path, STrace& Trace)
+    {
+        std::FILE* File = std::fopen(Path, "rb");
+        if (File == nullptr)
+        {
+            std::printf("Failed to open %s\n", Path);
+            return false;
+        }
+
+        SAllocationTraceHeader Header{};
+        if (std::fread(&Header, sizeof(Header), 1, File) != 1 || Header.Magic != SAllocationTraceHeader::CurrentMagic || Header.Version != SAllocationTraceHeader::CurrentVersion)
+        {
+            std::printf("%s is not a version %u allocation trace\n", Path, SAllocationTraceHeader::CurrentVersion);
+            std::fclose(File);
+            return false;
+        }
+
+        std::unordered_map<uint64_t, uint32_t> LiveSlots;
+        std::vector<uint32_t> FreeSlots;
+        std::vector<uint32_t> SlotSizes;
+        std::size_t RequestedBytes{};
+
+        auto AcquireSlot = [&]() {
+            if (!FreeSlots.empty())
+            {
+                auto Slot = FreeSlots.back();
+                FreeSlots.pop_back();
+                return Slot;
+            }
+            SlotSizes.push_back(0);
+            return static_cast<uint32_t>(SlotSizes.size() - 1);
+        };
+
+        SAllocationTraceEvent Event{};
+        while (std::fread(&Event, sizeof(Event), 1, File) == 1)
+        {
+            Trace.Duration = Event.Timestamp;
+
+            SOperation Operation{};
+            Operation.Type = Event.Type;
+            Operation.Category = Event.Category;
+            Operation.Size = Event.Size;
+            Operation.Alignment = 1u << Event.AlignmentLog2;
+
+            if (Event.Type == EAllocationEvent::Reallocate)
+            {
+                auto Found = LiveSlots.find(Event.OldPtr);
+                if (Found == LiveSlots.end())
+                {
+                    /* Reallocating something from before the trace behaves like a new allocation. */
+                    Operation.Type = EAllocationEvent::Allocate;
+                }
+                else
+                {
+                    Operation.Slot = Found->second;
+                    LiveSlots.erase(Found);
+                    RequestedBytes -= SlotSizes[Operation.Slot];
+                }
+            }
+
+            if (Event.Type == EAllocationEvent::Free)
+            {
+                auto Found = LiveSlots.find(Event.Ptr);
+                if (Found == LiveSlots.end())
+                {
+                    continue;
+                }
+                Operation.Slot = Found->second;
+                RequestedBytes -= SlotSizes[Operation.Slot];
+                FreeSlots.push_back(Operation.Slot);
+                LiveSlots.erase(Found);
+            }
+            else
+            {
+                if (Operation.Type == EAllocationEvent::Allocate)
+                {
+                    Operation.Slot = AcquireSlot();
+                }
+                LiveSlots[Event.Ptr] = Operation.Slot;
+                SlotSizes[Operation.Slot] = Event.Size;
+                RequestedBytes += Event.Size;
+                Trace.PeakRequestedBytes = std::max(Trace.PeakRequestedBytes, RequestedBytes);
+            }
+
+            Trace.Operations.push_back(Operation);
+        }
+
+        std::fclose(File);
+        Trace.SlotCount = SlotSizes.size();
+
+        return true;
+    }
+
+    /* Counts what a resource asks from its upstream, used as its footprint. */
+    class CCountingResource final : public std::pmr::memory_resource
+    {
+        std::pmr::memory_resource* Upstream{};
+
+        void* do_allocate(size_t Bytes, size_t Alignment) override
+        {
+            Current += Bytes;
+            Peak = std::max(Peak, Current);
+            return Upstream->allocate(Bytes, Alignment);
+        }
+
+        void do_deallocate(void* Ptr, size_t Bytes, size_t Alignment) override
+        {
+            Current -= Bytes;
+            Upstream->deallocate(Ptr, Bytes, Alignment);
+        }
+
+        [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& Other) const noexcept override
+        {
+            return this == &Other;
+        }
+
+    public:
+        std::size_t Current{};
+        std::size_t Peak{};
+
+        explicit CCountingResource(std::pmr::memory_resource* InUpstream)
+            : Upstream(InUpstream)
+        {
+        }
+    };
+
+    struct SReplayTarget
+    {
+        const char* Name{};
+
+        virtual ~SReplayTarget() = default;
+        virtual void* Allocate(std::size_t Bytes, std::size_t Alignment, EMemoryCategory Category) = 0;
+        virtual void* Reallocate(void* Ptr, std::size_t OldBytes, std::size_t Bytes, EMemoryCategory Category) = 0;
+        virtual void Free(void* Ptr, std::size_t Bytes, std::size_t Alignment) = 0;
+        virtual std::size_t Footprint() = 0;
+    };
+
+    /* The global inline resource, exactly as the game uses it. */
+    struct SInlineTarget final : SReplayTarget
+    {
+        CInlineResource* Resource = static_cast<CInlineResource*>(Memory::GetInlineResource());
+
+        SInlineTarget() { Name = "inline"; }
+
+        void* Allocate(std::size_t Bytes, std::size_t Alignment, EMemoryCategory Category) override
+        {
+            return Resource->Allocate(Bytes, Alignment, Category);
+        }
+
+        void* Reallocate(void* Ptr, [[maybe_unused]] std::size_t OldBytes, std::size_t Bytes, EMemoryCategory Category) override
+        {
+            return Resource->Reallocate(Ptr, Bytes, Category);
+        }
+
+        void Free(void* Ptr, [[maybe_unused]] std::size_t Bytes, [[maybe_unused]] std::size_t Alignment) override
+        {
+            Resource->Deallocate(Ptr);
+        }
+
+        std::size_t Footprint() override
+        {
+            auto Stats = Memory::GetStats();
+            return Stats.HeapSize + Stats.UpstreamBytesInUse;
+        }
+    };
+
+    /* Any pmr resource; reallocation is emulated with allocate, copy and free. */
+    struct SPmrTarget final : SReplayTarget
+    {
+        CCountingResource Counting;
+        std::pmr::memory_resource* Resource{};
+
+        SPmrTarget(const char* InName, std::pmr::memory_resource* Upstream)
+            : Counting(Upstream)
+        {
+            Name = InName;
+        }
+
+        void* Allocate(std::size_t Bytes, std::size_t Alignment, [[maybe_unused]] EMemoryCategory Category) override
+        {
+            return Resource->allocate(Bytes, Alignment);
+        }
+
+        void* Reallocate(void* Ptr, std::size_t OldBytes, std::size_t Bytes, [[maybe_unused]] EMemoryCategory Category) override
+        {
+            void* NewPtr = Resource->allocate(Bytes, alignof(std::max_align_t));
+            std::memcpy(NewPtr, Ptr, std::min(OldBytes, Bytes));
+            Resource->deallocate(Ptr, OldBytes, alignof(std::max_align_t));
+            return NewPtr;
+        }
+
+        void Free(void* Ptr, std::size_t Bytes, std::size_t Alignment) override
+        {
+            Resource->deallocate(Ptr, Bytes, Alignment);
+        }
+
+        std::size_t Footprint() override
+        {
+            return Counting.Peak;
+        }
+    };
+
+    struct SSlot
+    {
+        void* Ptr{};
+        uint32_t Size{};
+        uint32_t Alignment{};
+    };
+
+    template <bool bMeasureLatency>
+    static void Replay(const STrace& Trace, SReplayTarget& Target, std::vector<SSlot>& Slots, SLatencies* Latencies)
+    {
+        for (const auto& Operation : Trace.Operations)
+        {
+            auto& Slot = Slots[Operation.Slot];
+
+            SClock::time_point Start{};
+            if constexpr (bMeasureLatency)
+            {
+                Start = SClock::now();
+            }
+
+            switch (Operation.Type)
+            {
+                case EAllocationEvent::Allocate:
+                    Slot.Ptr = Target.Allocate(Operation.Size, Operation.Alignment, Operation.Category);
+                    Slot.Size = Operation.Size;
+                    Slot.Alignment = Operation.Alignment;
+                    break;
+                case EAllocationEvent::Reallocate:
+                    Slot.Ptr = Target.Reallocate(Slot.Ptr, Slot.Size, Operation.Size, Operation.Category);
+                    Slot.Size = Operation.Size;
+                    Slot.Alignment = alignof(std::max_align_t);
+                    break;
+                case EAllocationEvent::Free:
+                    Target.Free(Slot.Ptr, Slot.Size, Slot.Alignment);
+                    Slot.Ptr = nullptr;
+                    break;
+            }
+
+            if constexpr (bMeasureLatency)
+            {
+                Latencies[std::size_t(Operation.Type)].Add(NanosecondsSince(Start));
+            }
+        }
+
+        /* Whatever was still alive at the end of the trace. */
+        for (auto& Slot : Slots)
+        {
+            if (Slot.Ptr != nullptr)
+            {
+                Target.Free(Slot.Ptr, Slot.Size, Slot.Alignment);
+                Slot.Ptr = nullptr;
+            }
+        }
+    }
+
+    static void Run(const STrace& Trace, SReplayTarget& Target)
+    {
+        std::vector<SSlot> Slots(Trace.SlotCount);
+
+        /* Throughput is measured without per-operation timers, they cost about as much as an allocation. */
+        auto Start = SClock::now();
+        Replay<false>(Trace, Target, Slots, nullptr);
+        double Seconds = double(NanosecondsSince(Start)) / 1e9;
+
+        SLatencies Latencies[3]{};
+        for (auto& Latency : Latencies)
+        {
+            Latency.Samples.reserve(Trace.Operations.size());
+        }
+        Replay<true>(Trace, Target, Slots, Latencies);
+
+        std::printf("%s: %.2f Mops/s, footprint %zu KB\n", Target.Name, double(Trace.Operations.size()) / Seconds / 1e6, Target.Footprint() / 1024);
+        Latencies[std::size_t(EAllocationEvent::Allocate)].Print("allocate");
+        Latencies[std::size_t(EAllocationEvent::Reallocate)].Print("reallocate");
+        Latencies[std::size_t(EAllocationEvent::Free)].Print("free");
+    }
+
+    static int Main(int ArgCount, char** Args)
+    {
+        if (ArgCount < 1)
+        {
+            std::printf("Usage: EquinoxReachBenchmark memory <trace.ermt>\n");
+            return 1;
+        }
+
+        STrace Trace{};
+        if (!LoadTrace(Args[0], Trace))
+        {
+            return 1;
+        }
+
+        std::printf("%zu operations over %.2f s, %zu live slots at most, peak requested %zu KB\n",
+            Trace.Operations.size(), double(Trace.Duration) / 1e9, Trace.SlotCount, Trace.PeakRequestedBytes / 1024);
+
+        SInlineTarget Inline{};
+        Run(Trace, Inline);
+
+        SPmrTarget Pool{ "pool", Memory::GetInlineResource() };
+        std::pmr::synchronized_pool_resource PoolResource{ &Pool.Counting };
+        Pool.Resource = &PoolResource;
+        Run(Trace, Pool);
+
+        SPmrTarget NewDelete{ "new_delete", std::pmr::new_delete_resource() };
+        NewDelete.Resource = &NewDelete.Counting;
+        Run(Trace, NewDelete);
+
+        return 0;
+    }
+}
+
+namespace MeshBenchmark
+{
+    /* Grid of Size x Size quads, every grid point is a distinct vertex shared by up to six triangles. */
+    static std::string GenerateOBJ(int Size)
+    {
+        std::string OBJ;
+        char Line[96];
+        for (int Y = 0; Y <= Size; ++Y)
+        {
+            for (int X = 0; X <= Size; ++X)
+            {
+                std::snprintf(Line, sizeof(Line), "v %.4f %.4f %.4f\n", float(X) * 0.1f, 0.01f * float((X * 7 + Y * 13) % 17), float(Y) * 0.1f);
+                OBJ += Line;
+                std::snprintf(Line, sizeof(Line), "vt %.5f %.5f\n", float(X) / float(Size), float(Y) / float(Size));
+                OBJ += Line;
+            }
+        }
+        OBJ += "vn 0.0000 1.0000 0.0000\n";
+
+        for (int Y = 0; Y < Size; ++Y)
+        {
+            for (int X = 0; X < Size; ++X)
+            {
+                int A = Y * (Size + 1) + X + 1;
+                int B = A + 1;
+                int C = A + Size + 1;
+                int D = C + 1;
+                std::snprintf(Line, sizeof(Line), "f %d/%d/1 %d/%d/1 %d/%d/1\n", A, A, C, C, B, B);
+                OBJ += Line;
+                std::snprintf(Line, sizeof(Line), "f %d/%d/1 %d/%d/1 %d/%d/1\n", B, B, C, C, D, D);
+                OBJ += Line;
+            }
+        }
+        return OBJ;
+    }
+
+    static int GridSizeFor(int Triangles)
+    {
+        int Size = 1;
+        while (2 * Size * Size < Triangles)
+        {
+            Size++;
+        }
+        return Size;
+    }
+
+    /* Face corners of the generated grid in the same order CRawMesh sees them. */
+    static std::vector<SVec3Size> GenerateCorners(int Size)
+    {
+        std::vector<SVec3Size> Corners;
+        Corners.reserve(std::size_t(Size) * Size * 6);
+        for (int Y = 0; Y < Size; ++Y)
+        {
+            for (int X = 0; X < Size; ++X)
+            {
+                std::size_t A = Y * (Size + 1) + X;
+                std::size_t B = A + 1;
+                std::size_t C = A + Size + 1;
+                std::size_t D = C + 1;
+                for (auto Corner : { A, C, B, B, C, D })
+                {
+                    Corners.push_back({ Corner, Corner, 0 });
+                }
+            }
+        }
+        return Corners;
+    }
+
+    static int Main(int ArgCount, char** Args)
+    {
+        int Triangles = ArgCount >= 1 ? std::atoi(Args[0]) : 100000;
+        int Size = GridSizeFor(Triangles);
+        if ((Size + 1) * (Size + 1) > UINT16_MAX + 1)
+        {
+            std::printf("%d triangles need more than %d vertices, meshes use 16-bit indices\n", Triangles, UINT16_MAX + 1);
+            return 1;
+        }
+
+        auto OBJ = GenerateOBJ(Size);
+        std::printf("%d triangles, %d vertices, %zu KB of OBJ\n", 2 * Size * Size, (Size + 1) * (Size + 1), OBJ.size() / 1024);
+
+        constexpr int Iterations = 5;
+        uint64_t Best = UINT64_MAX;
+        int VertexCount{};
+        for (int Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            auto Start = SClock::now();
+            CRawMesh Mesh{ SAsset{ OBJ.data(), OBJ.size() } };
+            Best = std::min(Best, NanosecondsSince(Start));
+            VertexCount = Mesh.GetVertexCount();
+            Memory::NextFrame();
+        }
+        std::printf("CRawMesh: %.2f ms (best of %d), %d vertices\n", double(Best) / 1e6, Iterations, VertexCount);
+
+        /* The deduplication CRawMesh used before, a linear search over all vertices so far, without any parsing. */
+        auto Corners = GenerateCorners(Size);
+        std::vector<SVec3Size> Unique;
+        std::vector<uint16_t> Indices;
+        auto Start = SClock::now();
+        for (const auto& Corner : Corners)
+        {
+            auto Existing = std::find(Unique.begin(), Unique.end(), Corner);
+            if (Existing == Unique.end())
+            {
+                Unique.push_back(Corner);
+                Existing = Unique.end() - 1;
+            }
+            Indices.push_back(static_cast<uint16_t>(Existing - Unique.begin()));
+        }
+        auto Linear = NanosecondsSince(Start);
+        std::printf("std::find deduplication alone: %.2f ms, %zu vertices (%.1fx the full hashed load)\n",
+            double(Linear) / 1e6, Unique.size(), double(Linear) / double(Best));
+
+        return 0;
+    }
+
+    struct SParser
+    {
+        const char* Name;
+        const char* (*FindLineEnd)(const char*, const char*);
+        int (*ParseFloatLine)(const char*, const char*, float*, int, const char*);
+        int (*ParseIntLine)(const char*, const char*, int*, int, const char*);
+    };
+
+    struct SParsed
+    {
+        std::vector<float> Floats;
+        std::vector<int> Ints;
+    };
+
+    /* Only the text side of CRawMesh: line splitting plus v/vt/vn/f parsing. */
+    static void ParseOBJ(const std::string& OBJ, const SParser& Parser, SParsed& Parsed)
+    {
+        Parsed.Floats.clear();
+        Parsed.Ints.clear();
+
+        const char* Cursor = OBJ.data();
+        const char* const End = Cursor + OBJ.size();
+        float Floats[3];
+        int Ints[9];
+        while (Cursor < End)
+        {
+            auto LineEnd = Parser.FindLineEnd(Cursor, End);
+            if (LineEnd - Cursor > 2 && Cursor[0] == 'v')
+            {
+                auto Data = Cursor[1] == ' ' ? Cursor + 2 : Cursor + 3;
+                auto Count = Parser.ParseFloatLine(Data, LineEnd, Floats, 3, End);
+                Parsed.Floats.insert(Parsed.Floats.end(), Floats, Floats + Count);
+            }
+            else if (LineEnd - Cursor > 2 && Cursor[0] == 'f')
+            {
+                auto Count = Parser.ParseIntLine(Cursor + 2, LineEnd, Ints, 9, End);
+                Parsed.Ints.insert(Parsed.Ints.end(), Ints, Ints + Count);
+            }
+            Cursor = LineEnd + 1;
+        }
+    }
+
+    static int ParseMain(int ArgCount, char** Args)
+    {
+        int Size = GridSizeFor(ArgCount >= 1 ? std::atoi(Args[0]) : 100000);
+        auto OBJ = GenerateOBJ(Size);
+        std::printf("%d triangles, %zu KB of OBJ, SIMD: %s\n", 2 * Size * Size, OBJ.size() / 1024, Utility::SIMDInstructionSet);
+
+        /* The byte by byte parsers CRawMesh used before, their rounding differs so results are not compared. */
+        static constexpr SParser Legacy{
+            "legacy",
+            Utility::FindLineEndScalar,
+            [](const char* Start, const char* End, float* Floats, int MaxFloats, const char*) {
+                Utility::ParseFloats(Start, End, Floats, MaxFloats);
+                return MaxFloats;
+            },
+            [](const char* Start, const char* End, int* Ints, int MaxInts, const char*) {
+                Utility::ParseInts(Start, End, Ints, MaxInts);
+                return MaxInts;
+            }
+        };
+        static constexpr SParser Scalar{
+            "scalar",
+            Utility::FindLineEndScalar,
+            [](const char* Start, const char* End, float* Floats, int MaxFloats, const char*) {
+                return Utility::ParseFloatLineScalar(Start, End, Floats, MaxFloats);
+            },
+            [](const char* Start, const char* End, int* Ints, int MaxInts, const char*) {
+                return Utility::ParseIntLineScalar(Start, End, Ints, MaxInts);
+            }
+        };
+        static constexpr SParser SIMD{ "simd", Utility::FindLineEnd, Utility::ParseFloatLine, Utility::ParseIntLine };
+
+        constexpr int Iterations = 5;
+        SParsed Results[3];
+        const SParser* Parsers[3]{ &Legacy, &Scalar, &SIMD };
+        for (int Index = 0; Index < 3; ++Index)
+        {
+            uint64_t Best = UINT64_MAX;
+            for (int Iteration = 0; Iteration < Iterations; ++Iteration)
+            {
+                auto Start = SClock::now();
+                ParseOBJ(OBJ, *Parsers[Index], Results[Index]);
+                Best = std::min(Best, NanosecondsSince(Start));
+            }
+            std::printf("%-8s %8.2f ms   %7.1f MB/s   %zu floats, %zu ints\n", Parsers[Index]->Name, double(Best) / 1e6,
+                double(OBJ.size()) / (double(Best) / 1e9) / (1024.0 * 1024.0), Results[Index].Floats.size(), Results[Index].Ints.size());
+        }
+
+        auto& ScalarResult = Results[1];
+        auto& SIMDResult = Results[2];
+        bool bIdentical = ScalarResult.Floats.size() == SIMDResult.Floats.size() && ScalarResult.Ints == SIMDResult.Ints
+            && std::memcmp(ScalarResult.Floats.data(), SIMDResult.Floats.data(), ScalarResult.Floats.size() * sizeof(float)) == 0;
+        std::printf("scalar and simd results are %s\n", bIdentical ? "identical" : "DIFFERENT");
+        return bIdentical ? 0 : 1;
+    }
+}
+
+int main(int ArgCount, char** Args)
+{
+    if (ArgCount >= 2 && std::strcmp(Args[1], "memory") == 0)
+    {
+        return MemoryBenchmark::Main(ArgCount - 2, Args + 2);
+    }
+    if (ArgCount >= 2 && std::strcmp(Args[1], "mesh") == 0)
+    {
+        return MeshBenchmark::Main(ArgCount - 2, Args + 2);
+    }
+    if (ArgCount >= 2 && std::strcmp(Args[1], "parse") == 0)
+    {
+        return MeshBenchmark::ParseMain(ArgCount - 2, Args + 2);
+    }
+
+    std::printf("Usage: EquinoxReachBenchmark memory <trace.ermt>\n");
+    std::printf("       EquinoxReachBenchmark mesh [triangles]\n");
+    std::printf("       EquinoxReachBenchmark parse [triangles]\n");
+    return 1;
+}
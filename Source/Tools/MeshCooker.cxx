@@ -0,0 +1,87 @@
+/* Converts OBJ meshes into the cooked format the runtime uploads without parsing, runs at build time.
+ * Usage: EquinoxReachMeshCooker <input.obj> <output.erms> */
+
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+#include "AssetTools.hxx"
+
+static bool ReadFile(const char* Path, std::vector<char>& Contents)
+{
+    std::FILE* File = std::fopen(Path, "rb");
+    if (File == nullptr)
+    {
+        std::printf("Failed to open %s\n", Path);
+        return false;
+    }
+
+    std::fseek(File, 0, SEEK_END);
+    auto Length = std::ftell(File);
+    std::fseek(File, 0, SEEK_SET);
+
+    Contents.resize(static_cast<std::size_t>(Length));
+    bool bRead = Length == 0 || std::fread(Contents.data(), Contents.size(), 1, File) == 1;
+    std::fclose(File);
+
+    if (!bRead)
+    {
+        std::printf("Failed to read %s\n", Path);
+    }
+    return bRead;
+}
+
+int main(int ArgCount, char** Args)
+{
+    if (ArgCount < 3)
+    {
+        std::printf("Usage: EquinoxReachMeshCooker <input.obj> <output.erms>\n");
+        return 1;
+    }
+
+    std::vector<char> OBJ;
+    if (!ReadFile(Args[1], OBJ))
+    {
+        return 1;
+    }
+
+    CRawMesh Mesh{ SAsset{ OBJ.data(), OBJ.size() } };
+    if (Mesh.GetVertexCount() == 0 || Mesh.GetVertexCount() > UINT16_MAX + 1)
+    {
+        std::printf("%s: %d vertices, expected 1 to %d\n", Args[1], Mesh.GetVertexCount(), UINT16_MAX + 1);
+        return 1;
+    }
+
+    SCookedMeshHeader Header{};
+    Header.VertexCount = static_cast<uint32_t>(Mesh.GetVertexCount());
+    Header.IndexCount = static_cast<uint32_t>(Mesh.GetElementCount());
+
+    std::vector<SCookedVertex> Vertices(Header.VertexCount);
+    for (std::size_t Index = 0; Index < Vertices.size(); ++Index)
+    {
+        Vertices[Index] = { Mesh.Positions[Index], Mesh.TexCoords[Index], Mesh.Normals[Index] };
+    }
+
+    std::error_code Error;
+    std::filesystem::create_directories(std::filesystem::path(Args[2]).parent_path(), Error);
+
+    std::FILE* File = std::fopen(Args[2], "wb");
+    if (File == nullptr)
+    {
+        std::printf("Failed to create %s\n", Args[2]);
+        return 1;
+    }
+
+    bool bWritten = std::fwrite(&Header, sizeof(Header), 1, File) == 1;
+    bWritten = bWritten && std::fwrite(Vertices.data(), sizeof(SCookedVertex), Vertices.size(), File) == Vertices.size();
+    bWritten = bWritten && (Header.IndexCount == 0 || std::fwrite(Mesh.Indices.data(), sizeof(uint16_t), Mesh.Indices.size(), File) == Mesh.Indices.size());
+    bWritten = std::fclose(File) == 0 && bWritten;
+
+    if (!bWritten)
+    {
+        std::printf("Failed to write %s\n", Args[2]);
+        std::remove(Args[2]);
+        return 1;
+    }
+
+    return 0;
+}
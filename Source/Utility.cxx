@@ -1,8 +1,20 @@
 #include "Utility.hxx"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <random>
 
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define UTILITY_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define UTILITY_SIMD_SSE2
+#endif
+
 namespace Utility
 {
     std::random_device RandomDevice;
@@ -198,4 +210,450 @@ namespace Utility
             Start++;
         }
     }
+
+#if defined(UTILITY_SIMD_AVX2)
+    const char* const SIMDInstructionSet = "AVX2";
+#elif defined(UTILITY_SIMD_SSE2)
+    const char* const SIMDInstructionSet = "SSE2";
+#else
+    const char* const SIMDInstructionSet = "None";
+#endif
+
+    static constexpr int MaxMantissaDigits = 19;
+    static constexpr int MaxExponent = 9999;
+
+    static constexpr uint64_t Pow10Integer[]{
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+        10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull, 1000000000000000ull,
+        10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+    };
+
+    static constexpr double Pow10Double[]{
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    /* '\0' counts as whitespace too, the SIMD classification treats it the same way. */
+    static inline bool IsFieldSpace(char Char)
+    {
+        return Char == ' ' || Char == '\t' || Char == '\r' || Char == '\n' || Char == '\0';
+    }
+
+    /* Rounds through strtof, without a decimal point the text doesn't depend on the locale. */
+    static float ComposeFloatSlow(uint64_t Mantissa, int Exponent)
+    {
+        char Buffer[32];
+        std::snprintf(Buffer, sizeof(Buffer), "%llue%d", static_cast<unsigned long long>(Mantissa), Exponent);
+        return std::strtof(Buffer, nullptr);
+    }
+
+    /* Both paths end up here, so they round the same way: correctly, for the MaxMantissaDigits digits that are kept.
+     * Mantissas up to 2^53 and powers up to 1e22 are exact doubles, so the double product or quotient is rounded once.
+     * Rounding it to float again is only wrong when it landed exactly halfway between two floats, that case and
+     * everything out of range go through strtof. */
+    static float ComposeFloat(bool bNegative, uint64_t Mantissa, int Exponent)
+    {
+        float Result{};
+        if (Mantissa > (uint64_t(1) << 53) || Exponent > 22 || Exponent < -22)
+        {
+            Result = ComposeFloatSlow(Mantissa, Exponent);
+        }
+        else
+        {
+            auto Value = static_cast<double>(Mantissa);
+            if (Exponent > 0)
+            {
+                Value *= Pow10Double[Exponent];
+            }
+            else if (Exponent < 0)
+            {
+                Value /= Pow10Double[-Exponent];
+            }
+
+            Result = static_cast<float>(Value);
+            auto const Rounded = static_cast<double>(Result);
+            if (Value != Rounded && std::isfinite(Result))
+            {
+                /* The sum of two neighbouring floats halved is exact in double. */
+                auto const Neighbor = static_cast<double>(std::nextafter(Result, Value > Rounded ? HUGE_VALF : -HUGE_VALF));
+                if (Value == (Rounded + Neighbor) * 0.5)
+                {
+                    Result = ComposeFloatSlow(Mantissa, Exponent);
+                }
+            }
+        }
+        return bNegative ? -Result : Result;
+    }
+
+    static int ParseExponent(const char*& Cursor, const char* End)
+    {
+        if (Cursor == End || (*Cursor != 'e' && *Cursor != 'E'))
+        {
+            return 0;
+        }
+        ++Cursor;
+
+        int Sign = 1;
+        if (Cursor != End && (*Cursor == '-' || *Cursor == '+'))
+        {
+            Sign = *Cursor == '-' ? -1 : 1;
+            ++Cursor;
+        }
+
+        int Exponent = 0;
+        while (Cursor != End && IsNumChar(*Cursor))
+        {
+            Exponent = std::min(Exponent * 10 + (*Cursor - '0'), MaxExponent);
+            ++Cursor;
+        }
+        return Sign * Exponent;
+    }
+
+    /* Digits past MaxMantissaDigits are dropped, dropped integer digits still scale the value. */
+    static float ParseFloatScalar(const char*& Cursor, const char* End)
+    {
+        bool bNegative = false;
+        if (Cursor != End && (*Cursor == '-' || *Cursor == '+'))
+        {
+            bNegative = *Cursor == '-';
+            ++Cursor;
+        }
+
+        uint64_t Mantissa = 0;
+        int Digits = 0;
+        int Exponent = 0;
+        while (Cursor != End && IsNumChar(*Cursor))
+        {
+            if (Digits < MaxMantissaDigits)
+            {
+                Mantissa = Mantissa * 10 + static_cast<uint64_t>(*Cursor - '0');
+                Digits++;
+            }
+            else
+            {
+                Exponent++;
+            }
+            ++Cursor;
+        }
+
+        if (Cursor != End && *Cursor == '.')
+        {
+            ++Cursor;
+            while (Cursor != End && IsNumChar(*Cursor))
+            {
+                if (Digits < MaxMantissaDigits)
+                {
+                    Mantissa = Mantissa * 10 + static_cast<uint64_t>(*Cursor - '0');
+                    Digits++;
+                    Exponent--;
+                }
+                ++Cursor;
+            }
+        }
+
+        Exponent += ParseExponent(Cursor, End);
+        return ComposeFloat(bNegative, Mantissa, Exponent);
+    }
+
+    const char* FindLineEndScalar(const char* Start, const char* End)
+    {
+        while (Start != End && *Start != '\n')
+        {
+            ++Start;
+        }
+        return Start;
+    }
+
+    int ParseFloatLineScalar(const char* Start, const char* End, float* Floats, int MaxFloats)
+    {
+        int Count = 0;
+        while (Count < MaxFloats)
+        {
+            while (Start != End && IsFieldSpace(*Start))
+            {
+                ++Start;
+            }
+            if (Start == End)
+            {
+                break;
+            }
+
+            Floats[Count++] = ParseFloatScalar(Start, End);
+
+            /* Skip whatever trails the number up to the next whitespace. */
+            while (Start != End && !IsFieldSpace(*Start))
+            {
+                ++Start;
+            }
+        }
+        return Count;
+    }
+
+    int ParseIntLineScalar(const char* Start, const char* End, int* Ints, int MaxInts)
+    {
+        int Count = 0;
+        while (Count < MaxInts)
+        {
+            while (Start != End && IsFieldSpace(*Start))
+            {
+                ++Start;
+            }
+            if (Start == End)
+            {
+                break;
+            }
+
+            /* One word, e.g. "1/2/3", holds one field per '/'. */
+            while (Count < MaxInts)
+            {
+                uint64_t Value = 0;
+                while (Start != End && IsNumChar(*Start))
+                {
+                    Value = Value * 10 + static_cast<uint64_t>(*Start - '0');
+                    ++Start;
+                }
+                Ints[Count++] = static_cast<int>(Value);
+
+                while (Start != End && !IsFieldSpace(*Start) && *Start != '/')
+                {
+                    ++Start;
+                }
+                if (Start == End || *Start != '/')
+                {
+                    break;
+                }
+                ++Start;
+            }
+        }
+        return Count;
+    }
+
+    /* Longer lines take the scalar path. */
+    static constexpr int MaxSIMDLineLength = 63;
+
+    /* Bytes read from the start of a line: up to 64 for the masks and one word past the last digit. */
+    static constexpr int SIMDLinePadding = 64 + 8;
+
+#if defined(UTILITY_SIMD_AVX2)
+    static constexpr int ChunkSize = 32;
+#else
+    static constexpr int ChunkSize = 16;
+#endif
+
+    /* One bit per byte of the line. Lines with SIMDLinePadding readable bytes are classified in place,
+     * others are copied first. Bits past the line count as whitespace. */
+    struct SClassifiedLine
+    {
+        alignas(32) char Copy[SIMDLinePadding];
+        const char* Line;
+        const char* LineEnd;
+
+        uint64_t Whitespace{};
+        uint64_t Digits{};
+        uint64_t Separators{};
+
+        SClassifiedLine(const char* Start, std::size_t Length, const char* BufferEnd)
+            : Line(Start), LineEnd(Start + Length)
+        {
+            if (BufferEnd - Start < SIMDLinePadding)
+            {
+                std::memset(Copy, 0, sizeof(Copy));
+                std::memcpy(Copy, Start, Length);
+                Line = Copy;
+                LineEnd = Copy + Length;
+            }
+
+            for (std::size_t Offset = 0; Offset < Length; Offset += ChunkSize)
+            {
+                Classify(Line + Offset, static_cast<int>(Offset));
+            }
+
+            auto LineMask = (1ull << Length) - 1;
+            Whitespace |= ~LineMask;
+            Digits &= LineMask;
+            Separators &= LineMask;
+        }
+
+        void Classify(const char* Data, int Offset)
+        {
+#if defined(UTILITY_SIMD_AVX2)
+            auto Chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Data));
+            auto Space = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(Chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(Chunk, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(Chunk, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(Chunk, _mm256_set1_epi8('\n'))),
+                    _mm256_cmpeq_epi8(Chunk, _mm256_setzero_si256())));
+            auto Digit = _mm256_and_si256(
+                _mm256_cmpgt_epi8(Chunk, _mm256_set1_epi8('0' - 1)),
+                _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), Chunk));
+            auto Separator = _mm256_cmpeq_epi8(Chunk, _mm256_set1_epi8('/'));
+
+            Whitespace |= uint64_t(uint32_t(_mm256_movemask_epi8(Space))) << Offset;
+            Digits |= uint64_t(uint32_t(_mm256_movemask_epi8(Digit))) << Offset;
+            Separators |= uint64_t(uint32_t(_mm256_movemask_epi8(Separator))) << Offset;
+#elif defined(UTILITY_SIMD_SSE2)
+            auto Chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data));
+            auto Space = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(Chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(Chunk, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(Chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(Chunk, _mm_set1_epi8('\n'))),
+                    _mm_cmpeq_epi8(Chunk, _mm_setzero_si128())));
+            auto Digit = _mm_and_si128(
+                _mm_cmpgt_epi8(Chunk, _mm_set1_epi8('0' - 1)),
+                _mm_cmplt_epi8(Chunk, _mm_set1_epi8('9' + 1)));
+            auto Separator = _mm_cmpeq_epi8(Chunk, _mm_set1_epi8('/'));
+
+            Whitespace |= uint64_t(_mm_movemask_epi8(Space)) << Offset;
+            Digits |= uint64_t(_mm_movemask_epi8(Digit)) << Offset;
+            Separators |= uint64_t(_mm_movemask_epi8(Separator)) << Offset;
+#else
+            for (int Index = 0; Index < ChunkSize; ++Index)
+            {
+                Whitespace |= uint64_t(IsFieldSpace(Data[Index])) << (Offset + Index);
+                Digits |= uint64_t(IsNumChar(Data[Index])) << (Offset + Index);
+                Separators |= uint64_t(Data[Index] == '/') << (Offset + Index);
+            }
+#endif
+        }
+    };
+
+    /* Length of the run of set bits starting at Position; bits past the line are clear, so the run ends before bit 64. */
+    static inline int RunLength(uint64_t Mask, std::ptrdiff_t Position)
+    {
+        return __builtin_ctzll(~(Mask >> Position));
+    }
+
+    /* 1 to 8 digits starting at First in one 64-bit word (little endian), the bytes after them are read but ignored. */
+    static inline uint64_t ParseEightDigits(const char* First, int Count)
+    {
+        uint64_t Chunk;
+        std::memcpy(&Chunk, First, sizeof(Chunk));
+        auto Keep = ~0ull >> (8 * (8 - Count));
+        Chunk = ((Chunk & Keep) | (0x3030303030303030ull & ~Keep)) - 0x3030303030303030ull;
+        /* Move the digits to the top so the ignored bytes become leading zeros. */
+        Chunk <<= 8 * (8 - Count);
+        Chunk = (Chunk * 10 + (Chunk >> 8)) & 0x00FF00FF00FF00FFull;
+        Chunk = (Chunk * 100 + (Chunk >> 16)) & 0x0000FFFF0000FFFFull;
+        return (Chunk * 10000 + (Chunk >> 32)) & 0x00000000FFFFFFFFull;
+    }
+
+    /* Same wrap-around as accumulating digit by digit in 64 bits. */
+    static inline uint64_t ParseDigits(const char* First, int Count)
+    {
+        if (Count <= 8)
+        {
+            return Count > 0 ? ParseEightDigits(First, Count) : 0;
+        }
+
+        uint64_t Value = 0;
+        int Piece = Count - 8 * ((Count - 1) / 8);
+        while (Count > 0)
+        {
+            Value = Value * Pow10Integer[Piece] + ParseEightDigits(First, Piece);
+            First += Piece;
+            Count -= Piece;
+            Piece = 8;
+        }
+        return Value;
+    }
+
+    const char* FindLineEnd(const char* Start, const char* End)
+    {
+#if defined(UTILITY_SIMD_AVX2)
+        auto NewLine = _mm256_set1_epi8('\n');
+        for (; End - Start >= 32; Start += 32)
+        {
+            auto Chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Start));
+            auto Mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(Chunk, NewLine)));
+            if (Mask != 0)
+            {
+                return Start + __builtin_ctz(Mask);
+            }
+        }
+#elif defined(UTILITY_SIMD_SSE2)
+        auto NewLine = _mm_set1_epi8('\n');
+        for (; End - Start >= 16; Start += 16)
+        {
+            auto Chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Start));
+            auto Mask = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(Chunk, NewLine)));
+            if (Mask != 0)
+            {
+                return Start + __builtin_ctz(Mask);
+            }
+        }
+#endif
+        return FindLineEndScalar(Start, End);
+    }
+
+    int ParseFloatLine(const char* Start, const char* End, float* Floats, int MaxFloats, const char* BufferEnd)
+    {
+        if (End - Start > MaxSIMDLineLength)
+        {
+            return ParseFloatLineScalar(Start, End, Floats, MaxFloats);
+        }
+
+        SClassifiedLine Classified{ Start, static_cast<std::size_t>(End - Start), BufferEnd != nullptr ? BufferEnd : End };
+        auto TokenStarts = ~Classified.Whitespace & ((Classified.Whitespace << 1) | 1);
+
+        int Count = 0;
+        for (; TokenStarts != 0 && Count < MaxFloats; TokenStarts &= TokenStarts - 1)
+        {
+            const char* Token = Classified.Line + __builtin_ctzll(TokenStarts);
+            const char* Cursor = Token;
+
+            bool bNegative = false;
+            if (*Cursor == '-' || *Cursor == '+')
+            {
+                bNegative = *Cursor == '-';
+                ++Cursor;
+            }
+
+            auto IntegerDigits = RunLength(Classified.Digits, Cursor - Classified.Line);
+            const char* Integer = Cursor;
+            Cursor += IntegerDigits;
+
+            int FractionDigits = 0;
+            const char* Fraction = Cursor;
+            if (Cursor != Classified.LineEnd && *Cursor == '.')
+            {
+                Fraction = ++Cursor;
+                FractionDigits = RunLength(Classified.Digits, Cursor - Classified.Line);
+                Cursor += FractionDigits;
+            }
+
+            if (IntegerDigits + FractionDigits > MaxMantissaDigits)
+            {
+                Floats[Count++] = ParseFloatScalar(Token, Classified.LineEnd);
+                continue;
+            }
+
+            auto Mantissa = ParseDigits(Integer, IntegerDigits);
+            if (FractionDigits > 0)
+            {
+                Mantissa = Mantissa * Pow10Integer[FractionDigits] + ParseDigits(Fraction, FractionDigits);
+            }
+            auto Exponent = ParseExponent(Cursor, Classified.LineEnd) - FractionDigits;
+            Floats[Count++] = ComposeFloat(bNegative, Mantissa, Exponent);
+        }
+        return Count;
+    }
+
+    int ParseIntLine(const char* Start, const char* End, int* Ints, int MaxInts, const char* BufferEnd)
+    {
+        if (End - Start > MaxSIMDLineLength)
+        {
+            return ParseIntLineScalar(Start, End, Ints, MaxInts);
+        }
+
+        SClassifiedLine Classified{ Start, static_cast<std::size_t>(End - Start), BufferEnd != nullptr ? BufferEnd : End };
+
+        /* A field starts at every word and right after every separator, even if it is empty. */
+        auto FieldStarts = (~Classified.Whitespace & ((Classified.Whitespace << 1) | 1)) | (Classified.Separators << 1);
+
+        int Count = 0;
+        for (; FieldStarts != 0 && Count < MaxInts; FieldStarts &= FieldStarts - 1)
+        {
+            auto Position = __builtin_ctzll(FieldStarts);
+            Ints[Count++] = static_cast<int>(ParseDigits(Classified.Line + Position, RunLength(Classified.Digits, Position)));
+        }
+        return Count;
+    }
 }
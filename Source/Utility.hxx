@@ -37,6 +37,25 @@ namespace Utility
 
     void ParseInts(const char* Start, const char* End, int* Ints, int IntCount);
 
+    /* Bulk parsers for OBJ style lines, e.g. "v 1.0 -2.5 3e-2" or "f 1/2/3 4/5/6 7/8/9".
+     * The default variants classify whole chunks into whitespace, digit and separator masks with SIMD
+     * (AVX2 or SSE2, scalar classification elsewhere) and walk the masks, the Scalar variants go byte by byte.
+     * Both return bit-identical results. The line parsers return the number of values written. */
+    extern const char* const SIMDInstructionSet;
+
+    /* Position of the next '\n', or End. */
+    const char* FindLineEnd(const char* Start, const char* End);
+    const char* FindLineEndScalar(const char* Start, const char* End);
+
+    /* Whitespace separated decimal floats with an optional sign, fraction and exponent.
+     * BufferEnd is the end of the readable memory holding the line, with enough of it the line is not copied. */
+    int ParseFloatLine(const char* Start, const char* End, float* Floats, int MaxFloats, const char* BufferEnd = nullptr);
+    int ParseFloatLineScalar(const char* Start, const char* End, float* Floats, int MaxFloats);
+
+    /* Unsigned integers, fields are separated by whitespace or '/'; an empty field after '/' reads as 0. */
+    int ParseIntLine(const char* Start, const char* End, int* Ints, int MaxInts, const char* BufferEnd = nullptr);
+    int ParseIntLineScalar(const char* Start, const char* End, int* Ints, int MaxInts);
+
     inline constexpr int MakeEven(int Number)
     {
         return Number & ~1;
@@ -54,4 +73,17 @@ namespace Utility
 
         return Number + 1;
     }
+
+    static constexpr uint64_t HashSeed = 14695981039346656037ull;
+
+    /* FNV-1a, pass the previous result as Hash to hash several buffers as one. */
+    inline uint64_t HashBytes(const void* Data, std::size_t Length, uint64_t Hash = HashSeed)
+    {
+        auto* Bytes = static_cast<const unsigned char*>(Data);
+        for (std::size_t Index = 0; Index < Length; ++Index)
+        {
+            Hash = (Hash ^ Bytes[Index]) * 1099511628211ull;
+        }
+        return Hash;
+    }
 }